@@ -15,9 +15,10 @@
 #define GPR(exp) offsetof(ARMProcessor, core.regs) + 4 * (exp)
 
 
-static void executeInstr(ARMProcessor *cpu, ARMInstruction instr) {
+static void executeInstr(ARMProcessor *cpu, ARMInstruction instr, int type) {
 	#if STATS
 	cpu->jit.instrsExecuted--;
+	cpu->fallbackInstrs[type]++;
 	#endif
 	
 	instr.execute(cpu);
@@ -69,31 +70,202 @@ static bool storeMemory(ARMProcessor *cpu, uint32_t addr, uint32_t value) {
 	return cpu->write<T>(addr, value);
 }
 
+template <class T>
+static bool swapMemory(ARMProcessor *cpu, uint32_t addr, uint32_t value, uint32_t *ptr) {
+	T temp;
+	if (!cpu->read<T>(addr, &temp)) return false;
+	if (!cpu->write<T>(addr, value)) return false;
+	*ptr = temp;
+	return true;
+}
 
-ARMCodeGenerator::ARMCodeGenerator() : generator(0x8000) {
-	generator.seek(0x400 * 5);
-	index = 0;
+static bool loadDouble(ARMProcessor *cpu, uint32_t addr, uint32_t *ptr) {
+	if (!cpu->read<uint32_t>(addr, &ptr[0])) return false;
+	return cpu->read<uint32_t>(addr + 4, &ptr[1]);
 }
 
-char *ARMCodeGenerator::get() {
-	generator.seek(0);
-	for (int i = 0; i < index; i++) {
-		generator.jumpRel(offsets[i]);
-	}
-	return generator.get();
+static bool storeDouble(ARMProcessor *cpu, uint32_t addr, uint32_t *ptr) {
+	if (!cpu->write<uint32_t>(addr, ptr[0])) return false;
+	return cpu->write<uint32_t>(addr + 4, ptr[1]);
 }
 
-size_t ARMCodeGenerator::size() {
-	return generator.size();
+static uint32_t getStatusRegMask(ARMInstruction instr) {
+	uint32_t mask = 0;
+	if ((instr.value >> 19) & 1) mask |= 0xFF000000;
+	if ((instr.value >> 18) & 1) mask |= 0x00FF0000;
+	if ((instr.value >> 17) & 1) mask |= 0x0000FF00;
+	if ((instr.value >> 16) & 1) mask |= 0x000000FF;
+	return mask;
 }
 
+
+ARMCodeGenerator::ARMCodeGenerator() : JITGenerator(0x400, 4, REG(PC)) {}
+
 void ARMCodeGenerator::generate(uint32_t value) {
-	ARMInstruction instr;
-	instr.value = value;
+	values.push_back(value);
+}
+
+void ARMCodeGenerator::generateBodies() {
+	ARMFlagLiveness liveness(values.size());
+	for (int i = 0; i < (int)values.size(); i++) {
+		ARMInstruction instr;
+		instr.value = values[i];
+		analyzeFlags(&liveness, i, instr);
+	}
 	
-	offsets[index] = generator.tell() - (index + 1) * 5;
-	generateInstr(instr);
-	index++;
+	liveness.solve();
+	
+	for (int i = 0; i < (int)values.size(); i++) {
+		ARMInstruction instr;
+		instr.value = values[i];
+		
+		flags = liveness.get(i);
+		
+		beginInstr();
+		generateInstr(instr);
+	}
+}
+
+// Must match the instructions that are generated by generateInstr
+void ARMCodeGenerator::analyzeFlags(ARMFlagLiveness *liveness, int index, ARMInstruction instr) {
+	int read = 0;
+	int written = 0;
+	
+	int cond = instr.cond();
+	int type = (instr.value >> 25) & 7;
+	if (cond == 0xF) {
+		read = ARMFlagLiveness::All;
+	}
+	else if (type == 0) {
+		if ((instr.value & 0x90) == 0x90) {
+			if ((instr.value & 0x60) == 0) {
+				if ((instr.value >> 24) & 1) {
+					if (((instr.value >> 23) & 1) || instr.r1() == ARMCore::PC) {
+						read = ARMFlagLiveness::All;
+					}
+				}
+				else if (((instr.value >> 22) & 3) == 1) read = ARMFlagLiveness::All;
+				else if (instr.s()) {
+					written = ARMFlagLiveness::N | ARMFlagLiveness::Z;
+				}
+			}
+			else if (instr.l() || ((instr.value >> 5) & 3) == 1) {
+				if (instr.l() && instr.r1() == ARMCore::PC) {
+					read = ARMFlagLiveness::All;
+				}
+			}
+			else if ((instr.r1() & 1) || instr.r1() == ARMCore::LR) {
+				read = ARMFlagLiveness::All;
+			}
+		}
+		else if ((instr.value & 0x01900000) == 0x01000000) {
+			int op = (instr.value >> 4) & 0xF;
+			if (op == 0 && ((instr.value >> 21) & 1)) {
+				analyzeMoveStatusReg(instr, &read, &written);
+			}
+			else if (op != 1 || !((instr.value >> 22) & 1)) {
+				read = ARMFlagLiveness::All;
+			}
+		}
+		else {
+			analyzeDataProcessing(instr, &read, &written);
+		}
+	}
+	else if (type == 1) {
+		if ((instr.value & 0x01900000) == 0x01000000) {
+			if ((instr.value >> 21) & 1) {
+				analyzeMoveStatusReg(instr, &read, &written);
+			}
+			else {
+				read = ARMFlagLiveness::All;
+			}
+		}
+		else {
+			analyzeDataProcessing(instr, &read, &written);
+		}
+	}
+	else if (type == 2 || type == 3) {
+		if (type == 3 && (instr.value & 0x10)) {
+			read = ARMFlagLiveness::All;
+		}
+		else if (instr.l() && instr.r1() == ARMCore::PC) {
+			read = ARMFlagLiveness::All;
+		}
+		else if (type == 3 && instr.shift() == 6) {
+			// Rotate right with extend
+			read = ARMFlagLiveness::C;
+		}
+	}
+	else if (type == 4) {
+		if ((instr.value & (1 << 22)) || (instr.l() && (instr.value & (1 << 15)))) {
+			read = ARMFlagLiveness::All;
+		}
+	}
+	else if (type == 5 && !instr.link()) {
+		int target = index + 2 + instr.offset() / 4;
+		liveness->setBranch(index, target, cond != ARMInstruction::AL);
+		if (cond != ARMInstruction::AL) {
+			liveness->setCondition(index, cond);
+		}
+		return;
+	}
+	else {
+		read = ARMFlagLiveness::All;
+	}
+	
+	liveness->setFlags(index, read, written);
+	if (cond != ARMInstruction::AL) {
+		liveness->setCondition(index, cond);
+	}
+}
+
+void ARMCodeGenerator::analyzeDataProcessing(ARMInstruction instr, int *read, int *written) {
+	if (instr.r1() == ARMCore::PC) {
+		*read = ARMFlagLiveness::All;
+		return;
+	}
+	
+	int opcode = instr.opcode();
+	if (opcode == 5 || opcode == 6 || opcode == 7) {
+		*read |= ARMFlagLiveness::C;
+	}
+	
+	bool shiftCarry = false;
+	if (instr.i()) {
+		shiftCarry = instr.rotate() != 0;
+	}
+	else if (!(instr.shift() & 1)) {
+		int amount = instr.shift() >> 3;
+		int type = (instr.shift() >> 1) & 3;
+		if (type == 3 && amount == 0) {
+			*read |= ARMFlagLiveness::C;
+		}
+		shiftCarry = type >= 2 || amount != 0;
+	}
+	
+	if (instr.s()) {
+		if ((opcode >= 2 && opcode <= 7) || opcode == 10 || opcode == 11) {
+			*written = ARMFlagLiveness::All;
+		}
+		else {
+			*written = ARMFlagLiveness::N | ARMFlagLiveness::Z;
+			if (shiftCarry) {
+				*written |= ARMFlagLiveness::C;
+			}
+		}
+	}
+}
+
+void ARMCodeGenerator::analyzeMoveStatusReg(ARMInstruction instr, int *read, int *written) {
+	uint32_t mask = getStatusRegMask(instr);
+	if (!instr.r()) {
+		if (mask & 0xFF) {
+			*read = ARMFlagLiveness::All;
+		}
+		else if (mask & 0xF0000000) {
+			*written = ARMFlagLiveness::All;
+		}
+	}
 }
 
 void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
@@ -118,15 +290,17 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 							generateError(instr);
 						}
 						else {
-							generateUnimplemented(instr); // swap
+							generateSwap(instr);
 						}
 					}
+					else if ((instr.value >> 23) & 1) generateMultiplyLong(instr);
+					else if ((instr.value >> 22) & 1) generateUndefined();
 					else {
-						generateUnimplemented(instr); // multiply
+						generateMultiply(instr);
 					}
 				}
 				else {
-					generateUnimplemented(instr); // load store extra
+					generateLoadStoreExtra(instr);
 				}
 			}
 			else if ((instr.value & 0x01900000) == 0x01000000) {
@@ -138,7 +312,7 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 						int type = (instr.value >> 4) & 7;
 						if (type == 0) {
 							if ((instr.value >> 21) & 1) {
-								generateUnimplemented(instr); // move status register reg
+								generateMoveStatusReg(instr);
 							}
 							else {
 								generateReadStatusReg(instr);
@@ -146,7 +320,7 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 						}
 						else if (type == 1) {
 							if ((instr.value >> 22) & 1) {
-								generateUnimplemented(instr); // count leading zeros
+								generateCountLeadingZeros(instr);
 							}
 							else {
 								generateBranchExchange(instr);
@@ -157,7 +331,7 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 					}
 				}
 				else {
-					generateUnimplemented(instr);
+					generateError(instr);
 				}
 			}
 			else {
@@ -167,8 +341,7 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 		else if (type == 1) {
 			if ((instr.value & 0x01900000) == 0x01000000) {
 				if ((instr.value >> 21) & 1) {
-					// move status register imm
-					generateUnimplemented(instr);
+					generateMoveStatusReg(instr);
 				}
 				else {
 					generateUndefined();
@@ -197,7 +370,7 @@ void ARMCodeGenerator::generateInstr(ARMInstruction instr) {
 		else if (type == 6) generateError(instr);
 		else if (type == 7) {
 			if (instr.value & 0x01000000) generateSoftwareInterrupt();
-			else if (instr.value & 0x10) generateUnimplemented(instr); // coprocessor transfer
+			else if (instr.value & 0x10) generateContextSync(instr, CoprocessorTransfer);
 			else {
 				generateError(instr);
 			}
@@ -258,11 +431,19 @@ void ARMCodeGenerator::generateCondition(ARMInstruction instr) {
 	generator.ret(); // 1 byte
 }
 
-void ARMCodeGenerator::generateUnimplemented(ARMInstruction instr) {
+void ARMCodeGenerator::generateUnimplemented(ARMInstruction instr, Fallback type) {
 	generator.movImm32(RSI, instr.value);
+	generator.movImm32(RDX, type);
 	generator.jumpAbs(RAX, (uint64_t)executeInstr);
 }
 
+void ARMCodeGenerator::generateContextSync(ARMInstruction instr, Fallback type) {
+	// The instruction may change the processor mode, the address
+	// translation or invalidate the code that is being executed
+	generateUnimplemented(instr, type);
+	endBlock();
+}
+
 void ARMCodeGenerator::generateError(ARMInstruction instr) {
 	generator.movImm32(RDI, instr.value);
 	generator.jumpAbs(RAX, (uint64_t)throwInstr);
@@ -355,19 +536,23 @@ void ARMCodeGenerator::generateReadShiftedReg(Register target, ARMInstruction in
 	int type = (instr.shift() >> 1) & 3;
 	if (type == 0) { // Logical shift left
 		generator.andImm32(RCX, 0xFF);
-		generator.compareImm32(RCX, 32);
 		if (s) {
-			generator.jumpIfBelow(23);
+			// A shift by zero leaves the carry flag unchanged
+			generator.jumpIfZero(58); // 2 bytes
+			generator.compareImm32(RCX, 32); // 6 bytes
+			generator.jumpIfBelow(28); // 2 bytes
+			generator.jumpIfEqual(15); // 2 bytes
 			generator.movImm32(target, 0); // 5 bytes
-			generator.jumpIfEqual(10); // 2 bytes
 			generator.bitTestResetMem32(RDI, CPSR, 29); // 8 bytes
-			generator.jumpRel(22); // 2 bytes
+			generator.jumpRel(33); // 2 bytes
 			generator.bitTestReg32(target, 0); // 4 bytes
+			generator.movImm32(target, 0); // 5 bytes
 			generator.jumpRel(2); // 2 bytes
 			generator.shlReg32(target); // 2 bytes
-			generateCarryUpdate(); // 14 bytes
+			generateCarryUpdate(); // 20 bytes
 		}
 		else {
+			generator.compareImm32(RCX, 32);
 			generator.jumpIfBelow(7);
 			generator.movImm32(target, 0); // 5 bytes
 			generator.jumpRel(2);
@@ -376,19 +561,22 @@ void ARMCodeGenerator::generateReadShiftedReg(Register target, ARMInstruction in
 	}
 	else if (type == 1) { // Logical shift right
 		generator.andImm32(RCX, 0xFF);
-		generator.compareImm32(RCX, 32);
 		if (s) {
-			generator.jumpIfBelow(23);
+			generator.jumpIfZero(58); // 2 bytes
+			generator.compareImm32(RCX, 32); // 6 bytes
+			generator.jumpIfBelow(28); // 2 bytes
+			generator.jumpIfEqual(15); // 2 bytes
 			generator.movImm32(target, 0); // 5 bytes
-			generator.jumpIfEqual(10); // 2 bytes
 			generator.bitTestResetMem32(RDI, CPSR, 29); // 8 bytes
-			generator.jumpRel(22); // 2 bytes
+			generator.jumpRel(33); // 2 bytes
 			generator.bitTestReg32(target, 31); // 4 bytes
+			generator.movImm32(target, 0); // 5 bytes
 			generator.jumpRel(2); // 2 bytes
 			generator.shrReg32(target); // 2 bytes
-			generateCarryUpdate(); // 14 bytes
+			generateCarryUpdate(); // 20 bytes
 		}
 		else {
+			generator.compareImm32(RCX, 32);
 			generator.jumpIfBelow(7);
 			generator.movImm32(target, 0); // 5 bytes
 			generator.jumpRel(2);
@@ -397,27 +585,34 @@ void ARMCodeGenerator::generateReadShiftedReg(Register target, ARMInstruction in
 	}
 	else if (type == 2) { // Arithmetic shift right
 		generator.andImm32(RCX, 0xFF);
-		generator.compareImm32(RCX, 32);
 		if (s) {
-			generator.jumpIfBelow(13);
+			generator.jumpIfZero(43); // 2 bytes
+			generator.compareImm32(RCX, 32); // 6 bytes
+			generator.jumpIfBelow(13); // 2 bytes
 			generator.movImm32(RCX, 31); // 5 bytes
 			generator.sarReg32(target); // 2 bytes
 			generator.bitTestReg32(target, 0); // 4 bytes
 			generator.jumpRel(2); // 2 bytes
 			generator.sarReg32(target); // 2 bytes
-			generateCarryUpdate(); // 14 bytes
+			generateCarryUpdate(); // 20 bytes
 		}
 		else {
+			generator.compareImm32(RCX, 32);
 			generator.jumpIfBelow(5);
 			generator.movImm32(RCX, 31); // 5 bytes
 			generator.sarReg32(target);
 		}
 	}
 	else { // Rotate right
-		generator.rorReg32(target);
 		if (s) {
-			generator.bitTestReg32(target, 31);
-			generateCarryUpdate();
+			generator.andImm32(RCX, 0xFF);
+			generator.jumpIfZero(26); // 2 bytes
+			generator.rorReg32(target); // 2 bytes
+			generator.bitTestReg32(target, 31); // 4 bytes
+			generateCarryUpdate(); // 20 bytes
+		}
+		else {
+			generator.rorReg32(target);
 		}
 	}
 }
@@ -432,6 +627,8 @@ void ARMCodeGenerator::generateBranch(ARMInstruction instr) {
 }
 
 void ARMCodeGenerator::generateBranchExchange(ARMInstruction instr) {
+	endBlock();
+	
 	generateReadReg(RAX, instr.r3());
 	generator.movReg32(RDX, RAX);
 	generator.andImm32(RAX, 1);
@@ -443,6 +640,8 @@ void ARMCodeGenerator::generateBranchExchange(ARMInstruction instr) {
 }
 
 void ARMCodeGenerator::generateBranchLinkExchange(ARMInstruction instr) {
+	endBlock();
+	
 	generator.loadMem32(RAX, RDI, REG(PC));
 	generator.storeMem32(RDI, REG(LR), RAX);
 		
@@ -498,6 +697,9 @@ void ARMCodeGenerator::generateLoadStore(ARMInstruction instr, bool exchange) {
 	if (instr.r1() != ARMCore::PC) {
 		exchange = false;
 	}
+	else if (instr.l()) {
+		endBlock();
+	}
 	
 	if (writeBack) {
 		generator.pushReg64(RCX);
@@ -558,6 +760,75 @@ void ARMCodeGenerator::generateLoadStore(ARMInstruction instr, bool exchange) {
 	generator.ret();
 }
 
+void ARMCodeGenerator::generateLoadStoreExtra(ARMInstruction instr) {
+	if ((instr.value >> 22) & 1) {
+		generator.movImm32(RAX, (instr.value & 0xF) | ((instr.value >> 4) & 0xF0));
+	}
+	else {
+		generator.loadMem32(RAX, RDI, GPR(instr.r3()));
+	}
+	
+	int opcode = (instr.value >> 5) & 3;
+	if (opcode == 1) generateLoadStore<uint16_t>(instr, false);
+	else if (instr.l()) {
+		if (opcode == 2) generateLoadStore<int8_t>(instr, false);
+		else {
+			generateLoadStore<int16_t>(instr, false);
+		}
+	}
+	else if (instr.r1() & 1) generateUndefined();
+	else {
+		generateLoadStoreDouble(instr);
+	}
+}
+
+void ARMCodeGenerator::generateLoadStoreDouble(ARMInstruction instr) {
+	generateReadReg(RSI, instr.r0());
+	
+	generator.movReg32(RCX, RSI);
+	if (instr.u()) {
+		generator.addRegReg32(RCX, RAX);
+	}
+	else {
+		generator.subRegReg32(RCX, RAX);
+	}
+	
+	if (instr.p()) {
+		generator.movReg32(RSI, RCX);
+	}
+	
+	// ldrd is a load instruction with the l bit cleared
+	bool load = ((instr.value >> 5) & 3) == 2;
+	if (load && instr.r1() == ARMCore::LR) {
+		endBlock();
+	}
+	
+	uint64_t func = load ? (uint64_t)loadDouble : (uint64_t)storeDouble;
+	generator.lea64(RDX, RDI, GPR(instr.r1()));
+	
+	if (!instr.w() && instr.p()) {
+		generator.jumpAbs(RAX, func);
+		return;
+	}
+	
+	generator.pushReg64(RCX);
+	generator.pushReg64(RDI);
+	generator.pushReg64(RDI);
+	
+	generator.callAbs(RAX, func);
+	
+	generator.popReg64(RDI);
+	generator.popReg64(RDI);
+	generator.popReg64(RCX);
+	
+	generator.testReg32(RAX, RAX);
+	generator.jumpIfNotZero(1);
+	generator.ret();
+	
+	generator.storeMem32(RDI, GPR(instr.r0()), RCX);
+	generator.ret();
+}
+
 void ARMCodeGenerator::generateLoadStoreMultiple(ARMInstruction instr) {
 	int adder = instr.u() ? 4 : -4;
 	int reg = instr.u() ? 0 : 15;
@@ -565,6 +836,10 @@ void ARMCodeGenerator::generateLoadStoreMultiple(ARMInstruction instr) {
 	
 	bool userMode = (instr.value & (1 << 22)) && (!(instr.value & (1 << 15)) || !instr.l());
 	
+	if ((instr.value & (1 << 22)) || (instr.l() && (instr.value & (1 << 15)))) {
+		endBlock();
+	}
+	
 	uint32_t regs = offsetof(ARMProcessor, core.regs);
 	
 	generator.pushReg64(RBP);
@@ -646,12 +921,15 @@ void ARMCodeGenerator::generateLoadStoreMultiple(ARMInstruction instr) {
 
 void ARMCodeGenerator::generateDataProcessingImm(ARMInstruction instr) {
 	int opcode = instr.opcode();
+	if (instr.r1() == ARMCore::PC) {
+		endBlock();
+	}
 	
 	int rot = instr.rotate() * 2;
 	uint32_t imm = instr.value & 0xFF;
 	if (rot) {
-		bool shiftCarry = instr.s();
-		if (opcode == 2 || opcode == 3 || opcode == 4 || opcode == 10 || opcode == 11) {
+		bool shiftCarry = instr.s() && (flags & ARMFlagLiveness::C);
+		if ((opcode >= 2 && opcode <= 7) || opcode == 10 || opcode == 11) {
 			shiftCarry = false;
 		}
 		
@@ -721,20 +999,23 @@ void ARMCodeGenerator::generateDataProcessingImm(ARMInstruction instr) {
 
 void ARMCodeGenerator::generateDataProcessingReg(ARMInstruction instr) {
 	int opcode = instr.opcode();
+	if (instr.r1() == ARMCore::PC) {
+		endBlock();
+	}
+	
+	bool shiftCarry = instr.s() && (flags & ARMFlagLiveness::C);
+	if ((opcode >= 2 && opcode <= 7) || opcode == 10 || opcode == 11) {
+		shiftCarry = false;
+	}
 	
 	if (opcode == 3 || opcode == 7) {
 		generateReadShifted(RAX, instr, false);
 		generateReadReg(RDX, instr.r0());
 	}
 	else if (opcode == 13 || opcode == 15) {
-		generateReadShifted(RAX, instr, instr.s());
+		generateReadShifted(RAX, instr, shiftCarry);
 	}
 	else {
-		bool shiftCarry = instr.s();
-		if (opcode == 2 || opcode == 3 || opcode == 4 || opcode == 10 || opcode == 11) {
-			shiftCarry = false;
-		}
-		
 		generateReadShifted(RDX, instr, shiftCarry);
 		generateReadReg(RAX, instr.r0());
 	}
@@ -844,13 +1125,26 @@ void ARMCodeGenerator::generateSubRegCarry(Register reg, Register other, bool s)
 }
 
 void ARMCodeGenerator::generateCarryUpdate() {
-	generator.jumpIfCarry(8); // 2 bytes
+	if (!(flags & ARMFlagLiveness::C)) return;
+	
+	generator.jumpIfCarry(10); // 2 bytes
 	generator.bitTestResetMem32(RDI, CPSR, 29); // 8 bytes
 	generator.jumpRel(8); // 2 bytes
 	generator.bitTestSetMem32(RDI, CPSR, 29); // 8 bytes
 }
 
 void ARMCodeGenerator::generateOverflowUpdate() {
+	if ((flags & (ARMFlagLiveness::C | ARMFlagLiveness::V)) != (ARMFlagLiveness::C | ARMFlagLiveness::V)) {
+		if (flags & ARMFlagLiveness::V) {
+			generator.jumpIfOverflow(10); // 2 bytes
+			generator.bitTestResetMem32(RDI, CPSR, 28); // 8 bytes
+			generator.jumpRel(8); // 2 bytes
+			generator.bitTestSetMem32(RDI, CPSR, 28); // 8 bytes
+		}
+		generateCarryUpdate();
+		return;
+	}
+	
 	generator.jumpIfCarry(32); // 2 bytes
 	generator.jumpIfOverflow(12); // 2 bytes
 	
@@ -875,6 +1169,14 @@ void ARMCodeGenerator::generateOverflowUpdate() {
 }
 
 void ARMCodeGenerator::generateOverflowUpdateInv() {
+	if ((flags & (ARMFlagLiveness::C | ARMFlagLiveness::V)) != (ARMFlagLiveness::C | ARMFlagLiveness::V)) {
+		if (flags & ARMFlagLiveness::C) {
+			generator.flipCarry();
+		}
+		generateOverflowUpdate();
+		return;
+	}
+	
 	generator.jumpIfNotCarry(32); // 2 bytes
 	generator.jumpIfOverflow(12); // 2 bytes
 	
@@ -898,14 +1200,40 @@ void ARMCodeGenerator::generateOverflowUpdateInv() {
 	generator.orMemImm32(RDI, CPSR, 0x30000000);
 }
 
+// Updates the flags for the 64-bit value in high:low, uses RCX
+void ARMCodeGenerator::generateFlagsUpdate(Register low, Register high) {
+	uint32_t mask = (flags & (ARMFlagLiveness::N | ARMFlagLiveness::Z)) << 28;
+	if (!mask) return;
+	
+	generator.andMemImm32(RDI, CPSR, ~mask); // 10 bytes
+	if (flags & ARMFlagLiveness::Z) {
+		generator.movReg32(RCX, low); // 2 bytes
+		generator.orReg32(RCX, high); // 2 bytes
+		generator.jumpIfNotZero(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 30); // 8 bytes
+	}
+	if (flags & ARMFlagLiveness::N) {
+		generator.bitTestReg32(high, 31); // 4 bytes
+		generator.jumpIfNotCarry(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 31); // 8 bytes
+	}
+}
+
 void ARMCodeGenerator::generateFlagsUpdate(Register reg) {
-	generator.andMemImm32(RDI, CPSR, 0x3FFFFFFF); // 10 bytes
-	generator.testReg32(reg, reg); // 2 bytes
-	generator.jumpIfNotZero(8); // 2 bytes
-	generator.bitTestSetMem32(RDI, CPSR, 30); // 8 bytes
-	generator.bitTestReg32(reg, 31); // 4 bytes
-	generator.jumpIfNotCarry(8); // 2 bytes
-	generator.bitTestSetMem32(RDI, CPSR, 31); // 8 bytes
+	uint32_t mask = (flags & (ARMFlagLiveness::N | ARMFlagLiveness::Z)) << 28;
+	if (!mask) return;
+	
+	generator.andMemImm32(RDI, CPSR, ~mask); // 10 bytes
+	if (flags & ARMFlagLiveness::Z) {
+		generator.testReg32(reg, reg); // 2 bytes
+		generator.jumpIfNotZero(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 30); // 8 bytes
+	}
+	if (flags & ARMFlagLiveness::N) {
+		generator.bitTestReg32(reg, 31); // 4 bytes
+		generator.jumpIfNotCarry(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 31); // 8 bytes
+	}
 }
 
 void ARMCodeGenerator::generateReadStatusReg(ARMInstruction instr) {
@@ -915,3 +1243,96 @@ void ARMCodeGenerator::generateReadStatusReg(ARMInstruction instr) {
 	generator.storeMem32(RDI, GPR(rd), RAX);
 	generator.ret();
 }
+
+void ARMCodeGenerator::generateMoveStatusReg(ARMInstruction instr) {
+	uint32_t mask = getStatusRegMask(instr);
+	if (!instr.r() && (mask & 0xFF)) {
+		generateContextSync(instr, StatusRegisterMove);
+		return;
+	}
+	
+	int offs = instr.r() ? offsetof(ARMProcessor, core.spsr) : CPSR;
+	if (instr.i()) {
+		uint32_t value = instr.value & 0xFF;
+		int rot = instr.rotate() * 2;
+		if (rot) {
+			value = (value >> rot) | (value << (32 - rot));
+		}
+		generator.andMemImm32(RDI, offs, ~mask);
+		generator.orMemImm32(RDI, offs, value & mask);
+	}
+	else {
+		generateReadReg(RAX, instr.r3());
+		generator.andImm32(RAX, mask);
+		generator.andMemImm32(RDI, offs, ~mask);
+		generator.orMemReg32(RDI, offs, RAX);
+	}
+	generator.ret();
+}
+
+void ARMCodeGenerator::generateMultiply(ARMInstruction instr) {
+	generator.loadMem32(RAX, RDI, GPR(instr.r3()));
+	generator.loadMem32(RCX, RDI, GPR(instr.r2()));
+	generator.mulReg32(RCX);
+	if (instr.a()) {
+		generator.addRegMem32(RAX, RDI, GPR(instr.r1()));
+	}
+	generator.storeMem32(RDI, GPR(instr.r0()), RAX);
+	
+	if (instr.s()) {
+		generateFlagsUpdate(RAX);
+	}
+	generator.ret();
+}
+
+void ARMCodeGenerator::generateMultiplyLong(ARMInstruction instr) {
+	generator.loadMem32(RAX, RDI, GPR(instr.r3()));
+	generator.loadMem32(RCX, RDI, GPR(instr.r2()));
+	if ((instr.value >> 22) & 1) {
+		generator.imulReg32(RCX);
+	}
+	else {
+		generator.mulReg32(RCX);
+	}
+	
+	if (instr.a()) {
+		generator.loadMem32(RCX, RDI, GPR(instr.r1()));
+		generator.addRegReg32(RAX, RCX);
+		generator.loadMem32(RCX, RDI, GPR(instr.r0()));
+		generator.adcRegReg32(RDX, RCX);
+	}
+	
+	generator.storeMem32(RDI, GPR(instr.r0()), RDX);
+	generator.storeMem32(RDI, GPR(instr.r1()), RAX);
+	
+	if (instr.s()) {
+		generateFlagsUpdate(RAX, RDX);
+	}
+	generator.ret();
+}
+
+void ARMCodeGenerator::generateCountLeadingZeros(ARMInstruction instr) {
+	generator.loadMem32(RDX, RDI, GPR(instr.r3()));
+	generator.bitScanReverse32(RAX, RDX);
+	generator.movImm32(RCX, 63);
+	generator.moveIf32(Equal, RAX, RCX);
+	generator.xorImm32(RAX, 31);
+	generator.storeMem32(RDI, GPR(instr.r1()), RAX);
+	generator.ret();
+}
+
+void ARMCodeGenerator::generateSwap(ARMInstruction instr) {
+	if (instr.r1() == ARMCore::PC) {
+		endBlock();
+	}
+	
+	generator.loadMem32(RSI, RDI, GPR(instr.r0()));
+	generator.loadMem32(RDX, RDI, GPR(instr.r3()));
+	generator.lea64(RCX, RDI, GPR(instr.r1()));
+	if (instr.b()) {
+		generator.jumpAbs(RAX, (uint64_t)swapMemory<uint8_t>);
+	}
+	else {
+		generator.jumpAbs(RAX, (uint64_t)swapMemory<uint32_t>);
+	}
+}
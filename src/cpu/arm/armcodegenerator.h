@@ -2,33 +2,45 @@
 #pragma once
 
 #include "cpu/arm/arminstruction.h"
-#include "cpu/x86codegenerator.h"
+#include "cpu/arm/armflags.h"
+#include "cpu/jitgenerator.h"
 #include "physicalmemory.h"
 #include "config.h"
 
+#include <vector>
 #include <cstdint>
 
 
 class ARMProcessor;
 
 
-class ARMCodeGenerator {
+class ARMCodeGenerator : public JITGenerator {
 public:
-	ARMCodeGenerator();
+	// Encodings that are still executed by the interpreter
+	enum Fallback {
+		StatusRegisterMove,
+		CoprocessorTransfer,
+		FallbackCount
+	};
 	
-	char *get();
-	size_t size();
+	ARMCodeGenerator();
 	
 	void generate(uint32_t value);
 	
 private:
+	void generateBodies();
+	void analyzeFlags(ARMFlagLiveness *liveness, int index, ARMInstruction instr);
+	void analyzeDataProcessing(ARMInstruction instr, int *read, int *written);
+	void analyzeMoveStatusReg(ARMInstruction instr, int *read, int *written);
+	
 	void generateReadReg(Register target, int reg);
 	void generateReadShifted(Register target, ARMInstruction instr, bool s);
 	void generateReadShiftedReg(Register target, ARMInstruction instr, bool s);
 	void generateReadShiftedImm(Register target, ARMInstruction instr, bool s);
 	
 	void generateFlagsUpdate(Register reg);
-	void generateCarryUpdate(); // 14 bytes
+	void generateFlagsUpdate(Register low, Register high);
+	void generateCarryUpdate(); // 20 bytes
 	void generateOverflowUpdate();
 	void generateOverflowUpdateInv();
 	
@@ -44,7 +56,8 @@ private:
 	
 	void generateInstr(ARMInstruction instr);
 	void generateCondition(ARMInstruction instr); // up to 23 bytes
-	void generateUnimplemented(ARMInstruction instr);
+	void generateUnimplemented(ARMInstruction instr, Fallback type);
+	void generateContextSync(ARMInstruction instr, Fallback type);
 	void generateError(ARMInstruction instr);
 	void generateUndefined();
 	void generateSoftwareInterrupt();
@@ -52,16 +65,24 @@ private:
 	void generateBranchExchange(ARMInstruction instr);
 	void generateBranchLinkExchange(ARMInstruction instr);
 	void generateReadStatusReg(ARMInstruction instr);
+	void generateMoveStatusReg(ARMInstruction instr);
+	void generateMultiply(ARMInstruction instr);
+	void generateMultiplyLong(ARMInstruction instr);
+	void generateCountLeadingZeros(ARMInstruction instr);
+	void generateSwap(ARMInstruction instr);
 	void generateDataProcessingImm(ARMInstruction instr);
 	void generateDataProcessingReg(ARMInstruction instr);
 	void generateLoadStoreImm(ARMInstruction instr);
 	void generateLoadStoreReg(ARMInstruction instr);
 	void generateLoadStoreMultiple(ARMInstruction instr);
+	void generateLoadStoreExtra(ARMInstruction instr);
+	void generateLoadStoreDouble(ARMInstruction instr);
 	
 	template <class T>
 	void generateLoadStore(ARMInstruction instr, bool exchange);
 	
-	X86CodeGenerator generator;
-	uint32_t offsets[0x400];
-	int index;
+	std::vector<uint32_t> values;
+	
+	// Flags that are live after the current instruction
+	int flags;
 };
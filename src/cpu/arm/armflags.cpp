@@ -0,0 +1,73 @@
+
+#include "cpu/arm/armflags.h"
+
+
+ARMFlagLiveness::ARMFlagLiveness(int count) {
+	Instruction instr;
+	instr.read = 0;
+	instr.written = 0;
+	instr.target = -1;
+	instr.next = true;
+	instr.live = 0;
+	instrs.resize(count, instr);
+}
+
+void ARMFlagLiveness::setFlags(int index, int read, int written) {
+	instrs[index].read = read;
+	instrs[index].written = written;
+}
+
+void ARMFlagLiveness::setBranch(int index, int target, bool conditional) {
+	Instruction &instr = instrs[index];
+	if (target >= 0 && target < (int)instrs.size()) {
+		instr.target = target;
+		instr.next = conditional;
+	}
+	else {
+		instr.read = All;
+	}
+}
+
+void ARMFlagLiveness::setCondition(int index, int cond) {
+	static const int conditionFlags[] = {
+		Z, Z, C, C, N, N, V, V,
+		C | Z, C | Z, N | V, N | V, N | Z | V, N | Z | V, 0, 0
+	};
+	
+	instrs[index].read |= conditionFlags[cond];
+	instrs[index].written = 0;
+}
+
+void ARMFlagLiveness::solve() {
+	// Branches may form loops, so repeat until nothing changes
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int i = instrs.size() - 1; i >= 0; i--) {
+			Instruction &instr = instrs[i];
+			
+			int live = 0;
+			if (instr.next) {
+				// The next page may read any flag
+				live |= i + 1 < (int)instrs.size() ? getLiveIn(i + 1) : All;
+			}
+			if (instr.target != -1) {
+				live |= getLiveIn(instr.target);
+			}
+			
+			if (live != instr.live) {
+				instr.live = live;
+				changed = true;
+			}
+		}
+	}
+}
+
+int ARMFlagLiveness::get(int index) {
+	return instrs[index].live;
+}
+
+int ARMFlagLiveness::getLiveIn(int index) {
+	Instruction &instr = instrs[index];
+	return instr.read | (instr.live & ~instr.written);
+}
@@ -0,0 +1,50 @@
+
+#pragma once
+
+#include <vector>
+
+
+/*	Finds out which condition flags are live after each instruction of a
+	page. A flag is dead if every path from the instruction overwrites it
+	before it is read, so the code generators don't need to update it.
+	
+	Instructions may branch to another instruction in the same page. Any
+	other change of the program counter must be treated as a read of all
+	flags, just like instructions that are executed by the interpreter.
+	Exceptions and interrupts resume at the instruction where they were
+	taken, so they don't change the liveness.
+*/
+
+class ARMFlagLiveness {
+public:
+	enum Flag {
+		V = 1, C = 2, Z = 4, N = 8,
+		All = 15
+	};
+	
+	ARMFlagLiveness(int count);
+	
+	void setFlags(int index, int read, int written);
+	void setBranch(int index, int target, bool conditional);
+	
+	// The instruction is only executed if the condition is true
+	void setCondition(int index, int cond);
+	
+	void solve();
+	
+	// Returns the flags that are live after the instruction
+	int get(int index);
+
+private:
+	struct Instruction {
+		int read;
+		int written;
+		int target;
+		bool next;
+		int live;
+	};
+	
+	int getLiveIn(int index);
+	
+	std::vector<Instruction> instrs;
+};
@@ -2,15 +2,43 @@
 #include "armmmu.h"
 #include "common/logger.h"
 
+#include <cstring>
 
-ARMMMU::ARMMMU(PhysicalMemory *physmem, ARMCore *core) {
+
+ARMMMU::ARMMMU(PhysicalMemory *physmem, ARMCore *core) : cache(12) {
 	this->physmem = physmem;
 	this->core = core;
+	
+	memset(sections, 0, sizeof(sections));
+	memset(pages, 0, sizeof(pages));
+	generation = 1;
+	
 	reset();
 }
 
+ARMMMU::~ARMMMU() {
+	for (int i = 0; i < 0x1000; i++) {
+		delete[] pages[i];
+	}
+}
+
 void ARMMMU::reset() {
 	cache.reset();
+	invalidate();
+}
+
+void ARMMMU::invalidate() {
+	cache.invalidate();
+	
+	if (++generation == 0) {
+		memset(sections, 0, sizeof(sections));
+		for (int i = 0; i < 0x1000; i++) {
+			if (pages[i]) {
+				memset(pages[i], 0, sizeof(Translation) * 0x100);
+			}
+		}
+		generation = 1;
+	}
 }
 
 bool ARMMMU::checkPermissions(MemoryAccess type, bool supervisor, int ap) {
@@ -47,57 +75,121 @@ bool ARMMMU::translate(uint32_t *addr, MemoryAccess type, bool supervisor) {
 }
 
 bool ARMMMU::translateFromTable(uint32_t *addr, MemoryAccess type, bool supervisor) {
-	uint32_t firstLevelOffs = (*addr >> 20) * 4;
+	Translation *translation = lookup(*addr);
+	if (!translation) return false;
+	
+	int subpage = (*addr & 0xFFF) / 0x400;
+	int index = subpage * 6 + (int)type * 2 + supervisor;
+	if (!((translation->permissions >> index) & 1)) {
+		signalFault(type, *addr, translation->domain, translation->status);
+		return false;
+	}
+	
+	cache.update(type, supervisor, *addr, translation->base, translation->mask);
+	*addr = translation->base + (*addr & translation->mask);
+	return true;
+}
+
+ARMMMU::Translation *ARMMMU::lookup(uint32_t addr) {
+	Translation *section = &sections[addr >> 20];
+	if (section->generation != generation) {
+		if (!decodeSection(section, addr)) return nullptr;
+	}
+	
+	if (!section->coarse) return section;
+	
+	Translation *table = pages[addr >> 20];
+	if (!table) {
+		table = new Translation[0x100]();
+		pages[addr >> 20] = table;
+	}
+	
+	Translation *page = &table[(addr >> 12) & 0xFF];
+	if (page->generation != generation) {
+		if (!decodePage(page, section, addr)) return nullptr;
+	}
+	return page;
+}
+
+bool ARMMMU::decodeSection(Translation *section, uint32_t addr) {
+	uint32_t firstLevelOffs = (addr >> 20) * 4;
 	uint32_t firstLevelAddr = core->ttbr + firstLevelOffs;
 	uint32_t firstLevelDesc = physmem->read<uint32_t>(firstLevelAddr);
 	
-	int domain = (firstLevelDesc >> 5) & 0xF;
+	section->domain = (firstLevelDesc >> 5) & 0xF;
+	section->coarse = false;
+	
+	// Faults are not cached, so that the descriptor is read
+	// again once the fault has been handled
 	int firstLevelType = firstLevelDesc & 3;
 	if (firstLevelType == 0) {
-		signalFault(type, *addr, domain, 5);
-		return false;
+		section->permissions = 0;
+		section->status = 5;
+		section->generation = 0;
+		return true;
 	}
 	else if (firstLevelType == 1) {
-		uint32_t secondLevelBase = firstLevelDesc & ~0x3FF;
-		uint32_t secondLevelOffs = ((*addr >> 12) & 0xFF) * 4;
-		uint32_t secondLevelAddr = secondLevelBase + secondLevelOffs;
-		uint32_t secondLevelDesc = physmem->read<uint32_t>(secondLevelAddr);
-		
-		int secondLevelType = secondLevelDesc & 3;
-		if (secondLevelType == 0) {
-			signalFault(type, *addr, domain, 7);
-			return false;
-		}
-		else if (secondLevelType == 2) {
-			int subpage = (*addr & 0xFFF) / 0x400;
-			int ap = (secondLevelDesc >> (4 + subpage * 2)) & 3;
-			if (!checkPermissions(type, supervisor, ap)) {
-				signalFault(type, *addr, domain, 15);
-				return false;
-			}
-			uint32_t pageBase = secondLevelDesc & ~0xFFF;
-			cache.update(type, supervisor, *addr, pageBase, 0xFFF);
-			*addr = pageBase + (*addr & 0xFFF);
-		}
-		else {
-			Logger::warning("Unsupported second-level descriptor type: %i", secondLevelType);
-			return false;
-		}
+		section->base = firstLevelDesc & ~0x3FF;
+		section->coarse = true;
 	}
 	else if (firstLevelType == 2) {
 		int ap = (firstLevelDesc >> 10) & 3;
-		if (!checkPermissions(type, supervisor, ap)) {
-			signalFault(type, *addr, domain, 13);
-			return false;
-		}
-		
-		uint32_t sectionBase = firstLevelDesc & ~0xFFFFF;
-		cache.update(type, supervisor, *addr, sectionBase, 0xFFFFF);
-		*addr = sectionBase + (*addr & 0xFFFFF);
+		section->base = firstLevelDesc & ~0xFFFFF;
+		section->mask = 0xFFFFF;
+		section->permissions = getPermissions(ap) * 0x41041;
+		section->status = 13;
 	}
 	else {
 		Logger::warning("Unsupported first-level descriptor type: %i", firstLevelType);
 		return false;
 	}
+	
+	section->generation = generation;
 	return true;
 }
+
+bool ARMMMU::decodePage(Translation *page, Translation *section, uint32_t addr) {
+	uint32_t secondLevelOffs = ((addr >> 12) & 0xFF) * 4;
+	uint32_t secondLevelAddr = section->base + secondLevelOffs;
+	uint32_t secondLevelDesc = physmem->read<uint32_t>(secondLevelAddr);
+	
+	page->domain = section->domain;
+	page->coarse = false;
+	
+	int secondLevelType = secondLevelDesc & 3;
+	if (secondLevelType == 0) {
+		page->permissions = 0;
+		page->status = 7;
+		page->generation = 0;
+		return true;
+	}
+	else if (secondLevelType == 2) {
+		page->base = secondLevelDesc & ~0xFFF;
+		page->mask = 0xFFF;
+		page->permissions = 0;
+		for (int subpage = 0; subpage < 4; subpage++) {
+			int ap = (secondLevelDesc >> (4 + subpage * 2)) & 3;
+			page->permissions |= getPermissions(ap) << (subpage * 6);
+		}
+		page->status = 15;
+	}
+	else {
+		Logger::warning("Unsupported second-level descriptor type: %i", secondLevelType);
+		return false;
+	}
+	
+	page->generation = generation;
+	return true;
+}
+
+uint32_t ARMMMU::getPermissions(int ap) {
+	uint32_t permissions = 0;
+	for (int type = 0; type < 3; type++) {
+		for (int supervisor = 0; supervisor < 2; supervisor++) {
+			if (checkPermissions((MemoryAccess)type, supervisor, ap)) {
+				permissions |= 1 << (type * 2 + supervisor);
+			}
+		}
+	}
+	return permissions;
+}
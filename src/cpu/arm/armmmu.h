@@ -12,18 +12,49 @@
 class ARMMMU {
 public:
 	ARMMMU(PhysicalMemory *physmem, ARMCore *core);
+	~ARMMMU();
 	
 	void reset();
 	
+	// Must be called when the translation table base, the
+	// domains or the translation table itself are changed
+	void invalidate();
+	
 	bool translate(uint32_t *addr, MemoryAccess type, bool supervisor);
 	
 	MMUCache cache;
 
 private:
+	// A decoded section or small page
+	struct Translation {
+		uint32_t base;
+		uint32_t mask;
+		
+		// One bit per access type and privilege level for every 1KB
+		// subpage. If the bit is clear, the fault status is signaled.
+		uint32_t permissions;
+		uint8_t status;
+		uint8_t domain;
+		
+		bool coarse;
+		uint32_t generation;
+	};
+	
+	Translation *lookup(uint32_t addr);
+	bool decodeSection(Translation *section, uint32_t addr);
+	bool decodePage(Translation *page, Translation *section, uint32_t addr);
+	uint32_t getPermissions(int ap);
+	
 	bool translateFromTable(uint32_t *addr, MemoryAccess type, bool supervisor);
 	bool checkPermissions(MemoryAccess type, bool supervisor, int ap);
 	void signalFault(MemoryAccess type, uint32_t addr, int domain, int status);
 	
 	PhysicalMemory *physmem;
 	ARMCore *core;
+	
+	// The first level is decoded into sections, and coarse page
+	// tables are decoded into pages, which are allocated on demand
+	Translation sections[0x1000];
+	Translation *pages[0x1000];
+	uint32_t generation;
 };
@@ -12,8 +12,8 @@
 ARMProcessor::ARMProcessor(Emulator *emulator) :
 	Processor(emulator, 0, true),
 	mmu(&emulator->physmem, &core),
-	jit(&emulator->physmem, this),
-	thumb(&emulator->physmem, this)
+	jit(&emulator->physmem, this, "arm"),
+	thumb(&emulator->physmem, this, "thumb")
 {
 	printer.init("ARM");
 	
@@ -31,6 +31,9 @@ void ARMProcessor::reset() {
 	
 	#if STATS
 	armInstrs = 0;
+	for (int i = 0; i < ARMCodeGenerator::FallbackCount; i++) {
+		fallbackInstrs[i] = 0;
+	}
 	#endif
 }
 
@@ -56,7 +59,7 @@ void ARMProcessor::step() {
 		core.triggerException(ARMCore::PrefetchAbort);
 	}
 	
-	updateTimer();
+	updateTimer(1);
 	checkDebugPoints();
 	
 	#if BREAKPOINTS
@@ -64,6 +67,41 @@ void ARMProcessor::step() {
 	#endif
 }
 
+void ARMProcessor::stepBlock() {
+	#if BREAKPOINTS
+	if (!breakpoints.empty()) {
+		step();
+		return;
+	}
+	#endif
+	
+	uint32_t pc = core.regs[ARMCore::PC];
+	int instrs = 1;
+	
+	bool supervisor = core.getMode() != ARMCore::User;
+	if (mmu.translate(&pc, MemoryAccess::Instruction, supervisor)) {
+		// Blocks stop following branches once the hardware is due
+		if (core.isThumb()) {
+			core.regs[ARMCore::PC] += 2;
+			instrs = thumb.executeBlock(pc, timer);
+		}
+		else {
+			core.regs[ARMCore::PC] += 4;
+			instrs = jit.executeBlock(pc, timer);
+			
+			#if STATS
+			armInstrs += instrs;
+			#endif
+		}
+	}
+	else {
+		core.triggerException(ARMCore::PrefetchAbort);
+	}
+	
+	updateTimer(instrs);
+	checkDebugPoints();
+}
+
 void ARMProcessor::checkDebugPoints() {
 	if (core.regs[ARMCore::PC] == 0xD400AEC) {
 		std::string message = physmem->read<std::string>(core.regs[ARMCore::R0]);
@@ -118,11 +156,15 @@ void ARMProcessor::checkDebugPoints() {
 	#endif
 }
 
-void ARMProcessor::updateTimer() {
-	if (--timer == 0) {
-		hardware->update();
+void ARMProcessor::updateTimer(int instrs) {
+	timer -= instrs;
+	if (timer <= 0) {
+		// A block may run past the timer, so the remainder is kept
+		while (timer <= 0) {
+			hardware->update();
+			timer += 100;
+		}
 		checkInterrupts();
-		timer = 100;
 	}
 }
 
@@ -180,11 +222,13 @@ bool ARMProcessor::coprocessorWrite(int coproc, int opc, uint32_t value, int rn,
 		else if (rn == 2) { // Translation table base
 			if (type == 0) {
 				core.ttbr = value;
+				mmu.invalidate();
 				return true;
 			}
 		}
 		else if (rn == 3) { // Domain access control
 			core.domain = value;
+			mmu.invalidate();
 			return true;
 		}
 		else if (rn == 5) { // Fault status
@@ -206,16 +250,12 @@ bool ARMProcessor::coprocessorWrite(int coproc, int opc, uint32_t value, int rn,
 		else if (rn == 7) { // Cache management functions
 			if (rm == 0 && type == 4) { // Wait for interrupt
 				while (!hardware->check_interrupts_arm()) {
-					hardware->update();
+					hardware->idle_arm();
 				}
 				core.triggerException(ARMCore::InterruptRequest);
 				return true;
 			}
-			else if (rm == 5 && type == 0) { // Invalidate entire instruction cache
-				jit.invalidate();
-				thumb.invalidate();
-				return true;
-			}
+			else if (rm == 5 && type == 0) return true; // Invalidate entire instruction cache
 			else if (rm == 6 && type == 0) return true; // Invalidate entire data cache
 			else if (rm == 6 && type == 1) return true; // Invalidate data cache line
 			else if (rm == 10 && type == 1) return true; // Clean data cache line
@@ -223,7 +263,7 @@ bool ARMProcessor::coprocessorWrite(int coproc, int opc, uint32_t value, int rn,
 		}
 		else if (rn == 8) { // TLB functions
 			if (rm == 7 && type == 0) {
-				mmu.cache.invalidate(); // Invalidate entire instruction and data TLBs
+				mmu.invalidate(); // Invalidate entire instruction and data TLBs
 				return true;
 			}
 		}
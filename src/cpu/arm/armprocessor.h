@@ -74,6 +74,7 @@ public:
 	
 	void reset();
 	void step();
+	void stepBlock();
 	
 	bool coprocessorRead(int coproc, int opc, uint32_t *value, int rn, int rm, int type);
 	bool coprocessorWrite(int coproc, int opc, uint32_t value, int rn, int rm, int type);
@@ -90,12 +91,13 @@ public:
 	uint64_t armInstrs;
 	uint64_t dataReads;
 	uint64_t dataWrites;
+	uint64_t fallbackInstrs[ARMCodeGenerator::FallbackCount];
 	#endif
 	
 private:
 	void stepThumb();
 	void stepARM();
-	void updateTimer();
+	void updateTimer(int instrs);
 	
 	void checkDebugPoints();
 	void checkInterrupts();
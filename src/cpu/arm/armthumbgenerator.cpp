@@ -43,30 +43,102 @@ static bool storeMemory(ARMProcessor *cpu, uint32_t addr, uint32_t value) {
 }
 
 
-ARMThumbGenerator::ARMThumbGenerator() : generator(0x8000) {
-	generator.seek(0x800 * 5);
-	index = 0;
-}
+ARMThumbGenerator::ARMThumbGenerator() : JITGenerator(0x800, 2, REG(PC)) {}
 
-char *ARMThumbGenerator::get() {
-	generator.seek(0);
-	for (int i = 0; i < index; i++) {
-		generator.jumpRel(offsets[i]);
-	}
-	return generator.get();
+void ARMThumbGenerator::generate(uint16_t value) {
+	values.push_back(value);
 }
 
-size_t ARMThumbGenerator::size() {
-	return generator.size();
+void ARMThumbGenerator::generateBodies() {
+	ARMFlagLiveness liveness(values.size());
+	for (int i = 0; i < (int)values.size(); i++) {
+		ARMThumbInstr instr;
+		instr.value = values[i];
+		analyzeFlags(&liveness, i, instr);
+	}
+	
+	liveness.solve();
+	
+	for (int i = 0; i < (int)values.size(); i++) {
+		ARMThumbInstr instr;
+		instr.value = values[i];
+		
+		flags = liveness.get(i);
+		
+		beginInstr();
+		generateInstr(instr);
+	}
 }
 
-void ARMThumbGenerator::generate(uint16_t value) {
-	ARMThumbInstr instr;
-	instr.value = value;
+// Must match the instructions that are generated by generateInstr
+void ARMThumbGenerator::analyzeFlags(ARMFlagLiveness *liveness, int index, ARMThumbInstr instr) {
+	int read = 0;
+	int written = 0;
+	
+	if (!(instr.value >> 13)) {
+		if (((instr.value >> 11) & 3) == 3) written = ARMFlagLiveness::All;
+		else {
+			written = ARMFlagLiveness::N | ARMFlagLiveness::Z;
+		}
+	}
+	else if ((instr.value >> 13) == 1) {
+		if (((instr.value >> 11) & 3) == 0) written = ARMFlagLiveness::N | ARMFlagLiveness::Z;
+		else {
+			written = ARMFlagLiveness::All;
+		}
+	}
+	else if ((instr.value >> 10) == 0x10) {
+		int opcode = (instr.value >> 6) & 0xF;
+		if (opcode == 5 || opcode == 6) {
+			read = ARMFlagLiveness::C;
+		}
+		
+		if (opcode == 5 || opcode == 6 || opcode == 10 || opcode == 11) written = ARMFlagLiveness::All;
+		else {
+			written = ARMFlagLiveness::N | ARMFlagLiveness::Z;
+		}
+	}
+	else if ((instr.value >> 8) == 0x47) read = ARMFlagLiveness::All;
+	else if ((instr.value >> 10) == 0x11) {
+		int reg1 = (instr.value & 7) + ((instr.value >> 4) & 8);
+		if (((instr.value >> 8) & 3) == 1) written = ARMFlagLiveness::All;
+		else if (reg1 == ARMCore::PC) {
+			read = ARMFlagLiveness::All;
+		}
+	}
+	else if ((instr.value >> 12) == 11) {
+		if (((instr.value >> 8) & 0xF) != 0) {
+			// pop {pc} and invalid instructions
+			if (((instr.value >> 9) & 3) != 2 || (instr.l() && instr.r())) {
+				read = ARMFlagLiveness::All;
+			}
+		}
+	}
+	else if ((instr.value >> 12) == 13) {
+		int type = (instr.value >> 8) & 0xF;
+		if (type >= 14) read = ARMFlagLiveness::All;
+		else {
+			int offset = instr.value & 0xFF;
+			if (offset & 0x80) offset -= 0x100;
+			liveness->setBranch(index, index + 2 + offset, true);
+			liveness->setCondition(index, type);
+			return;
+		}
+	}
+	else if ((instr.value >> 11) == 0x1C) {
+		int offset = instr.value & 0x7FF;
+		if (offset & 0x400) offset -= 0x800;
+		liveness->setBranch(index, index + 2 + offset, false);
+		return;
+	}
+	else if ((instr.value >> 11) == 0x1D) read = ARMFlagLiveness::All;
+	else if ((instr.value >> 12) == 0xF) {
+		if (instr.h()) {
+			read = ARMFlagLiveness::All;
+		}
+	}
 	
-	offsets[index] = generator.tell() - (index + 1) * 5;
-	generateInstr(instr);
-	index++;
+	liveness->setFlags(index, read, written);
 }
 
 void ARMThumbGenerator::generateInstr(ARMThumbInstr instr) {
@@ -171,12 +243,13 @@ void ARMThumbGenerator::generateAddSubCmpMovImm(ARMThumbInstr instr) {
 	int opcode = (instr.value >> 11) & 3;
 	if (opcode == 0) {
 		generator.storeMemImm32(RDI, GPR(reg), imm);
-		if (imm == 0) {
-			generator.andMemImm32(RDI, CPSR, 0x3FFFFFFF);
-		}
-		else {
-			generator.bitTestSetMem32(RDI, CPSR, 30);
-			generator.bitTestResetMem32(RDI, CPSR, 31);
+		
+		uint32_t mask = (flags & (ARMFlagLiveness::N | ARMFlagLiveness::Z)) << 28;
+		if (mask) {
+			generator.andMemImm32(RDI, CPSR, ~mask);
+			if (imm == 0 && (flags & ARMFlagLiveness::Z)) {
+				generator.bitTestSetMem32(RDI, CPSR, 30);
+			}
 		}
 	}
 	else if (opcode == 1) {
@@ -354,6 +427,8 @@ void ARMThumbGenerator::generateLongBranchWithLink(ARMThumbInstr instr) {
 }
 
 void ARMThumbGenerator::generateBranchExchange(ARMThumbInstr instr) {
+	endBlock();
+	
 	int reg = (instr.value >> 3) & 0xF;
 	generateReadReg(RDX, reg);
 	
@@ -558,6 +633,8 @@ void ARMThumbGenerator::generatePushPopRegisterList(ARMThumbInstr instr) {
 			}
 		}
 		if (instr.r()) {
+			endBlock();
+			
 			generator.movReg64(RDI, RBP);
 			generator.movReg32(RSI, RBX);
 			generator.lea64(RDX, RDI, REG(PC));
@@ -628,16 +705,43 @@ void ARMThumbGenerator::generateSubRegCarry(Register reg, Register other) {
 }
 
 void ARMThumbGenerator::generateFlagsUpdate(Register reg) {
-	generator.andMemImm32(RDI, CPSR, 0x3FFFFFFF); // 10 bytes
-	generator.testReg32(reg, reg); // 2 bytes
-	generator.jumpIfNotZero(8); // 2 bytes
-	generator.bitTestSetMem32(RDI, CPSR, 30); // 8 bytes
-	generator.bitTestReg32(reg, 31); // 4 bytes
-	generator.jumpIfNotCarry(8); // 2 bytes
-	generator.bitTestSetMem32(RDI, CPSR, 31); // 8 bytes
+	uint32_t mask = (flags & (ARMFlagLiveness::N | ARMFlagLiveness::Z)) << 28;
+	if (!mask) return;
+	
+	generator.andMemImm32(RDI, CPSR, ~mask); // 10 bytes
+	if (flags & ARMFlagLiveness::Z) {
+		generator.testReg32(reg, reg); // 2 bytes
+		generator.jumpIfNotZero(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 30); // 8 bytes
+	}
+	if (flags & ARMFlagLiveness::N) {
+		generator.bitTestReg32(reg, 31); // 4 bytes
+		generator.jumpIfNotCarry(8); // 2 bytes
+		generator.bitTestSetMem32(RDI, CPSR, 31); // 8 bytes
+	}
+}
+
+void ARMThumbGenerator::generateCarryUpdate() {
+	if (!(flags & ARMFlagLiveness::C)) return;
+	
+	generator.jumpIfCarry(10); // 2 bytes
+	generator.bitTestResetMem32(RDI, CPSR, 29); // 8 bytes
+	generator.jumpRel(8); // 2 bytes
+	generator.bitTestSetMem32(RDI, CPSR, 29); // 8 bytes
 }
 
 void ARMThumbGenerator::generateOverflowUpdate() {
+	if ((flags & (ARMFlagLiveness::C | ARMFlagLiveness::V)) != (ARMFlagLiveness::C | ARMFlagLiveness::V)) {
+		if (flags & ARMFlagLiveness::V) {
+			generator.jumpIfOverflow(10); // 2 bytes
+			generator.bitTestResetMem32(RDI, CPSR, 28); // 8 bytes
+			generator.jumpRel(8); // 2 bytes
+			generator.bitTestSetMem32(RDI, CPSR, 28); // 8 bytes
+		}
+		generateCarryUpdate();
+		return;
+	}
+	
 	generator.jumpIfCarry(32); // 2 bytes
 	generator.jumpIfOverflow(12); // 2 bytes
 	
@@ -662,6 +766,14 @@ void ARMThumbGenerator::generateOverflowUpdate() {
 }
 
 void ARMThumbGenerator::generateOverflowUpdateInv() {
+	if ((flags & (ARMFlagLiveness::C | ARMFlagLiveness::V)) != (ARMFlagLiveness::C | ARMFlagLiveness::V)) {
+		if (flags & ARMFlagLiveness::C) {
+			generator.flipCarry();
+		}
+		generateOverflowUpdate();
+		return;
+	}
+	
 	generator.jumpIfNotCarry(32); // 2 bytes
 	generator.jumpIfOverflow(12); // 2 bytes
 	
@@ -2,26 +2,28 @@
 #pragma once
 
 #include "cpu/arm/armthumbinstr.h"
-#include "cpu/x86codegenerator.h"
+#include "cpu/arm/armflags.h"
+#include "cpu/jitgenerator.h"
 #include "physicalmemory.h"
 #include "config.h"
 
+#include <vector>
 #include <cstdint>
 
 
 class ARMProcessor;
 
 
-class ARMThumbGenerator {
+class ARMThumbGenerator : public JITGenerator {
 public:
 	ARMThumbGenerator();
 	
-	char *get();
-	size_t size();
-	
 	void generate(uint16_t value);
 	
 private:
+	void generateBodies();
+	void analyzeFlags(ARMFlagLiveness *liveness, int index, ARMThumbInstr instr);
+	
 	void generateInstr(ARMThumbInstr instr);
 	void generateError(ARMThumbInstr instr);
 	void generateUndefined();
@@ -51,11 +53,13 @@ private:
 	void generateAddRegCarry(Register reg, Register other);
 	void generateSubRegCarry(Register reg, Register other);
 	void generateFlagsUpdate(Register reg);
+	void generateCarryUpdate();
 	void generateOverflowUpdate();
 	void generateOverflowUpdateInv();
 	void generateResultCheck();
-
-	X86CodeGenerator generator;
-	uint32_t offsets[0x800];
-	int index;
+	
+	std::vector<uint16_t> values;
+	
+	// Flags that are live after the current instruction
+	int flags;
 };
@@ -0,0 +1,77 @@
+#include "cpu/codearena.h"
+
+#include "common/exceptions.h"
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cstring>
+
+
+// Chunks are aligned to cache lines
+static const size_t Alignment = 64;
+
+
+CodeArena::CodeArena(size_t size) {
+	capacity = size;
+	offset = 0;
+	
+	int fd = memfd_create("jit", 0);
+	if (fd < 0) {
+		runtime_error("Failed to create code arena");
+	}
+	if (ftruncate(fd, size) < 0) {
+		close(fd);
+		runtime_error("Failed to resize code arena");
+	}
+	
+	writable = (char *)mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	executable = (char *)mmap(NULL, size, PROT_READ | PROT_EXEC, MAP_SHARED, fd, 0);
+	close(fd);
+	
+	if (writable == MAP_FAILED || executable == MAP_FAILED) {
+		runtime_error("Failed to map code arena");
+	}
+}
+
+CodeArena::~CodeArena() {
+	munmap(writable, capacity);
+	munmap(executable, capacity);
+}
+
+char *CodeArena::alloc(size_t size) {
+	size = (size + Alignment - 1) & ~(Alignment - 1);
+	
+	auto it = freeList.lower_bound(size);
+	if (it != freeList.end()) {
+		char *code = it->second;
+		size_t remaining = it->first - size;
+		freeList.erase(it);
+		if (remaining) {
+			freeList.insert(std::make_pair(remaining, code + size));
+		}
+		return code;
+	}
+	
+	if (offset + size > capacity) {
+		return nullptr;
+	}
+	
+	char *code = executable + offset;
+	offset += size;
+	return code;
+}
+
+void CodeArena::free(char *code, size_t size) {
+	size = (size + Alignment - 1) & ~(Alignment - 1);
+	freeList.insert(std::make_pair(size, code));
+}
+
+void CodeArena::reset() {
+	freeList.clear();
+	offset = 0;
+}
+
+void CodeArena::write(char *code, const void *data, size_t size) {
+	memcpy(getWritable<char>(code), data, size);
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <map>
+
+#include <cstddef>
+
+
+/*	Executable memory for the code of a JIT. The arena is reserved once and
+	mapped twice: a writable view that the code is copied into and patched
+	through, and an executable view that the host runs. No memory is ever
+	writable and executable at the same time.
+	
+	Code is allocated from a free list of released chunks or from the end
+	of the arena. If the arena is full, allocation fails and the JIT must
+	release all of its code and reset the arena.
+*/
+
+class CodeArena {
+public:
+	CodeArena(size_t size);
+	~CodeArena();
+	
+	// Returns the executable address of the code, or null
+	char *alloc(size_t size);
+	void free(char *code, size_t size);
+	void reset();
+	
+	// Copies code into the arena
+	void write(char *code, const void *data, size_t size);
+	
+	// Returns the writable address of executable code
+	template <class T>
+	T *getWritable(char *code) {
+		return (T *)(code + (writable - executable));
+	}
+
+private:
+	size_t capacity;
+	size_t offset;
+	
+	char *writable;
+	char *executable;
+	
+	std::multimap<size_t, char *> freeList;
+};
@@ -24,51 +24,53 @@ static int64_t sign8(uint8_t value) {
 
 DSPStack::DSPStack(int capacity) {
 	this->capacity = capacity;
+	this->count = 0;
 }
 
 void DSPStack::clear() {
-	stack.clear();
+	count = 0;
 }
 
 void DSPStack::push(uint16_t value) {
-	if (stack.size() == capacity) {
+	if (count == capacity) {
 		runtime_error("DSP stack overflow");
 	}
-	stack.push_back(value);
+	stack[count++] = value;
 }
 
 uint16_t DSPStack::peek() {
-	if (stack.empty()) {
+	if (count == 0) {
 		runtime_error("DSP stack underflow");
 	}
-	return stack[stack.size() - 1];
+	return stack[count - 1];
 }
 
 uint16_t DSPStack::pop() {
 	uint16_t value = peek();
-	stack.pop_back();
+	count--;
 	return value;
 }
 
 uint16_t DSPStack::get(int index) {
-	if (index >= stack.size()) {
+	if (index >= count) {
 		runtime_error("DSP stack invalid index");
 	}
-	return stack[stack.size() - index - 1];
+	return stack[count - index - 1];
 }
 
 bool DSPStack::empty() {
-	return stack.empty();
+	return count == 0;
 }
 
 int DSPStack::size() {
-	return stack.size();
+	return count;
 }
 
 
 DSPInterpreter::DSPInterpreter(Emulator *emulator) :
 	Processor(emulator, 4, false),
-	st {8, 8, 4, 4}
+	st {8, 8, 4, 4},
+	jit(this)
 {
 	Buffer irom_data = FileUtils::load("files/dsp_irom.bin");
 	if (irom_data.size() > sizeof(irom)) {
@@ -83,11 +85,19 @@ DSPInterpreter::DSPInterpreter(Emulator *emulator) :
 	memcpy(irom, irom_data.get(), irom_data.size());
 	memcpy(drom, drom_data.get(), drom_data.size());
 	
+	init_decoder();
+	
+	for (int i = 0; i < 0x1000; i++) {
+		irom_decoded[i].handler = nullptr;
+	}
+	invalidate_code(0, 0x2000);
+	
 	dma_logger.init("logs/dspdma.txt");
 }
 
 void DSPInterpreter::reset() {
 	memset(iram, 0, sizeof(iram));
+	invalidate_code(0, 0x2000);
 	memset(dram, 0, sizeof(dram));
 	memset(ar, 0, sizeof(ix));
 	memset(ix, 0, sizeof(ix));
@@ -202,6 +212,9 @@ void DSPInterpreter::write(uint16_t addr, uint16_t value) {
 		}
 		else {
 			physmem->read(dma_addr_main, ptr, value);
+			if (dma_control & 2) {
+				invalidate_code(dma_addr_dsp, value / 2);
+			}
 		}
 		
 		#if DSPDMA
@@ -336,7 +349,8 @@ void DSPInterpreter::writereg(int reg, uint16_t value) {
 // the exception. For now I'm assuming that the exception
 // is triggered periodically by the DSP itself. This at
 // least prevents the DSP from getting stuck while waiting
-// for the bit in @dspState.
+// for the bit in @dspState. The timer counts DSP instructions
+// rather than hardware ticks, so it is not a scheduler event.
 void DSPInterpreter::update_timer() {
 	if (!(status.get(1 << 10))) { // No idea if this is correct
 		if (timer-- == 0) {
@@ -353,69 +367,117 @@ void DSPInterpreter::trigger_exception(int type) {
 	pc = type * 2;
 }
 
+const DSPInterpreter::Opcode *DSPInterpreter::decode_table[0x10000];
+
+void DSPInterpreter::init_decoder() {
+	// The first opcode that matches is used
+	static const Opcode opcodes[] = {
+		{0xFFFF, 0x0000, &DSPInterpreter::nop, 1},
+		{0xFFFC, 0x0008, &DSPInterpreter::iar, 1},
+		{0xFFE0, 0x0040, &DSPInterpreter::loop, 1},
+		{0xFFE0, 0x0060, &DSPInterpreter::bloop, 2},
+		{0xFFE0, 0x0080, &DSPInterpreter::lri, 2},
+		{0xFFE0, 0x00C0, &DSPInterpreter::lr, 2},
+		{0xFFE0, 0x00E0, &DSPInterpreter::sr, 2},
+		{0xFEFC, 0x0210, &DSPInterpreter::ilrr, 1},
+		{0xFEFC, 0x0218, &DSPInterpreter::ilrri, 1},
+		{0xFEFF, 0x0240, &DSPInterpreter::andi, 2},
+		{0xFEFF, 0x0260, &DSPInterpreter::ori, 2},
+		{0xFFF0, 0x0290, &DSPInterpreter::jcc, 2},
+		{0xFEFF, 0x02A0, &DSPInterpreter::andf, 2},
+		{0xFFFF, 0x02BF, &DSPInterpreter::call, 2},
+		{0xFEFF, 0x02C0, &DSPInterpreter::andcf, 2},
+		{0xFFFF, 0x02DF, &DSPInterpreter::ret, 1},
+		{0xFFFF, 0x02FF, &DSPInterpreter::rti, 1},
+		{0xFE00, 0x0400, &DSPInterpreter::addis, 1},
+		{0xF800, 0x0800, &DSPInterpreter::lris, 1},
+		{0xFF00, 0x1100, &DSPInterpreter::bloopi, 2},
+		{0xFFF8, 0x1200, &DSPInterpreter::sbset, 1},
+		{0xFFF8, 0x1300, &DSPInterpreter::sbclr, 1},
+		{0xFEC0, 0x1400, &DSPInterpreter::lsl, 1},
+		{0xFEC0, 0x1440, &DSPInterpreter::lsr, 1},
+		{0xFF00, 0x1600, &DSPInterpreter::si, 2},
+		{0xFF1F, 0x170F, &DSPInterpreter::jmpr, 1},
+		{0xFF1F, 0x171F, &DSPInterpreter::callr, 1},
+		{0xFF80, 0x1800, &DSPInterpreter::lrr, 1},
+		{0xFF80, 0x1900, &DSPInterpreter::lrri, 1},
+		{0xFF80, 0x1980, &DSPInterpreter::lrrn, 1},
+		{0xFF80, 0x1A00, &DSPInterpreter::srr, 1},
+		{0xFF80, 0x1B00, &DSPInterpreter::srri, 1},
+		{0xFF80, 0x1B80, &DSPInterpreter::srrn, 1},
+		{0xFC00, 0x1C00, &DSPInterpreter::mrr, 1},
+		{0xF800, 0x2000, &DSPInterpreter::lrs, 1},
+		{0xF800, 0x2800, &DSPInterpreter::srs, 1},
+		{0xFC80, 0x3000, &DSPInterpreter::xorr, 1},
+		{0xFC80, 0x3080, &DSPInterpreter::xorc, 1},
+		{0xFC80, 0x3400, &DSPInterpreter::andr, 1},
+		{0xFC80, 0x3800, &DSPInterpreter::orr, 1},
+		{0xFE80, 0x3E00, &DSPInterpreter::orc, 1},
+		{0xF800, 0x4000, &DSPInterpreter::addr, 1},
+		{0xFC00, 0x4800, &DSPInterpreter::addax, 1},
+		{0xFE00, 0x4C00, &DSPInterpreter::add, 1},
+		{0xF800, 0x5000, &DSPInterpreter::subr, 1},
+		{0xFE00, 0x5C00, &DSPInterpreter::sub, 1},
+		{0xFE00, 0x7400, &DSPInterpreter::incm, 1},
+		{0xFE00, 0x7600, &DSPInterpreter::inc, 1},
+		{0xF700, 0x8100, &DSPInterpreter::clr, 1},
+		{0xFF00, 0x8200, &DSPInterpreter::cmp, 1},
+		{0xFE00, 0x8A00, &DSPInterpreter::setam, 1},
+		{0xFE00, 0x8C00, &DSPInterpreter::setsu, 1},
+		{0xFE00, 0x8E00, &DSPInterpreter::sxm, 1},
+		{0xF700, 0xB100, &DSPInterpreter::tst, 1},
+		{0x0000, 0x0000, &DSPInterpreter::unknown, 1}
+	};
+	
+	if (decode_table[0]) return;
+	
+	for (int instr = 0; instr < 0x10000; instr++) {
+		const Opcode *opcode = opcodes;
+		while ((instr & opcode->mask) != opcode->value) {
+			opcode++;
+		}
+		decode_table[instr] = opcode;
+	}
+}
+
+DSPInterpreter::DecodedInstr *DSPInterpreter::decode(uint16_t addr) {
+	DecodedInstr *instr;
+	if (addr < 0x2000) {
+		instr = &iram_decoded[addr];
+	}
+	else if (0x8000 <= addr && addr < 0x9000) {
+		instr = &irom_decoded[addr - 0x8000];
+	}
+	else {
+		runtime_error("DSP invalid instruction address: 0x%X", addr);
+		return nullptr;
+	}
+	
+	if (!instr->handler) {
+		uint16_t value = read_code(addr);
+		const Opcode *opcode = decode_table[value];
+		instr->handler = opcode->handler;
+		instr->value = value;
+		instr->size = opcode->size;
+	}
+	return instr;
+}
+
+// Must be called when IRAM is written
+void DSPInterpreter::invalidate_code(uint16_t addr, uint16_t length) {
+	for (int i = 0; i < length; i++) {
+		iram_decoded[addr + i].handler = nullptr;
+	}
+	jit.invalidate(addr, length);
+}
+
 void DSPInterpreter::step() {
 	update_timer();
 	
 	uint16_t prev = this->pc;
 	
-	uint16_t instr = fetch();
-	if (instr == 0) nop(instr);
-	else if ((instr & 0xFFFC) == 0x0008) iar(instr);
-	else if ((instr & 0xFFE0) == 0x0040) loop(instr);
-	else if ((instr & 0xFFE0) == 0x0060) bloop(instr);
-	else if ((instr & 0xFFE0) == 0x0080) lri(instr);
-	else if ((instr & 0xFFE0) == 0x00C0) lr(instr);
-	else if ((instr & 0xFFE0) == 0x00E0) sr(instr);
-	else if ((instr & 0xFEFC) == 0x0210) ilrr(instr);
-	else if ((instr & 0xFEFC) == 0x0218) ilrri(instr);
-	else if ((instr & 0xFEFF) == 0x0240) andi(instr);
-	else if ((instr & 0xFEFF) == 0x0260) ori(instr);
-	else if ((instr & 0xFFF0) == 0x0290) jcc(instr);
-	else if ((instr & 0xFEFF) == 0x02A0) andf(instr);
-	else if ((instr & 0xFFFF) == 0x02BF) call(instr);
-	else if ((instr & 0xFEFF) == 0x02C0) andcf(instr);
-	else if ((instr & 0xFFFF) == 0x02DF) ret(instr);
-	else if ((instr & 0xFFFF) == 0x02FF) rti(instr);
-	else if ((instr & 0xFE00) == 0x0400) addis(instr);
-	else if ((instr & 0xF800) == 0x0800) lris(instr);
-	else if ((instr & 0xFF00) == 0x1100) bloopi(instr);
-	else if ((instr & 0xFFF8) == 0x1200) sbset(instr);
-	else if ((instr & 0xFFF8) == 0x1300) sbclr(instr);
-	else if ((instr & 0xFEC0) == 0x1400) lsl(instr);
-	else if ((instr & 0xFEC0) == 0x1440) lsr(instr);
-	else if ((instr & 0xFF00) == 0x1600) si(instr);
-	else if ((instr & 0xFF1F) == 0x170F) jmpr(instr);
-	else if ((instr & 0xFF1F) == 0x171F) callr(instr);
-	else if ((instr & 0xFF80) == 0x1800) lrr(instr);
-	else if ((instr & 0xFF80) == 0x1900) lrri(instr);
-	else if ((instr & 0xFF80) == 0x1980) lrrn(instr);
-	else if ((instr & 0xFF80) == 0x1A00) srr(instr);
-	else if ((instr & 0xFF80) == 0x1B00) srri(instr);
-	else if ((instr & 0xFF80) == 0x1B80) srrn(instr);
-	else if ((instr & 0xFC00) == 0x1C00) mrr(instr);
-	else if ((instr & 0xF800) == 0x2000) lrs(instr);
-	else if ((instr & 0xF800) == 0x2800) srs(instr);
-	else if ((instr & 0xFC80) == 0x3000) xorr(instr);
-	else if ((instr & 0xFC80) == 0x3080) xorc(instr);
-	else if ((instr & 0xFC80) == 0x3400) andr(instr);
-	else if ((instr & 0xFC80) == 0x3800) orr(instr);
-	else if ((instr & 0xFE80) == 0x3E00) orc(instr);
-	else if ((instr & 0xF800) == 0x4000) addr(instr);
-	else if ((instr & 0xFC00) == 0x4800) addax(instr);
-	else if ((instr & 0xFE00) == 0x4C00) add(instr);
-	else if ((instr & 0xF800) == 0x5000) subr(instr);
-	else if ((instr & 0xFE00) == 0x5C00) sub(instr);
-	else if ((instr & 0xFE00) == 0x7400) incm(instr);
-	else if ((instr & 0xFE00) == 0x7600) inc(instr);
-	else if ((instr & 0xF700) == 0x8100) clr(instr);
-	else if ((instr & 0xFF00) == 0x8200) cmp(instr);
-	else if ((instr & 0xFE00) == 0x8A00) setam(instr);
-	else if ((instr & 0xFE00) == 0x8C00) setsu(instr);
-	else if ((instr & 0xFE00) == 0x8E00) sxm(instr);
-	else if ((instr & 0xF700) == 0xB100) tst(instr);
-	else {
-		runtime_error("Unknown DSP instruction at 0x%X: 0x%04X", pc - 1, instr);
-	}
+	DecodedInstr *instr = decode(pc++);
+	(this->*instr->handler)(instr->value);
 	
 	if (!st[2].empty() && st[2].peek() == prev) {
 		uint16_t counter = st[3].pop() - 1;
@@ -438,20 +500,52 @@ void DSPInterpreter::step() {
 	#endif
 }
 
+// Compiled blocks are not used while the debugger needs to see every
+// instruction or memory access
+void DSPInterpreter::stepBlock() {
+	execute(BlockLimit);
+}
+
+int DSPInterpreter::execute(int limit) {
+	#if BREAKPOINTS
+	if (!breakpoints.empty()) {
+		step();
+		return 1;
+	}
+	#endif
+	
+	#if WATCHPOINTS
+	if (hasWatchpoints()) {
+		step();
+		return 1;
+	}
+	#endif
+	
+	// The timer exception is triggered by the interpreter
+	bool timer_enabled = !status.get(1 << 10);
+	if (timer_enabled && timer < limit) {
+		limit = timer;
+	}
+	
+	int instrs = jit.execute(pc, limit);
+	if (!instrs) {
+		step();
+		return 1;
+	}
+	
+	if (timer_enabled) {
+		timer -= instrs;
+	}
+	
+	#if STATS
+	instrs_executed += instrs;
+	#endif
+	
+	return instrs;
+}
+
 void DSPInterpreter::skip() {
-	uint16_t instr = fetch();
-	if ((instr & 0xFFE0) == 0x0060) pc++; // bloop
-	else if ((instr & 0xFFE0) == 0x0080) pc++; // lri
-	else if ((instr & 0xFFE0) == 0x00C0) pc++; // lr
-	else if ((instr & 0xFFE0) == 0x00E0) pc++; // sr
-	else if ((instr & 0xFEFF) == 0x0240) pc++; // andi
-	else if ((instr & 0xFEFF) == 0x0260) pc++; // ori
-	else if ((instr & 0xFFF0) == 0x0290) pc++; // jcc
-	else if ((instr & 0xFEFF) == 0x02A0) pc++; // andf
-	else if ((instr & 0xFFFF) == 0x02BF) pc++; // call
-	else if ((instr & 0xFEFF) == 0x02C0) pc++; // andcf
-	else if ((instr & 0xFF00) == 0x1100) pc++; // bloopi
-	else if ((instr & 0xFF00) == 0x1600) pc++; // si
+	pc += decode(pc)->size;
 }
 
 bool DSPInterpreter::checkcond(int cond) {
@@ -792,6 +886,10 @@ void DSPInterpreter::tst(uint16_t instr) {
 	doext(instr & 0xFF);
 }
 
+void DSPInterpreter::unknown(uint16_t instr) {
+	runtime_error("Unknown DSP instruction at 0x%X: 0x%04X", pc - 1, instr);
+}
+
 void DSPInterpreter::xorc(uint16_t instr) {
 	int d = (instr >> 8) & 1;
 	ac[d].m ^= ac[1 - d].m;
@@ -1,10 +1,10 @@
 
 #pragma once
 
+#include "cpu/dspjit.h"
 #include "cpu/processor.h"
 #include "common/bits.h"
 #include "logger.h"
-#include <vector>
 #include <cstdint>
 
 
@@ -22,8 +22,11 @@ public:
 	int size();
 
 private:
+	friend class DSPCodeGenerator;
+	
 	int capacity;
-	std::vector<uint16_t> stack;
+	int count;
+	uint16_t stack[8];
 };
 
 
@@ -133,8 +136,16 @@ public:
 	
 	DSPInterpreter(Emulator *emulator);
 	
+	// Maximum number of instructions per call of stepBlock
+	static const int BlockLimit = 256;
+	
 	void reset();
 	void step();
+	void stepBlock();
+	
+	// Executes at most the given number of instructions and
+	// returns the number of instructions that were executed
+	int execute(int limit);
 
 	uint16_t readreg(int reg);
 
@@ -185,6 +196,30 @@ public:
 	FileLogger dma_logger;
 
 private:
+	friend class DSPCodeGenerator;
+	
+	typedef void (DSPInterpreter::*Handler)(uint16_t instr);
+	
+	struct Opcode {
+		uint16_t mask;
+		uint16_t value;
+		Handler handler;
+		int size; // Number of words, including the immediate
+	};
+	
+	// An instruction in IRAM or IROM that was decoded when
+	// it was executed for the first time
+	struct DecodedInstr {
+		Handler handler;
+		uint16_t value;
+		uint16_t size;
+	};
+	
+	static void init_decoder();
+	
+	DecodedInstr *decode(uint16_t addr);
+	void invalidate_code(uint16_t addr, uint16_t length);
+	
 	void *dma_ptr(uint16_t addr, uint16_t length, bool code);
 	
 	void skip();
@@ -259,6 +294,14 @@ private:
 	void subr(uint16_t instr);
 	void sxm(uint16_t instr);
 	void tst(uint16_t instr);
+	void unknown(uint16_t instr);
 	void xorc(uint16_t instr);
 	void xorr(uint16_t instr);
+	
+	static const Opcode *decode_table[0x10000];
+	
+	DecodedInstr iram_decoded[0x2000];
+	DecodedInstr irom_decoded[0x1000];
+	
+	DSPJIT jit;
 };
@@ -0,0 +1,856 @@
+#include "cpu/dspcodegenerator.h"
+#include "cpu/dsp.h"
+
+#include <cstddef>
+
+
+#define PC offsetof(DSPInterpreter, pc)
+#define STATUS offsetof(DSPInterpreter, status)
+#define DRAM offsetof(DSPInterpreter, dram)
+
+#define REG_AR(i) (offsetof(DSPInterpreter, ar) + (i) * 2)
+#define REG_IX(i) (offsetof(DSPInterpreter, ix) + (i) * 2)
+#define REG_WR(i) (offsetof(DSPInterpreter, wr) + (i) * 2)
+#define REG_AC(i) (offsetof(DSPInterpreter, ac) + (i) * 8)
+#define REG_AX(i) (offsetof(DSPInterpreter, ax) + (i) * 4)
+#define REG_CONFIG offsetof(DSPInterpreter, config)
+
+#define STACK(i) (offsetof(DSPInterpreter, st) + (i) * sizeof(DSPStack))
+#define STACK_SIZE(i) (STACK(i) + offsetof(DSPStack, count))
+#define STACK_DATA(i) (STACK(i) + offsetof(DSPStack, stack))
+
+// Reads below 0x3800 may access DRAM and DROM through the same pointer
+static_assert(
+	offsetof(DSPInterpreter, drom) == offsetof(DSPInterpreter, dram) + sizeof(DSPInterpreter::dram),
+	"DROM must follow DRAM"
+);
+
+
+static uint16_t sign8(uint8_t value) {
+	return (int8_t)value;
+}
+
+
+uint32_t DSPCodeGenerator::readMemory(DSPInterpreter *cpu, uint32_t addr) {
+	return cpu->read(addr);
+}
+
+void DSPCodeGenerator::pushLoop(DSPInterpreter *cpu, uint32_t start, uint32_t end, uint32_t count) {
+	cpu->st[0].push(start);
+	cpu->st[2].push(end);
+	cpu->st[3].push(count);
+}
+
+
+DSPCodeGenerator::DSPCodeGenerator(DSPInterpreter *cpu) : generator(0x1000) {
+	this->cpu = cpu;
+	
+	end = 0;
+	length = 0;
+	pending = 0;
+	
+	inLoop = false;
+	loop.start = 0;
+	loop.end = 0;
+}
+
+char *DSPCodeGenerator::get() {
+	return generator.get();
+}
+
+size_t DSPCodeGenerator::size() {
+	return generator.size();
+}
+
+uint16_t DSPCodeGenerator::getEnd() {
+	return end;
+}
+
+int DSPCodeGenerator::getLength() {
+	return length;
+}
+
+void DSPCodeGenerator::generate(uint16_t start) {
+	generatePrologue();
+	generateBody(start);
+}
+
+void DSPCodeGenerator::generateResume(uint16_t start, uint16_t loopEnd) {
+	generatePrologue();
+	
+	Loop loop = {start, loopEnd};
+	
+	int bodyLength;
+	uint16_t next;
+	if (!scanLoop(loop, &bodyLength, &next)) {
+		end = start;
+		generateExit(start);
+		generateExits();
+		return;
+	}
+	
+	// The loop counter is on top of st3
+	generator.loadMem32(RAX, RBX, STACK_SIZE(3));
+	generator.addRegReg32(RAX, RAX);
+	generator.addRegReg64(RAX, RBX);
+	generator.loadMem16(RAX, RAX, STACK_DATA(3) - 2);
+	generator.testReg32(RAX, RAX);
+	generateExitIf(Equal, start);
+	
+	generator.decMem32(RBX, STACK_SIZE(0));
+	generator.decMem32(RBX, STACK_SIZE(2));
+	generator.decMem32(RBX, STACK_SIZE(3));
+	
+	generateLoopBody(loop, bodyLength);
+	generateBody(next);
+}
+
+void DSPCodeGenerator::generatePrologue() {
+	// The limit is kept at [RSP] and the loop counter at [RSP + 4]
+	generator.pushReg64(RBX);
+	generator.pushReg64(RBP);
+	generator.pushReg64(RSI);
+	
+	generator.movReg64(RBX, RDI);
+	generator.movImm32(RBP, 0);
+}
+
+void DSPCodeGenerator::generateBody(uint16_t addr) {
+	uint16_t instr, imm;
+	int size;
+	while (length < MaxLength && fetch(addr, &instr, &imm, &size)) {
+		if (isLoop(instr)) {
+			if (!generateLoop(addr, instr, imm, &addr)) break;
+		}
+		else if (isJump(instr)) {
+			generateJump(addr, instr, imm);
+			end = addr + size;
+			generateExits();
+			return;
+		}
+		else if (isNative(instr, imm)) {
+			generateInstr(addr, instr, imm, size);
+			pending++;
+			length++;
+			addr += size;
+		}
+		else {
+			break;
+		}
+		end = addr;
+	}
+	
+	end = addr;
+	generateExit(addr);
+	generateExits();
+}
+
+DSPCodeGenerator::Handler DSPCodeGenerator::decode(uint16_t instr) {
+	return DSPInterpreter::decode_table[instr]->handler;
+}
+
+bool DSPCodeGenerator::fetch(uint16_t addr, uint16_t *instr, uint16_t *imm, int *size) {
+	for (int i = 0; i < 2; i++) {
+		uint16_t pos = addr + i;
+		bool valid = pos < 0x2000 || (0x8000 <= pos && pos < 0x9000);
+		if (!valid) return false;
+		
+		uint16_t value = cpu->read_code(pos);
+		if (i == 0) {
+			*instr = value;
+			*size = DSPInterpreter::decode_table[value]->size;
+			if (*size == 1) break;
+		}
+		else {
+			*imm = value;
+		}
+	}
+	return true;
+}
+
+bool DSPCodeGenerator::isLoop(uint16_t instr) {
+	Handler handler = decode(instr);
+	return handler == &DSPInterpreter::loop ||
+		handler == &DSPInterpreter::bloop ||
+		handler == &DSPInterpreter::bloopi;
+}
+
+bool DSPCodeGenerator::isJump(uint16_t instr) {
+	if (decode(instr) != &DSPInterpreter::jcc) return false;
+	
+	// Other conditions are not supported by the interpreter
+	int cond = instr & 0xF;
+	return cond <= 2 || cond == 4 || cond == 5 || cond == 12 || cond == 13 || cond == 15;
+}
+
+// The stack registers pop and push values, which
+// may throw an exception, and are not compiled
+bool DSPCodeGenerator::isReadable(int reg) {
+	return reg < DSPInterpreter::ST0 || reg > DSPInterpreter::ST3;
+}
+
+bool DSPCodeGenerator::isWritable(int reg) {
+	if (reg <= DSPInterpreter::IX3) return true;
+	if (reg == DSPInterpreter::CONFIG) return true;
+	return reg >= DSPInterpreter::AX0L || reg == DSPInterpreter::AC0H || reg == DSPInterpreter::AC1H;
+}
+
+bool DSPCodeGenerator::isNative(uint16_t instr, uint16_t imm) {
+	Handler handler = decode(instr);
+	
+	int reg = instr & 0x1F;
+	
+	if (handler == &DSPInterpreter::nop) return true;
+	if (handler == &DSPInterpreter::iar) return true;
+	if (handler == &DSPInterpreter::lris) return true;
+	if (handler == &DSPInterpreter::lrs) return true;
+	if (handler == &DSPInterpreter::addis) return true;
+	if (handler == &DSPInterpreter::andi) return true;
+	if (handler == &DSPInterpreter::ori) return true;
+	if (handler == &DSPInterpreter::andf) return true;
+	if (handler == &DSPInterpreter::andcf) return true;
+	if (handler == &DSPInterpreter::lsl) return true;
+	if (handler == &DSPInterpreter::lsr) return true;
+	
+	if (handler == &DSPInterpreter::lri) return isWritable(reg);
+	if (handler == &DSPInterpreter::lr) return isWritable(reg);
+	if (handler == &DSPInterpreter::lrr) return isWritable(reg);
+	if (handler == &DSPInterpreter::lrri) return isWritable(reg);
+	if (handler == &DSPInterpreter::lrrn) return isWritable(reg);
+	if (handler == &DSPInterpreter::mrr) {
+		return isReadable(reg) && isWritable((instr >> 5) & 0x1F);
+	}
+	
+	// Stores to hardware registers are left to the interpreter
+	if (handler == &DSPInterpreter::sr) return isReadable(reg) && imm < 0x3000;
+	if (handler == &DSPInterpreter::srs) return !(instr & 0x80);
+	if (handler == &DSPInterpreter::si) return !(instr & 0x80);
+	if (handler == &DSPInterpreter::srr) return isReadable(reg);
+	if (handler == &DSPInterpreter::srrn) return isReadable(reg);
+	if (handler == &DSPInterpreter::srri) {
+		// The order of the increment and the register read is unspecified
+		return isReadable(reg) && reg != ((instr >> 5) & 3);
+	}
+	
+	// Bit 10 of the status register disables the timer
+	if (handler == &DSPInterpreter::sbset || handler == &DSPInterpreter::sbclr) {
+		return (instr & 7) != 4;
+	}
+	
+	// Extended opcodes are not supported
+	if (handler == &DSPInterpreter::add || handler == &DSPInterpreter::addax ||
+		handler == &DSPInterpreter::addr || handler == &DSPInterpreter::sub ||
+		handler == &DSPInterpreter::subr || handler == &DSPInterpreter::inc ||
+		handler == &DSPInterpreter::incm || handler == &DSPInterpreter::cmp ||
+		handler == &DSPInterpreter::clr || handler == &DSPInterpreter::tst ||
+		handler == &DSPInterpreter::setam || handler == &DSPInterpreter::setsu ||
+		handler == &DSPInterpreter::sxm) {
+		return !(instr & 0xFF);
+	}
+	if (handler == &DSPInterpreter::andr || handler == &DSPInterpreter::orr ||
+		handler == &DSPInterpreter::xorr || handler == &DSPInterpreter::orc ||
+		handler == &DSPInterpreter::xorc) {
+		return !(instr & 0x7F);
+	}
+	return false;
+}
+
+// The body must consist of native instructions, the last
+// of which starts exactly at the end address of the loop
+bool DSPCodeGenerator::scanLoop(Loop loop, int *bodyLength, uint16_t *next) {
+	int count = 0;
+	uint16_t addr = loop.start;
+	while (addr <= loop.end) {
+		uint16_t instr, imm;
+		int size;
+		if (length + count + 1 >= MaxLength) return false;
+		if (!fetch(addr, &instr, &imm, &size)) return false;
+		if (isLoop(instr) || !isNative(instr, imm)) return false;
+		
+		count++;
+		if (addr == loop.end) {
+			*bodyLength = count;
+			*next = addr + size;
+			return true;
+		}
+		addr += size;
+	}
+	return false;
+}
+
+bool DSPCodeGenerator::generateLoop(uint16_t addr, uint16_t instr, uint16_t imm, uint16_t *next) {
+	Handler handler = decode(instr);
+	
+	Loop loop;
+	if (handler == &DSPInterpreter::loop) {
+		loop.start = addr + 1;
+		loop.end = addr + 1;
+	}
+	else {
+		loop.start = addr + 2;
+		loop.end = imm;
+	}
+	
+	if (handler != &DSPInterpreter::bloopi && !isReadable(instr & 0x1F)) return false;
+	
+	int bodyLength;
+	if (!scanLoop(loop, &bodyLength, next)) return false;
+	
+	// The interpreter throws an exception if a stack is full
+	static const int capacity[] = {8, 0, 4, 4};
+	for (int i = 0; i < 4; i++) {
+		if (capacity[i]) {
+			generator.loadMem32(RAX, RBX, STACK_SIZE(i));
+			generator.compareImm32(RAX, capacity[i]);
+			generateExitIf(NotBelow, addr);
+		}
+	}
+	
+	if (handler == &DSPInterpreter::bloopi) {
+		generator.movImm32(RAX, instr & 0xFF);
+	}
+	else {
+		generateReadReg(RAX, instr & 0x1F);
+	}
+	
+	pending++;
+	length++;
+	
+	generator.addRegImm32(RBP, pending);
+	pending = 0;
+	
+	// The body is skipped if the counter is 0
+	generator.testReg32(RAX, RAX);
+	generator.jumpIf32(Equal, 0);
+	uint32_t skip = generator.tell();
+	
+	generateLoopBody(loop, bodyLength);
+	
+	setJumpTarget(skip);
+	return true;
+}
+
+// Expects the loop counter in RAX, which must not be 0
+void DSPCodeGenerator::generateLoopBody(Loop loop, int bodyLength) {
+	generator.storeMem32(RSP, 4, RAX);
+	
+	uint32_t top = generator.tell();
+	
+	// Leave the loop if the next iteration and the rest of the
+	// block may exceed the limit. The number of instructions is
+	// filled in once the block is complete.
+	generator.movReg32(RAX, RBP);
+	generator.addRegImm32(RAX, 0);
+	tails.push_back(std::make_pair(generator.tell() - 4, length));
+	generator.compareRegMem32(RAX, RSP, 0);
+	
+	inLoop = true;
+	this->loop = loop;
+	
+	generateExitIf(Greater, loop.start);
+	
+	uint16_t addr = loop.start;
+	for (int i = 0; i < bodyLength; i++) {
+		uint16_t instr, imm;
+		int size;
+		fetch(addr, &instr, &imm, &size);
+		generateInstr(addr, instr, imm, size);
+		pending++;
+		length++;
+		addr += size;
+	}
+	
+	generator.addRegImm32(RBP, pending);
+	pending = 0;
+	
+	inLoop = false;
+	
+	generator.decMem32(RSP, 4);
+	generator.jumpIf32(NotEqual, top - (generator.tell() + 6));
+}
+
+void DSPCodeGenerator::generateJump(uint16_t addr, uint16_t instr, uint16_t imm) {
+	pending++;
+	length++;
+	
+	int cond = instr & 0xF;
+	if (cond == 15) {
+		generateExit(imm);
+		return;
+	}
+	
+	generator.loadMem16(RAX, RBX, STATUS);
+	
+	Condition taken = Equal;
+	if (cond <= 2) {
+		// Compare the overflow and sign flags
+		generator.movReg32(RCX, RAX);
+		generator.shrImm32(RCX, 2);
+		generator.xorReg32(RCX, RAX);
+		generator.andImm32(RCX, DSPInterpreter::O);
+		if (cond == 1) taken = NotEqual;
+		if (cond == 2) {
+			generator.andImm32(RAX, DSPInterpreter::Z);
+			generator.orReg32(RCX, RAX);
+		}
+	}
+	else if (cond == 4 || cond == 5) {
+		generator.andImm32(RAX, DSPInterpreter::Z);
+		if (cond == 5) taken = NotEqual;
+	}
+	else {
+		generator.andImm32(RAX, DSPInterpreter::LZ);
+		if (cond == 13) taken = NotEqual;
+	}
+	
+	generateExitIf(taken, imm);
+	generateExit(addr + 2);
+}
+
+void DSPCodeGenerator::generateInstr(uint16_t addr, uint16_t instr, uint16_t imm, int size) {
+	Handler handler = decode(instr);
+	
+	int reg = instr & 0x1F;
+	int d = (instr >> 8) & 1;
+	
+	if (handler == &DSPInterpreter::nop) {}
+	else if (handler == &DSPInterpreter::iar) {
+		generator.loadMem16(RAX, RBX, REG_AR(instr & 3));
+		generator.addRegImm32(RAX, 1);
+		generator.storeMem16(RBX, REG_AR(instr & 3), RAX);
+	}
+	else if (handler == &DSPInterpreter::lri) {
+		generator.movImm32(RAX, imm);
+		generateWriteReg(reg, RAX);
+	}
+	else if (handler == &DSPInterpreter::lris) {
+		generator.movImm32(RAX, sign8(instr & 0xFF));
+		generateWriteReg(24 + ((instr >> 8) & 7), RAX);
+	}
+	else if (handler == &DSPInterpreter::mrr) {
+		generateReadReg(RAX, reg);
+		generateWriteReg((instr >> 5) & 0x1F, RAX);
+	}
+	else if (handler == &DSPInterpreter::lr) {
+		generateRead(imm, addr + size);
+		generateWriteReg(reg, RAX);
+	}
+	else if (handler == &DSPInterpreter::lrs) {
+		generateRead(sign8(instr & 0xFF), addr + size);
+		generateWriteReg(24 + ((instr >> 8) & 7), RAX);
+	}
+	else if (handler == &DSPInterpreter::lrr) {
+		generator.loadMem16(RAX, RBX, REG_AR((instr >> 5) & 3));
+		generateReadDynamic(addr + size);
+		generateWriteReg(reg, RAX);
+	}
+	else if (handler == &DSPInterpreter::lrri) {
+		generator.loadMem16(RAX, RBX, REG_AR((instr >> 5) & 3));
+		generateIncrement((instr >> 5) & 3, false);
+		generateReadDynamic(addr + size);
+		generateWriteReg(reg, RAX);
+	}
+	else if (handler == &DSPInterpreter::lrrn) {
+		generator.loadMem16(RAX, RBX, REG_AR((instr >> 5) & 3));
+		generateReadDynamic(addr + size);
+		generateWriteReg(reg, RAX);
+		generateIncrement((instr >> 5) & 3, true);
+	}
+	else if (handler == &DSPInterpreter::sr) {
+		generateReadReg(RAX, reg);
+		generateWrite(imm, RAX);
+	}
+	else if (handler == &DSPInterpreter::srs) {
+		generateReadReg(RAX, 24 + ((instr >> 8) & 7));
+		generateWrite(instr & 0xFF, RAX);
+	}
+	else if (handler == &DSPInterpreter::si) {
+		generator.movImm32(RAX, imm);
+		generateWrite(instr & 0xFF, RAX);
+	}
+	else if (handler == &DSPInterpreter::srr) {
+		generateWriteDynamic(addr, (instr >> 5) & 3, reg);
+	}
+	else if (handler == &DSPInterpreter::srri) {
+		generateWriteDynamic(addr, (instr >> 5) & 3, reg);
+		generateIncrement((instr >> 5) & 3, false);
+	}
+	else if (handler == &DSPInterpreter::srrn) {
+		generateWriteDynamic(addr, (instr >> 5) & 3, reg);
+		generateIncrement((instr >> 5) & 3, true);
+	}
+	else if (handler == &DSPInterpreter::add || handler == &DSPInterpreter::sub) {
+		generator.loadMem64(RCX, RBX, REG_AC(1 - d));
+		generator.shlImm64(RCX, 24);
+		if (handler == &DSPInterpreter::sub) {
+			generator.negReg64(RCX);
+		}
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::cmp) {
+		generator.loadMem64(RCX, RBX, REG_AC(1));
+		generator.shlImm64(RCX, 24);
+		generator.negReg64(RCX);
+		generateAdd(0, false);
+	}
+	else if (handler == &DSPInterpreter::addax) {
+		generator.loadMem32(RCX, RBX, REG_AX((instr >> 9) & 1));
+		generator.shlImm64(RCX, 24);
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::addr || handler == &DSPInterpreter::subr) {
+		generateReadReg(RCX, 24 + ((instr >> 9) & 3));
+		generator.shlImm32(RCX, 16);
+		if (handler == &DSPInterpreter::subr) {
+			generator.negReg32(RCX);
+		}
+		generator.signExtend32(RCX);
+		generator.shlImm64(RCX, 24);
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::addis) {
+		generator.movImm64(RCX, (uint64_t)(int8_t)instr << 40);
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::inc) {
+		generator.movImm64(RCX, 1ull << 24);
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::incm) {
+		generator.movImm64(RCX, 1ull << 40);
+		generateAdd(d, true);
+	}
+	else if (handler == &DSPInterpreter::clr) {
+		generator.movImm32(RAX, 0);
+		generator.storeMem64(RBX, REG_AC((instr >> 11) & 1), RAX);
+		generateStatus(DSPInterpreter::S, false);
+		generateStatus(DSPInterpreter::Z, true);
+	}
+	else if (handler == &DSPInterpreter::tst) {
+		generateTest((instr >> 11) & 1);
+	}
+	else if (handler == &DSPInterpreter::lsl || handler == &DSPInterpreter::lsr) {
+		generator.loadMem64(RAX, RBX, REG_AC(d));
+		if (handler == &DSPInterpreter::lsl) {
+			generator.shlImm64(RAX, instr & 0x3F);
+			generator.shlImm64(RAX, 24);
+			generator.shrImm64(RAX, 24);
+		}
+		else {
+			// A shift by 64 leaves the value unchanged on x86
+			generator.shrImm64(RAX, (64 - (instr & 0x3F)) & 0x3F);
+		}
+		generator.storeMem64(RBX, REG_AC(d), RAX);
+		generateTest(d);
+	}
+	else if (handler == &DSPInterpreter::andi || handler == &DSPInterpreter::ori ||
+		handler == &DSPInterpreter::andr || handler == &DSPInterpreter::orr ||
+		handler == &DSPInterpreter::xorr || handler == &DSPInterpreter::orc ||
+		handler == &DSPInterpreter::xorc) {
+		if (handler == &DSPInterpreter::andi || handler == &DSPInterpreter::ori) {
+			generator.movImm32(RCX, imm);
+		}
+		else if (handler == &DSPInterpreter::orc || handler == &DSPInterpreter::xorc) {
+			generator.loadMem16(RCX, RBX, REG_AC(1 - d) + 2);
+		}
+		else {
+			generator.loadMem16(RCX, RBX, REG_AX((instr >> 9) & 1) + 2);
+		}
+		
+		generator.loadMem16(RAX, RBX, REG_AC(d) + 2);
+		if (handler == &DSPInterpreter::andi || handler == &DSPInterpreter::andr) {
+			generator.andReg32(RAX, RCX);
+		}
+		else if (handler == &DSPInterpreter::xorr || handler == &DSPInterpreter::xorc) {
+			generator.xorReg32(RAX, RCX);
+		}
+		else {
+			generator.orReg32(RAX, RCX);
+		}
+		generator.storeMem16(RBX, REG_AC(d) + 2, RAX);
+		generateTest(d);
+	}
+	else if (handler == &DSPInterpreter::andf || handler == &DSPInterpreter::andcf) {
+		generator.loadMem16(RAX, RBX, REG_AC(d) + 2);
+		generator.andImm32(RAX, imm);
+		if (handler == &DSPInterpreter::andcf) {
+			generator.compareImm32(RAX, imm);
+		}
+		
+		// The zero flag of the host has the same position as LZ
+		generator.pushFlags();
+		generator.popReg64(RCX);
+		generator.andImm32(RCX, DSPInterpreter::LZ);
+		generator.loadMem16(RAX, RBX, STATUS);
+		generator.andImm32(RAX, ~DSPInterpreter::LZ);
+		generator.orReg32(RAX, RCX);
+		generator.storeMem16(RBX, STATUS, RAX);
+	}
+	else if (handler == &DSPInterpreter::sbset || handler == &DSPInterpreter::sbclr) {
+		generateStatus(1 << ((instr & 7) + 6), handler == &DSPInterpreter::sbset);
+	}
+	else if (handler == &DSPInterpreter::setam) {
+		generateStatus(DSPInterpreter::AM, d);
+	}
+	else if (handler == &DSPInterpreter::setsu) {
+		generateStatus(DSPInterpreter::SU, d);
+	}
+	else if (handler == &DSPInterpreter::sxm) {
+		generateStatus(DSPInterpreter::SXM, d);
+	}
+}
+
+void DSPCodeGenerator::generateReadReg(Register target, int reg) {
+	if (reg <= DSPInterpreter::AR3) generator.loadMem16(target, RBX, REG_AR(reg));
+	else if (reg <= DSPInterpreter::IX3) generator.loadMem16(target, RBX, REG_IX(reg - DSPInterpreter::IX0));
+	else if (reg <= DSPInterpreter::WR3) generator.loadMem16(target, RBX, REG_WR(reg - DSPInterpreter::WR0));
+	
+	else if (reg == DSPInterpreter::AX0L || reg == DSPInterpreter::AX1L) {
+		generator.loadMem16(target, RBX, REG_AX(reg - DSPInterpreter::AX0L));
+	}
+	else if (reg == DSPInterpreter::AX0H || reg == DSPInterpreter::AX1H) {
+		generator.loadMem16(target, RBX, REG_AX(reg - DSPInterpreter::AX0H) + 2);
+	}
+	
+	else if (reg == DSPInterpreter::AC0L || reg == DSPInterpreter::AC1L) {
+		generator.loadMem16(target, RBX, REG_AC(reg - DSPInterpreter::AC0L));
+	}
+	else if (reg == DSPInterpreter::AC0M || reg == DSPInterpreter::AC1M) {
+		generator.loadMem16(target, RBX, REG_AC(reg - DSPInterpreter::AC0M) + 2);
+	}
+	else if (reg == DSPInterpreter::AC0H || reg == DSPInterpreter::AC1H) {
+		generator.loadMem8(target, RBX, REG_AC(reg - DSPInterpreter::AC0H) + 4);
+	}
+	
+	else if (reg == DSPInterpreter::CONFIG) generator.loadMem16(target, RBX, REG_CONFIG);
+	else if (reg == DSPInterpreter::SR) generator.loadMem16(target, RBX, STATUS);
+	
+	// The product registers are not implemented
+	else {
+		generator.movImm32(target, 0);
+	}
+}
+
+// The value must be in RAX, RCX or RDX
+void DSPCodeGenerator::generateWriteReg(int reg, Register value) {
+	if (reg <= DSPInterpreter::AR3) generator.storeMem16(RBX, REG_AR(reg), value);
+	else if (reg <= DSPInterpreter::IX3) generator.storeMem16(RBX, REG_IX(reg - DSPInterpreter::IX0), value);
+	
+	else if (reg == DSPInterpreter::CONFIG) generator.storeMem16(RBX, REG_CONFIG, value);
+	
+	else if (reg == DSPInterpreter::AX0L || reg == DSPInterpreter::AX1L) {
+		generator.storeMem16(RBX, REG_AX(reg - DSPInterpreter::AX0L), value);
+	}
+	else if (reg == DSPInterpreter::AX0H || reg == DSPInterpreter::AX1H) {
+		generator.storeMem16(RBX, REG_AX(reg - DSPInterpreter::AX0H) + 2, value);
+	}
+	
+	else if (reg == DSPInterpreter::AC0L || reg == DSPInterpreter::AC1L) {
+		generator.storeMem16(RBX, REG_AC(reg - DSPInterpreter::AC0L), value);
+	}
+	else if (reg == DSPInterpreter::AC0H || reg == DSPInterpreter::AC1H) {
+		generator.storeMem8(RBX, REG_AC(reg - DSPInterpreter::AC0H) + 4, value);
+	}
+	else if (reg == DSPInterpreter::AC0M || reg == DSPInterpreter::AC1M) {
+		int r = reg - DSPInterpreter::AC0M;
+		generator.storeMem16(RBX, REG_AC(r) + 2, value);
+		
+		// With SXM, the value is sign extended into the high
+		// part of the accumulator and the low part is cleared
+		Register temp = value == RDX ? RCX : RDX;
+		generator.loadMem16(temp, RBX, STATUS);
+		generator.bitTestReg32(temp, 14);
+		generator.jumpIfNotCarry32(0);
+		uint32_t skip = generator.tell();
+		
+		generator.signExtend16(value);
+		generator.signExtend32(value);
+		generator.shlImm64(value, 40);
+		generator.shrImm64(value, 24);
+		generator.storeMem64(RBX, REG_AC(r), value);
+		
+		setJumpTarget(skip);
+	}
+}
+
+// Returns the value in RAX
+void DSPCodeGenerator::generateRead(uint16_t addr, uint16_t pc) {
+	if (addr < 0x3800) {
+		generator.loadMem16(RAX, RBX, DRAM + addr * 2);
+		generator.swap16(RAX);
+	}
+	else {
+		// Hardware registers may log the program counter
+		generator.movImm32(RAX, pc);
+		generator.storeMem16(RBX, PC, RAX);
+		
+		generator.movReg64(RDI, RBX);
+		generator.movImm32(RSI, addr);
+		generator.callAbs(RAX, (uint64_t)readMemory);
+	}
+}
+
+// Expects the address in RAX and returns the value in RAX
+void DSPCodeGenerator::generateReadDynamic(uint16_t pc) {
+	generator.compareImm32(RAX, 0x3800);
+	generator.jumpIf32(NotBelow, 0);
+	uint32_t slow = generator.tell();
+	
+	generator.addRegReg32(RAX, RAX);
+	generator.addRegReg64(RAX, RBX);
+	generator.loadMem16(RAX, RAX, DRAM);
+	generator.swap16(RAX);
+	generator.jumpRel32(0);
+	uint32_t done = generator.tell();
+	
+	setJumpTarget(slow);
+	generator.movReg32(RSI, RAX);
+	generator.movReg64(RDI, RBX);
+	generator.movImm32(RAX, pc);
+	generator.storeMem16(RBX, PC, RAX);
+	generator.callAbs(RAX, (uint64_t)readMemory);
+	
+	setJumpTarget(done);
+}
+
+// The address must be in DRAM
+void DSPCodeGenerator::generateWrite(uint16_t addr, Register value) {
+	generator.swap16(value);
+	generator.storeMem16(RBX, DRAM + addr * 2, value);
+}
+
+// Returns to the interpreter if the address is not in DRAM
+void DSPCodeGenerator::generateWriteDynamic(uint16_t addr, int areg, int reg) {
+	generator.loadMem16(RAX, RBX, REG_AR(areg));
+	generator.compareImm32(RAX, 0x3000);
+	generateExitIf(NotBelow, addr);
+	
+	generateReadReg(RCX, reg);
+	generator.swap16(RCX);
+	generator.addRegReg32(RAX, RAX);
+	generator.addRegReg64(RAX, RBX);
+	generator.storeMem16(RAX, DRAM, RCX);
+}
+
+void DSPCodeGenerator::generateIncrement(int areg, bool index) {
+	generator.loadMem16(RCX, RBX, REG_AR(areg));
+	if (index) {
+		generator.loadMem16(RDX, RBX, REG_IX(areg));
+		generator.addRegReg32(RCX, RDX);
+	}
+	else {
+		generator.addRegImm32(RCX, 1);
+	}
+	generator.storeMem16(RBX, REG_AR(areg), RCX);
+}
+
+// Expects the second operand in RCX, shifted left by 24 bits
+void DSPCodeGenerator::generateAdd(int d, bool store) {
+	generator.loadMem64(RAX, RBX, REG_AC(d));
+	generator.shlImm64(RAX, 24);
+	generator.addRegReg64(RAX, RCX);
+	
+	generator.pushFlags();
+	generator.popReg64(RCX);
+	generateFlags(DSPInterpreter::C | DSPInterpreter::O | DSPInterpreter::Z | DSPInterpreter::S);
+	
+	if (store) {
+		generator.shrImm64(RAX, 24);
+		generator.storeMem64(RBX, REG_AC(d), RAX);
+	}
+}
+
+// Copies flags from the host flags in RCX into the status register
+void DSPCodeGenerator::generateFlags(uint16_t flags) {
+	// Zero and sign
+	generator.movReg32(RDX, RCX);
+	generator.shrImm32(RDX, 4);
+	generator.andImm32(RDX, DSPInterpreter::Z | DSPInterpreter::S);
+	
+	if (flags & DSPInterpreter::O) {
+		generator.movReg32(RSI, RCX);
+		generator.shrImm32(RSI, 10);
+		generator.andImm32(RSI, DSPInterpreter::O);
+		generator.orReg32(RDX, RSI);
+	}
+	
+	if (flags & DSPInterpreter::C) {
+		generator.andImm32(RCX, DSPInterpreter::C);
+		generator.orReg32(RDX, RCX);
+	}
+	
+	generator.loadMem16(RSI, RBX, STATUS);
+	generator.andImm32(RSI, ~flags);
+	generator.orReg32(RSI, RDX);
+	generator.storeMem16(RBX, STATUS, RSI);
+}
+
+// Updates the zero and sign flags
+void DSPCodeGenerator::generateTest(int d) {
+	generator.loadMem64(RAX, RBX, REG_AC(d));
+	generator.shlImm64(RAX, 24);
+	generator.pushFlags();
+	generator.popReg64(RCX);
+	generateFlags(DSPInterpreter::Z | DSPInterpreter::S);
+}
+
+void DSPCodeGenerator::generateStatus(uint16_t mask, bool set) {
+	generator.loadMem16(RAX, RBX, STATUS);
+	if (set) {
+		generator.orImm32(RAX, mask);
+	}
+	else {
+		generator.andImm32(RAX, ~mask);
+	}
+	generator.storeMem16(RBX, STATUS, RAX);
+}
+
+void DSPCodeGenerator::generateExit(uint16_t pc) {
+	generator.jumpRel32(0);
+	exits.push_back({(uint32_t)generator.tell(), pc, pending, inLoop, loop});
+}
+
+void DSPCodeGenerator::generateExitIf(Condition cond, uint16_t pc) {
+	generator.jumpIf32(cond, 0);
+	exits.push_back({(uint32_t)generator.tell(), pc, pending, inLoop, loop});
+}
+
+void DSPCodeGenerator::generateExits() {
+	for (Exit &exit : exits) {
+		setJumpTarget(exit.jump);
+		
+		// The rest of the loop is left to the interpreter
+		if (exit.inLoop) {
+			generator.movReg64(RDI, RBX);
+			generator.movImm32(RSI, exit.loop.start);
+			generator.movImm32(RDX, exit.loop.end);
+			generator.loadMem32(RCX, RSP, 4);
+			generator.callAbs(RAX, (uint64_t)pushLoop);
+		}
+		
+		generator.movImm32(RAX, exit.pc);
+		generator.storeMem16(RBX, PC, RAX);
+		
+		generator.movReg32(RAX, RBP);
+		generator.addRegImm32(RAX, exit.pending);
+		
+		generator.popReg64(RSI);
+		generator.popReg64(RBP);
+		generator.popReg64(RBX);
+		generator.ret();
+	}
+	
+	for (auto &tail : tails) {
+		generator.seek(tail.first);
+		generator.u32(length - tail.second);
+	}
+	generator.seek(generator.size());
+}
+
+// Points the jump that ends at the given offset to the current position
+void DSPCodeGenerator::setJumpTarget(uint32_t jump) {
+	size_t pos = generator.tell();
+	generator.seek(jump - 4);
+	generator.u32(pos - jump);
+	generator.seek(pos);
+}
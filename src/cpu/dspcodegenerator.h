@@ -0,0 +1,130 @@
+#pragma once
+
+#include "cpu/x86codegenerator.h"
+#include "cpu/dsp.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+
+/*	Compiles a block of DSP instructions in IRAM or IROM. The block is a
+	function that takes the interpreter and an instruction limit, and
+	returns the number of instructions that it executed. The program
+	counter is updated when the block returns.
+	
+	Accumulators are 40-bit values. They are shifted into the upper bits
+	of 64-bit host registers, so that the host computes the carry, overflow,
+	zero and sign flags.
+	
+	Hardware loops (loop, bloop and bloopi) are compiled into native loops
+	if their body is straight code. The loop stacks are only written if
+	the block returns in the middle of a loop, for example because the
+	limit was reached. The loop is then resumed by a block that is generated
+	with generateResume.
+	
+	A block ends before the first instruction that can't be compiled, so
+	that the interpreter executes it. This includes stores to hardware
+	registers, which may start a DMA transfer into IRAM, and instructions
+	that may throw an exception. A block also ends after a conditional jump.
+*/
+
+class DSPCodeGenerator {
+public:
+	// Maximum number of instructions in a block,
+	// counting the body of a loop only once
+	static const int MaxLength = 64;
+	
+	DSPCodeGenerator(DSPInterpreter *cpu);
+	
+	void generate(uint16_t start);
+	
+	// Generates a block that starts at the beginning of a loop
+	// that was pushed on the loop stacks (st0, st2 and st3)
+	void generateResume(uint16_t start, uint16_t loopEnd);
+	
+	char *get();
+	size_t size();
+	
+	// Returns the address after the last instruction
+	uint16_t getEnd();
+	
+	// Returns the number of instructions in the block
+	int getLength();
+
+private:
+	typedef DSPInterpreter::Handler Handler;
+	
+	struct Loop {
+		uint16_t start;
+		uint16_t end;
+	};
+	
+	struct Exit {
+		uint32_t jump;
+		uint16_t pc;
+		int pending;
+		bool inLoop;
+		Loop loop;
+	};
+	
+	Handler decode(uint16_t instr);
+	
+	bool fetch(uint16_t addr, uint16_t *instr, uint16_t *imm, int *size);
+	
+	bool isNative(uint16_t instr, uint16_t imm);
+	bool isLoop(uint16_t instr);
+	bool isJump(uint16_t instr);
+	bool isReadable(int reg);
+	bool isWritable(int reg);
+	
+	bool scanLoop(Loop loop, int *bodyLength, uint16_t *next);
+	
+	void generatePrologue();
+	void generateBody(uint16_t addr);
+	bool generateLoop(uint16_t addr, uint16_t instr, uint16_t imm, uint16_t *next);
+	void generateLoopBody(Loop loop, int bodyLength);
+	void generateJump(uint16_t addr, uint16_t instr, uint16_t imm);
+	void generateInstr(uint16_t addr, uint16_t instr, uint16_t imm, int size);
+	
+	void generateReadReg(Register target, int reg);
+	void generateWriteReg(int reg, Register value);
+	void generateRead(uint16_t addr, uint16_t pc);
+	void generateReadDynamic(uint16_t pc);
+	void generateWrite(uint16_t addr, Register value);
+	void generateWriteDynamic(uint16_t addr, int areg, int reg);
+	void generateIncrement(int areg, bool index);
+	
+	void generateAdd(int d, bool store);
+	void generateFlags(uint16_t flags);
+	void generateTest(int d);
+	void generateStatus(uint16_t mask, bool set);
+	
+	void generateExit(uint16_t pc);
+	void generateExitIf(Condition cond, uint16_t pc);
+	void generateExits();
+	
+	void setJumpTarget(uint32_t jump);
+	
+	static uint32_t readMemory(DSPInterpreter *cpu, uint32_t addr);
+	static void pushLoop(DSPInterpreter *cpu, uint32_t start, uint32_t end, uint32_t count);
+	
+	DSPInterpreter *cpu;
+	X86CodeGenerator generator;
+	
+	uint16_t end;
+	int length;
+	
+	// Number of instructions that were executed
+	// since the last update of the counter (RBP)
+	int pending;
+	
+	bool inLoop;
+	Loop loop;
+	
+	std::vector<Exit> exits;
+	
+	// Loop conditions that depend on the number of
+	// instructions that follow the loop
+	std::vector<std::pair<uint32_t, int>> tails;
+};
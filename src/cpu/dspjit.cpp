@@ -0,0 +1,129 @@
+#include "cpu/dspjit.h"
+#include "cpu/dspcodegenerator.h"
+#include "cpu/dsp.h"
+
+#include "common/stringutils.h"
+
+#include <cstring>
+
+
+DSPJIT::DSPJIT(DSPInterpreter *cpu) : arena(ArenaSize) {
+	this->cpu = cpu;
+	
+	perf = PerfMap::get();
+	
+	memset(blocks, 0, sizeof(blocks));
+	memset(resumes, 0, sizeof(resumes));
+}
+
+void DSPJIT::invalidate() {
+	for (int i = 0; i < 0x3000; i++) {
+		blocks[i].code = nullptr;
+		resumes[i].code = nullptr;
+	}
+	arena.reset();
+}
+
+void DSPJIT::invalidate(uint16_t addr, uint16_t length) {
+	// Blocks that start before the given address may overlap it
+	int span = DSPCodeGenerator::MaxLength * 2;
+	int start = addr > span ? addr - span : 0;
+	
+	for (int i = start; i < addr + length && i < 0x2000; i++) {
+		if (blocks[i].code && blocks[i].end > addr) {
+			release(&blocks[i]);
+		}
+		if (resumes[i].code && resumes[i].end > addr) {
+			release(&resumes[i]);
+		}
+	}
+}
+
+int DSPJIT::execute(uint16_t pc, int limit) {
+	Block *block;
+	
+	bool resume = false;
+	uint16_t loopEnd = 0;
+	if (!cpu->st[2].empty()) {
+		loopEnd = cpu->st[2].peek();
+		resume = loopEnd >= pc && !cpu->st[0].empty() && cpu->st[0].peek() == pc && !cpu->st[3].empty();
+	}
+	
+	if (resume) {
+		block = lookup(resumes, pc);
+		if (!block) return 0;
+		
+		if (block->code && block->loopEnd != loopEnd) {
+			release(block);
+		}
+		if (!block->code) {
+			compile(block, pc, true, loopEnd);
+		}
+		
+		// The loop is removed from the stacks
+		if (isLoopEnd(pc, block->end, 1)) return 0;
+	}
+	else {
+		block = lookup(blocks, pc);
+		if (!block) return 0;
+		
+		if (!block->code) {
+			compile(block, pc, false, 0);
+		}
+		
+		if (isLoopEnd(pc, block->end, 0)) return 0;
+	}
+	
+	if (block->length == 0 || block->length > limit) return 0;
+	
+	return ((DSPBlockFunc)block->code)(cpu, limit);
+}
+
+DSPJIT::Block *DSPJIT::lookup(Block *table, uint16_t addr) {
+	if (addr < 0x2000) return &table[addr];
+	if (0x8000 <= addr && addr < 0x9000) return &table[addr - 0x6000];
+	return nullptr;
+}
+
+// The interpreter checks for the end of a loop after every instruction,
+// so a block must not contain the end of a loop that it didn't start
+bool DSPJIT::isLoopEnd(uint16_t start, uint16_t end, int index) {
+	if (cpu->st[2].size() <= index) return false;
+	
+	uint16_t addr = cpu->st[2].get(index);
+	return start <= addr && addr < end;
+}
+
+void DSPJIT::compile(Block *block, uint16_t pc, bool resume, uint16_t loopEnd) {
+	DSPCodeGenerator generator(cpu);
+	if (resume) {
+		generator.generateResume(pc, loopEnd);
+	}
+	else {
+		generator.generate(pc);
+	}
+	
+	size_t size = generator.size();
+	
+	char *code = arena.alloc(size);
+	if (!code) {
+		invalidate();
+		code = arena.alloc(size);
+	}
+	arena.write(code, generator.get(), size);
+	
+	if (perf) {
+		perf->add(code, size, StringUtils::format("dsp %04X", pc));
+	}
+	
+	block->code = code;
+	block->size = size;
+	block->end = generator.getEnd();
+	block->loopEnd = loopEnd;
+	block->length = generator.getLength();
+}
+
+void DSPJIT::release(Block *block) {
+	arena.free(block->code, block->size);
+	block->code = nullptr;
+}
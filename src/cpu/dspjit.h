@@ -0,0 +1,63 @@
+#pragma once
+
+#include "cpu/codearena.h"
+#include "cpu/perfmap.h"
+
+#include <cstdint>
+
+
+class DSPInterpreter;
+
+
+/*	Compiled blocks of DSP code, by their start address in IRAM or IROM.
+	IROM never changes, but IRAM may be overwritten by a DMA transfer, and
+	the blocks that overlap the transfer must be invalidated then. Blocks
+	only return to the interpreter before a DMA transfer is started, so
+	they are freed immediately.
+	
+	A block that resumes a hardware loop is stored separately, because it
+	assumes that the loop stacks contain the loop.
+*/
+
+class DSPJIT {
+public:
+	typedef int (*DSPBlockFunc)(DSPInterpreter *cpu, int limit);
+	
+	static const size_t ArenaSize = 0x1000000;
+	
+	DSPJIT(DSPInterpreter *cpu);
+	
+	void invalidate();
+	void invalidate(uint16_t addr, uint16_t length);
+	
+	// Executes at most limit instructions and returns the number
+	// of instructions that were executed. Returns 0 if the
+	// instruction at the given address must be interpreted.
+	int execute(uint16_t pc, int limit);
+
+private:
+	struct Block {
+		char *code;
+		uint32_t size;
+		uint16_t end;
+		uint16_t loopEnd;
+		int length;
+	};
+	
+	Block *lookup(Block *table, uint16_t addr);
+	
+	void compile(Block *block, uint16_t pc, bool resume, uint16_t loopEnd);
+	void release(Block *block);
+	
+	bool isLoopEnd(uint16_t start, uint16_t end, int index);
+	
+	DSPInterpreter *cpu;
+	
+	// IRAM followed by IROM
+	Block blocks[0x3000];
+	Block resumes[0x3000];
+	
+	CodeArena arena;
+	
+	PerfMap *perf;
+};
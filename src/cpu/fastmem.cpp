@@ -0,0 +1,51 @@
+#include "cpu/fastmem.h"
+
+#include "common/exceptions.h"
+
+#include <sys/mman.h>
+
+
+static const size_t TableSize = 0x100000 * sizeof(char *);
+
+
+Fastmem::Fastmem(int contexts) {
+	this->contexts = contexts;
+	
+	// The tables are only backed by memory once they are used
+	tables = new char **[contexts * 2];
+	for (int i = 0; i < contexts * 2; i++) {
+		void *table = mmap(
+			NULL, TableSize, PROT_READ | PROT_WRITE,
+			MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0
+		);
+		if (table == MAP_FAILED) {
+			runtime_error("Failed to allocate fastmem table");
+		}
+		tables[i] = (char **)table;
+	}
+	
+	select(0);
+}
+
+Fastmem::~Fastmem() {
+	for (int i = 0; i < contexts * 2; i++) {
+		munmap(tables[i], TableSize);
+	}
+	delete[] tables;
+}
+
+void Fastmem::select(int context) {
+	readTable = tables[context * 2];
+	writeTable = tables[context * 2 + 1];
+}
+
+void Fastmem::map(int context, uint32_t addr, char *host, bool write) {
+	tables[context * 2 + write][addr >> 12] = host - (addr & 0xFFF);
+}
+
+void Fastmem::invalidate() {
+	// Resets the tables to zero pages
+	for (int i = 0; i < contexts * 2; i++) {
+		madvise(tables[i], TableSize, MADV_DONTNEED);
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+
+/*	Translates guest virtual pages to host pointers for the memory accesses
+	that are generated inline in JIT code. There are separate tables for
+	reads and writes, and a pair of tables for every translation context
+	of the processor (for example user and supervisor mode).
+	
+	A null entry means that the page must go through the slow path. Null
+	pointers fault in the generated code, so there is no check for them.
+*/
+
+class Fastmem {
+public:
+	Fastmem(int contexts);
+	~Fastmem();
+	
+	void select(int context);
+	void map(int context, uint32_t addr, char *host, bool write);
+	void invalidate();
+	
+	// Tables of the current context, used by the generated code
+	char **readTable;
+	char **writeTable;
+
+private:
+	int contexts;
+	char ***tables;
+};
@@ -0,0 +1,74 @@
+#include "cpu/faulthandler.h"
+
+#include "common/exceptions.h"
+
+#include <ucontext.h>
+
+#include <cstring>
+
+
+static thread_local FaultHandler *current;
+static FaultHandler::AccessHandler accessHandler;
+
+
+FaultHandler::FaultHandler() {
+	install();
+}
+
+void FaultHandler::setAccessHandler(AccessHandler handler) {
+	install();
+	accessHandler = handler;
+}
+
+void FaultHandler::activate() {
+	current = this;
+}
+
+void FaultHandler::add(char *addr, char *handler) {
+	sites[addr] = handler;
+}
+
+void FaultHandler::remove(char *start, char *end) {
+	sites.erase(sites.lower_bound(start), sites.lower_bound(end));
+}
+
+void FaultHandler::clear() {
+	sites.clear();
+}
+
+void FaultHandler::install() {
+	static bool installed = false;
+	if (!installed) {
+		struct sigaction action;
+		memset(&action, 0, sizeof(action));
+		action.sa_sigaction = handleSignal;
+		action.sa_flags = SA_SIGINFO;
+		sigemptyset(&action.sa_mask);
+		if (sigaction(SIGSEGV, &action, nullptr) < 0) {
+			runtime_error("Failed to install fault handler");
+		}
+		installed = true;
+	}
+}
+
+void FaultHandler::handleSignal(int, siginfo_t *info, void *context) {
+	if (accessHandler && accessHandler(info->si_addr)) {
+		return;
+	}
+	
+	ucontext_t *ucontext = (ucontext_t *)context;
+	greg_t &rip = ucontext->uc_mcontext.gregs[REG_RIP];
+	if (current) {
+		auto it = current->sites.find((char *)rip);
+		if (it != current->sites.end()) {
+			rip = (greg_t)it->second;
+			return;
+		}
+	}
+	
+	// Not a fault in JIT code, so the next attempt crashes
+	struct sigaction action;
+	memset(&action, 0, sizeof(action));
+	action.sa_handler = SIG_DFL;
+	sigaction(SIGSEGV, &action, nullptr);
+}
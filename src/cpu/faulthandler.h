@@ -0,0 +1,39 @@
+#pragma once
+
+#include <signal.h>
+
+#include <map>
+
+
+/*	Memory accesses in JIT code may fault, for example if a fastmem page is
+	not mapped. The JIT registers the instructions that may fault together
+	with the address of their slow path. If one of them faults, the signal
+	handler continues at the slow path instead.
+	
+	The handler only looks at the instructions of the JIT that is active in
+	the thread that caught the signal. Faults in other code may be resolved
+	by the access handler, for example by removing a write protection.
+	Faults that remain crash as usual.
+*/
+
+class FaultHandler {
+public:
+	// Returns true if the access can be retried
+	typedef bool (*AccessHandler)(void *addr);
+	
+	FaultHandler();
+	
+	static void setAccessHandler(AccessHandler handler);
+	
+	void activate();
+	
+	void add(char *addr, char *handler);
+	void remove(char *start, char *end);
+	void clear();
+
+private:
+	static void install();
+	static void handleSignal(int signal, siginfo_t *info, void *context);
+	
+	std::map<char *, char *> sites;
+};
@@ -1,34 +1,76 @@
 
 #pragma once
 
+#include "cpu/codearena.h"
+#include "cpu/faulthandler.h"
+#include "cpu/jitcache.h"
+#include "cpu/perfmap.h"
 #include "cpu/processor.h"
 
+#include "common/stringutils.h"
+
 #include "physicalmemory.h"
 #include "config.h"
 
-#include <sys/mman.h>
-
+#include <functional>
+#include <string>
+#include <vector>
+#include <utility>
 #include <cstring>
 #include <cstdlib>
 #include <cstdint>
 
 
+struct JITBlockResult {
+	uint64_t instrs;
+	char *link;
+};
+
+
 template <class TGenerator, class TValue>
 class JIT {
 public:
 	typedef void *(*JITEntryFunc)(Processor *cpu);
+	typedef JITBlockResult (*JITBlockFunc)(Processor *cpu, char *entry, uint32_t limit);
+	
+	static const int count = 0x1000 / sizeof(TValue);
+	
+	// Size of the code arena. If it is full, all code is compiled again.
+	static const size_t ArenaSize = 0x20000000;
 	
-	JIT(PhysicalMemory *physmem, Processor *cpu) {
+	// Number of times that a page is entered before it is compiled
+	static const int HotThreshold = 32;
+	
+	JIT(PhysicalMemory *physmem, Processor *cpu, const char *name) : arena(ArenaSize) {
 		this->physmem = physmem;
 		this->cpu = cpu;
+		this->name = name;
+		
+		cache = JITCache::get(name);
+		perf = PerfMap::get();
 		
 		memset(table, 0, sizeof(table));
-		memset(sizes, 0, sizeof(sizes));
+		
+		pendingLink = nullptr;
+		
+		physmem->addModifiedPages(&modified);
+	}
+	
+	~JIT() {
+		for (int i = 0; i < 0x400; i++) {
+			delete[] table[i];
+		}
 	}
 	
 	void reset() {
 		invalidate();
 		
+		for (int i = 0; i < 0x400; i++) {
+			if (table[i]) {
+				memset(table[i], 0, sizeof(Page) * 0x400);
+			}
+		}
+		
 		#if STATS
 		instrsCompiled = 0;
 		instrsExecuted = 0;
@@ -37,37 +79,64 @@ public:
 	
 	void invalidateBlock(uint32_t addr) {
 		int index = addr >> 12;
-		if (table[index]) {
-			munmap(table[index], sizes[index]);
-			table[index] = nullptr;
+		Page *page = lookup(index);
+		if (page && page->code) {
+			unlinkPage(index);
+			release(page->code, page->size);
+			removePage(index);
 			
 			#if STATS
-			instrSize -= sizes[index];
+			instrSize -= page->size;
 			#endif
 		}
 	}
 	
 	void invalidate() {
-		for (int i = 0; i < 0x100000; i++) {
-			if (table[i]) {
-				munmap(table[i], sizes[i]);
-				table[i] = nullptr;
-			}
+		for (int index : pages) {
+			Page *page = lookup(index);
+			release(page->code, page->size);
+			page->code = nullptr;
 		}
+		pages.clear();
+		links.clear();
+		pendingLink = nullptr;
 		
 		#if STATS
 		instrSize = 0;
 		#endif
 	}
 	
-	void execute(uint32_t pc) {
-		char *target = table[pc >> 12];
-		if (!target) {
-			target = generateCode(pc & ~0xFFF);
-			table[pc >> 12] = target;
+	// Removes all links between pages, for example because
+	// the address translation has changed
+	void unlink() {
+		for (Link &link : links) {
+			*arena.getWritable<uint32_t>(link.site + TGenerator::LinkTarget) = 0;
 		}
+		links.clear();
+		pendingLink = nullptr;
+	}
+	
+	// The function returns the name of the page at the given physical
+	// address for profilers. By default, the name of the JIT is used.
+	void setSymbolizer(std::function<std::string(uint32_t)> func) {
+		symbolizer = func;
+	}
+	
+	// Counts an entry into the page at the given address. Returns
+	// true if the page is compiled or should be compiled now. Until
+	// then, the processor may interpret the page instead.
+	bool isHot(uint32_t pc) {
+		update();
 		
-		target = target + 5 * ((pc & 0xFFF) / sizeof(TValue));
+		Page *page = lookup(pc >> 12, true);
+		if (page->code) return true;
+		return ++page->hits >= HotThreshold;
+	}
+	
+	void execute(uint32_t pc) {
+		char *target = getPage(pc) + 5 * ((pc & 0xFFF) / sizeof(TValue));
+		
+		faults.activate();
 		
 		#if STATS
 		instrsExecuted++;
@@ -76,6 +145,58 @@ public:
 		((JITEntryFunc)target)(cpu);
 	}
 	
+	// Executes instructions until a branch, exception or the end of
+	// the page is reached. Branches are only followed while less than
+	// limit instructions were executed. Returns the number of instructions.
+	int executeBlock(uint32_t pc, int limit) {
+		char *page = getPage(pc);
+		
+		faults.activate();
+		
+		JITBlockFunc func = (JITBlockFunc)(page + 10 * count);
+		JITBlockResult result = func(cpu, getEntry(page, pc), (limit - 1) * sizeof(TValue));
+		pendingLink = result.link;
+		
+		#if STATS
+		instrsExecuted += result.instrs;
+		#endif
+		
+		return result.instrs;
+	}
+	
+	// Returns true if the previous block ended at a branch
+	// into another page that can be linked
+	bool isLinkPending() {
+		return pendingLink != nullptr;
+	}
+	
+	// Links the branch that ended the previous block to the block
+	// at the given address. The link is only taken if the value in
+	// the context register of the processor is still the same.
+	void link(uint32_t pc, uint32_t context) {
+		update();
+		
+		// The page of the branch may have been modified
+		char *site = pendingLink;
+		pendingLink = nullptr;
+		if (!site) return;
+		
+		// Cold pages are linked once they are compiled
+		Page *entry = lookup(pc >> 12);
+		if (!entry || !entry->code) return;
+		
+		char *page = entry->code;
+		
+		int64_t offset = getEntry(page, pc) - (site + TGenerator::LinkEnd);
+		if (offset != (int32_t)offset) return;
+		
+		*arena.getWritable<uint32_t>(site + TGenerator::LinkContext) = context;
+		*arena.getWritable<uint32_t>(site + TGenerator::LinkTarget) = offset;
+		
+		Link link = {site, (int)(pc >> 12)};
+		links.push_back(link);
+	}
+	
 	#if STATS
 	uint64_t instrsExecuted;
 	uint64_t instrsCompiled;
@@ -83,34 +204,191 @@ public:
 	#endif
 	
 private:
+	struct Link {
+		char *site;
+		int target;
+	};
+	
+	struct Page {
+		char *code;
+		uint32_t size;
+		int slot; // Position in the list of compiled pages
+		int hits; // Number of entries while the page is not compiled
+	};
+	
+	Page *lookup(int index, bool create = false) {
+		Page *&leaf = table[index >> 10];
+		if (!leaf) {
+			if (!create) return nullptr;
+			leaf = new Page[0x400]();
+		}
+		return &leaf[index & 0x3FF];
+	}
+	
+	void addPage(int index, char *code, uint32_t size) {
+		Page *page = lookup(index, true);
+		page->code = code;
+		page->size = size;
+		page->slot = pages.size();
+		pages.push_back(index);
+	}
+	
+	void removePage(int index) {
+		Page *page = lookup(index);
+		int last = pages.back();
+		pages[page->slot] = last;
+		lookup(last)->slot = page->slot;
+		pages.pop_back();
+		page->code = nullptr;
+		page->hits = 0; // Modified code is interpreted until it is hot again
+	}
+	
+	void update() {
+		if (modified.pending) {
+			modified.collect([this](uint32_t page) {
+				invalidateBlock(page << 12);
+			});
+		}
+		
+		if (!garbage.empty()) {
+			collectGarbage();
+		}
+	}
+	
+	char *getPage(uint32_t pc) {
+		update();
+		
+		Page *page = lookup(pc >> 12);
+		if (!page || !page->code) {
+			return generateCode(pc & ~0xFFF);
+		}
+		return page->code;
+	}
+	
+	char *getEntry(char *page, uint32_t pc) {
+		return page + 5 * (count + (pc & 0xFFF) / sizeof(TValue));
+	}
+	
+	// Removes the links from and to the given page
+	void unlinkPage(int index) {
+		Page *entry = lookup(index);
+		char *page = entry->code;
+		char *end = page + entry->size;
+		
+		for (size_t i = 0; i < links.size();) {
+			Link &link = links[i];
+			bool source = link.site >= page && link.site < end;
+			if (source || link.target == index) {
+				if (!source) {
+					*arena.getWritable<uint32_t>(link.site + TGenerator::LinkTarget) = 0;
+				}
+				links[i] = links.back();
+				links.pop_back();
+			}
+			else {
+				i++;
+			}
+		}
+		
+		if (pendingLink >= page && pendingLink < end) {
+			pendingLink = nullptr;
+		}
+	}
+	
+	// Invalidation may be triggered by the code that is being
+	// executed, so pages are only freed before the next call.
+	void release(char *page, size_t size) {
+		faults.remove(page, page + size);
+		garbage.push_back(std::make_pair(page, size));
+	}
+	
+	void collectGarbage() {
+		for (auto &page : garbage) {
+			arena.free(page.first, page.second);
+		}
+		garbage.clear();
+	}
+	
 	char *generateCode(uint32_t pc) {
-		TGenerator generator;
-		for (int offs = 0; offs < 0x1000; offs += sizeof(TValue)) {
-			TValue value = physmem->read<TValue>(pc + offs);
-			generator.generate(value);
+		// Protect the page first, so that no write can be missed
+		physmem->protectCode(pc);
+		
+		TValue values[count];
+		for (int i = 0; i < count; i++) {
+			values[i] = physmem->read<TValue>(pc + i * sizeof(TValue));
 		}
 		
+		JITCache::Entry entry;
+		if (!cache || !cache->load(values, sizeof(values), &entry)) {
+			TGenerator generator;
+			for (TValue value : values) {
+				generator.generate(value);
+			}
+			
+			char *buffer = generator.get();
+			entry.code.assign(buffer, buffer + generator.size());
+			entry.faultSites = generator.getFaultSites();
+			entry.relocations = generator.getRelocations();
+			
+			if (cache) {
+				cache->store(values, sizeof(values), &entry);
+			}
+		}
+		
+		size_t size = entry.code.size();
+		
 		#if STATS
 		instrsCompiled += 0x1000 / sizeof(TValue);
-		instrSize += generator.size();
+		instrSize += size;
 		#endif
 		
-		char *buffer = generator.get();
-		size_t size = generator.size();
+		char *jit = arena.alloc(size);
+		if (!jit) {
+			invalidate();
+			collectGarbage();
+			arena.reset();
+			jit = arena.alloc(size);
+		}
+		arena.write(jit, entry.code.data(), size);
+		
+		if (perf) {
+			if (symbolizer) {
+				perf->add(jit, size, symbolizer(pc));
+			}
+			else {
+				perf->add(jit, size, StringUtils::format("%s %08X", name, pc));
+			}
+		}
 		
-		sizes[pc >> 12] = size;
+		addPage(pc >> 12, jit, size);
 		
-		char *jit = (char *)mmap(
-			NULL, size, PROT_READ | PROT_WRITE | PROT_EXEC,
-			MAP_ANONYMOUS | MAP_SHARED, -1, 0
-		);
-		memcpy(jit, buffer, size);
+		for (auto &site : entry.faultSites) {
+			faults.add(jit + site.first, jit + site.second);
+		}
 		return jit;
 	}
 	
 	PhysicalMemory *physmem;
 	Processor *cpu;
 	
-	char *table[0x100000];
-	uint32_t sizes[0x100000];
+	const char *name;
+	
+	// Compiled pages, in a two level table that is allocated
+	// on demand and in a list for quick invalidation
+	Page *table[0x400];
+	std::vector<int> pages;
+	
+	std::vector<std::pair<char *, size_t>> garbage;
+	
+	std::vector<Link> links;
+	char *pendingLink;
+	
+	ModifiedPages modified;
+	FaultHandler faults;
+	CodeArena arena;
+	
+	JITCache *cache;
+	
+	PerfMap *perf;
+	std::function<std::string(uint32_t)> symbolizer;
 };
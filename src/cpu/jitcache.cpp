@@ -0,0 +1,209 @@
+#include "cpu/jitcache.h"
+
+#include "common/fileutils.h"
+#include "common/logger.h"
+
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cstring>
+
+
+static const char Magic[4] = {'J', 'I', 'T', 'C'};
+
+static std::string cacheDirectory;
+static std::map<std::string, JITCache *> caches;
+
+
+void JITCache::setDirectory(std::string directory) {
+	mkdir(directory.c_str(), 0755);
+	cacheDirectory = directory;
+}
+
+JITCache *JITCache::get(std::string name) {
+	if (cacheDirectory.empty()) return nullptr;
+	
+	JITCache *&cache = caches[name];
+	if (!cache) {
+		cache = new JITCache(cacheDirectory + "/" + name + ".bin");
+		if (cache->fd < 0) {
+			Logger::warning("Failed to open JIT cache: %s", name);
+		}
+	}
+	return cache->fd >= 0 ? cache : nullptr;
+}
+
+JITCache::JITCache(std::string filename) {
+	fd = -1;
+	open(filename);
+}
+
+// Other processes may use the same file, so it is locked while it is
+// validated and while a page is appended
+void JITCache::open(std::string filename) {
+	uint64_t buildId = getBuildId();
+	
+	fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+	if (fd < 0) return;
+	
+	flock(fd, LOCK_EX);
+	
+	struct stat st;
+	fstat(fd, &st);
+	long end = st.st_size;
+	
+	char start[12];
+	bool valid = pread(fd, start, 12, 0) == 12;
+	valid = valid && !memcmp(start, Magic, 4) && !memcmp(start + 4, &buildId, 8);
+	
+	bool success;
+	if (valid) {
+		// Index the pages, up to the first incomplete or corrupt one
+		long offset = 12;
+		Header header;
+		while (pread(fd, &header, sizeof(header), offset) == sizeof(header)) {
+			long next = offset + sizeof(header) + getSize(header);
+			if (next > end) break;
+			
+			std::vector<char> data(getSize(header));
+			if (pread(fd, data.data(), data.size(), offset + sizeof(header)) != (ssize_t)data.size()) break;
+			if (hash(data.data(), data.size(), buildId) != header.checksum) break;
+			
+			pages.insert(std::make_pair(header.hash, offset));
+			offset = next;
+		}
+		
+		success = offset == end || ftruncate(fd, offset) == 0;
+	}
+	else {
+		memcpy(start, Magic, 4);
+		memcpy(start + 4, &buildId, 8);
+		success = ftruncate(fd, 0) == 0 && write(fd, start, 12) == 12;
+	}
+	
+	flock(fd, LOCK_UN);
+	
+	if (!success) {
+		pages.clear();
+		close(fd);
+		fd = -1;
+	}
+}
+
+bool JITCache::load(const void *source, size_t size, Entry *entry) {
+	std::lock_guard<std::mutex> lock(mutex);
+	
+	auto range = pages.equal_range(hash(source, size));
+	for (auto it = range.first; it != range.second; it++) {
+		Header header;
+		if (pread(fd, &header, sizeof(header), it->second) != sizeof(header)) continue;
+		if (header.sourceSize != size) continue;
+		
+		// The file may have been rewritten by another build in the meantime
+		std::vector<char> data(getSize(header));
+		if (pread(fd, data.data(), data.size(), it->second + sizeof(header)) != (ssize_t)data.size()) continue;
+		if (hash(data.data(), data.size(), getBuildId()) != header.checksum) continue;
+		if (memcmp(data.data(), source, size)) continue;
+		
+		const char *ptr = data.data() + size;
+		entry->code.assign(ptr, ptr + header.codeSize);
+		ptr += header.codeSize;
+		
+		entry->faultSites.resize(header.faultCount);
+		for (auto &site : entry->faultSites) {
+			memcpy(&site.first, ptr, 4);
+			memcpy(&site.second, ptr + 4, 4);
+			ptr += 8;
+		}
+		
+		entry->relocations.resize(header.relocCount);
+		memcpy(entry->relocations.data(), ptr, header.relocCount * 4);
+		
+		relocate(entry, getImageBase());
+		return true;
+	}
+	return false;
+}
+
+void JITCache::store(const void *source, size_t size, Entry *entry) {
+	std::lock_guard<std::mutex> lock(mutex);
+	
+	Header header;
+	header.hash = hash(source, size);
+	header.sourceSize = size;
+	header.codeSize = entry->code.size();
+	header.faultCount = entry->faultSites.size();
+	header.relocCount = entry->relocations.size();
+	
+	// The addresses are stored relative to the image
+	Entry stored = *entry;
+	relocate(&stored, -getImageBase());
+	
+	// The page is written at once, so that it is never interleaved
+	// with a page of another process
+	std::vector<char> record(sizeof(header) + getSize(header));
+	char *ptr = record.data() + sizeof(header);
+	memcpy(ptr, source, size);
+	ptr += size;
+	memcpy(ptr, stored.code.data(), header.codeSize);
+	ptr += header.codeSize;
+	for (auto &site : stored.faultSites) {
+		memcpy(ptr, &site.first, 4);
+		memcpy(ptr + 4, &site.second, 4);
+		ptr += 8;
+	}
+	memcpy(ptr, stored.relocations.data(), header.relocCount * 4);
+	
+	header.checksum = hash(record.data() + sizeof(header), getSize(header), getBuildId());
+	memcpy(record.data(), &header, sizeof(header));
+	
+	flock(fd, LOCK_EX);
+	long offset = lseek(fd, 0, SEEK_END);
+	bool success = write(fd, record.data(), record.size()) == (ssize_t)record.size();
+	flock(fd, LOCK_UN);
+	
+	if (success) {
+		pages.insert(std::make_pair(header.hash, offset));
+	}
+}
+
+void JITCache::relocate(Entry *entry, uint64_t base) {
+	for (uint32_t offset : entry->relocations) {
+		uint64_t addr;
+		memcpy(&addr, &entry->code[offset], 8);
+		addr += base;
+		memcpy(&entry->code[offset], &addr, 8);
+	}
+}
+
+uint32_t JITCache::getSize(const Header &header) {
+	return header.sourceSize + header.codeSize + header.faultCount * 8 + header.relocCount * 4;
+}
+
+// FNV-1a
+uint64_t JITCache::hash(const void *data, size_t size, uint64_t seed) {
+	const uint8_t *bytes = (const uint8_t *)data;
+	
+	uint64_t hash = seed;
+	for (size_t i = 0; i < size; i++) {
+		hash = (hash ^ bytes[i]) * 0x100000001B3;
+	}
+	return hash;
+}
+
+// The code generators may change with every build, so the
+// build ID is the hash of the executable itself
+uint64_t JITCache::getBuildId() {
+	static uint64_t buildId;
+	if (!buildId) {
+		Buffer image = FileUtils::load("/proc/self/exe");
+		buildId = hash(image.get(), image.size());
+	}
+	return buildId;
+}
+
+uint64_t JITCache::getImageBase() {
+	return (uint64_t)&JITCache::get;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <map>
+#include <mutex>
+#include <utility>
+
+#include <cstdint>
+
+
+/*	Compiled pages that are stored on disk, so that the next run of the
+	emulator doesn't need to compile them again. All JITs with the same
+	kind of code generator share a file. The file starts with the build ID
+	of the emulator and is cleared when the emulator was built again.
+	
+	Pages are found by the hash of their source code. The source code is
+	stored together with the compiled code, so hash collisions are not an
+	issue. Every page has a checksum that includes the build ID, so pages
+	that are corrupt or were appended by another build are ignored. The compiled code may contain absolute addresses of helper
+	functions, which are stored relative to the emulator image and
+	relocated when the page is loaded.
+	
+	The cache is disabled unless a directory was set.
+*/
+
+class JITCache {
+public:
+	struct Entry {
+		std::vector<char> code;
+		std::vector<std::pair<uint32_t, uint32_t>> faultSites;
+		std::vector<uint32_t> relocations;
+	};
+	
+	static void setDirectory(std::string directory);
+	
+	// Returns the cache for the given kind of code, or null
+	static JITCache *get(std::string name);
+	
+	bool load(const void *source, size_t size, Entry *entry);
+	void store(const void *source, size_t size, Entry *entry);
+
+private:
+	struct Header {
+		uint64_t hash;
+		uint64_t checksum;
+		uint32_t sourceSize;
+		uint32_t codeSize;
+		uint32_t faultCount;
+		uint32_t relocCount;
+	};
+	
+	JITCache(std::string filename);
+	
+	void open(std::string filename);
+	void relocate(Entry *entry, uint64_t base);
+	
+	static uint32_t getSize(const Header &header);
+	static uint64_t hash(const void *data, size_t size, uint64_t seed = 0xCBF29CE484222325);
+	static uint64_t getBuildId();
+	static uint64_t getImageBase();
+	
+	int fd;
+	
+	// File offsets of the stored pages, by the hash of their source
+	std::multimap<uint64_t, long> pages;
+	
+	std::mutex mutex;
+};
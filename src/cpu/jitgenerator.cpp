@@ -0,0 +1,390 @@
+#include "cpu/jitgenerator.h"
+
+
+// Host registers that hold guest registers in inline code. RAX and RDX
+// are free for temporary values and none of them survive a call.
+static const Register cacheRegs[] = {
+	RCX, RSI, RDI, R8, R9, R10, R11
+};
+
+
+JITGenerator::JITGenerator(int count, int instrSize, uint32_t pcOffset) : generator(0x8000) {
+	this->count = count;
+	this->instrSize = instrSize;
+	this->pcOffset = pcOffset;
+	
+	contextOffset = pcOffset;
+	contextMask = 0;
+	
+	for (Register reg : cacheRegs) {
+		CachedReg entry;
+		entry.reg = reg;
+		entry.offset = 0;
+		entry.used = false;
+		entry.dirty = false;
+		entry.locked = false;
+		entry.age = 0;
+		cache.push_back(entry);
+	}
+	cacheAge = 0;
+	lag = 0;
+	current = 0;
+	
+	generator.seek(count * 10);
+	generatePrologue();
+}
+
+JITGenerator::~JITGenerator() {}
+
+char *JITGenerator::get() {
+	generateBodies();
+	
+	for (int i = 0; i < (int)instrs.size(); i++) {
+		generateChain(i);
+	}
+	
+	for (int i = 0; i < (int)instrs.size(); i++) {
+		generateEntry(i);
+	}
+	
+	for (int i = 0; i < (int)instrs.size(); i++) {
+		if (instrs[i].branch != NoBranch) {
+			generateBranch(i);
+		}
+	}
+	
+	generator.seek(0);
+	for (int i = 0; i < (int)instrs.size(); i++) {
+		generator.jumpRel32(instrs[i].body - (i + 1) * 5);
+	}
+	
+	generator.seek(count * 5);
+	for (int i = 0; i < (int)entries.size(); i++) {
+		generator.jumpRel32(entries[i] - (count + i + 1) * 5);
+	}
+	return generator.get();
+}
+
+size_t JITGenerator::size() {
+	return generator.size();
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> &JITGenerator::getFaultSites() {
+	return faultSites;
+}
+
+std::vector<uint32_t> &JITGenerator::getRelocations() {
+	return generator.getRelocations();
+}
+
+void JITGenerator::beginInstr() {
+	Instruction instr = {};
+	instr.body = generator.tell();
+	instr.branch = NoBranch;
+	instrs.push_back(instr);
+}
+
+void JITGenerator::endBlock() {
+	instrs.back().terminator = true;
+}
+
+void JITGenerator::branch(uint32_t offset) {
+	instrs.back().branch = Relative;
+	instrs.back().target = offset;
+}
+
+void JITGenerator::branchAbs(uint32_t target) {
+	instrs.back().branch = Absolute;
+	instrs.back().target = target;
+}
+
+void JITGenerator::jumpToBranch(int index, Condition cond) {
+	Exit exit;
+	exit.jump = generator.tell();
+	exit.cond = cond;
+	exit.lag = lag + index - current;
+	for (CachedReg &entry : cache) {
+		if (entry.used && entry.dirty) {
+			exit.dirty.push_back(std::make_pair(entry.reg, entry.offset));
+		}
+	}
+	instrs[index].exits.push_back(exit);
+	
+	generator.jumpIf32(cond, 0); // Patched by generateBranch
+}
+
+void JITGenerator::setLinkContext(uint32_t offset, uint32_t mask) {
+	contextOffset = offset;
+	contextMask = mask;
+}
+
+void JITGenerator::addFaultSite(uint32_t addr, uint32_t handler) {
+	faultSites.push_back(std::make_pair(addr, handler));
+}
+
+void JITGenerator::generateBodies() {}
+
+bool JITGenerator::generateInline(int) {
+	return false;
+}
+
+Register JITGenerator::readReg(uint32_t offset) {
+	CachedReg *entry = findReg(offset);
+	if (!entry) {
+		entry = allocReg(offset);
+		generator.loadMem32(entry->reg, RBX, offset);
+	}
+	entry->locked = true;
+	entry->age = ++cacheAge;
+	return entry->reg;
+}
+
+Register JITGenerator::writeReg(uint32_t offset) {
+	CachedReg *entry = findReg(offset);
+	if (!entry) {
+		entry = allocReg(offset);
+	}
+	entry->dirty = true;
+	entry->locked = true;
+	entry->age = ++cacheAge;
+	return entry->reg;
+}
+
+JITGenerator::CachedReg *JITGenerator::findReg(uint32_t offset) {
+	for (CachedReg &entry : cache) {
+		if (entry.used && entry.offset == offset) {
+			return &entry;
+		}
+	}
+	return nullptr;
+}
+
+JITGenerator::CachedReg *JITGenerator::allocReg(uint32_t offset) {
+	CachedReg *entry = nullptr;
+	for (CachedReg &other : cache) {
+		if (!other.locked && (!entry || !other.used || (entry->used && other.age < entry->age))) {
+			entry = &other;
+		}
+	}
+	
+	if (entry->used && entry->dirty) {
+		generator.storeMem32(RBX, entry->offset, entry->reg);
+	}
+	
+	entry->offset = offset;
+	entry->used = true;
+	entry->dirty = false;
+	return entry;
+}
+
+void JITGenerator::flushRegs() {
+	for (CachedReg &entry : cache) {
+		if (entry.used && entry.dirty) {
+			generator.storeMem32(RBX, entry.offset, entry.reg);
+		}
+		entry.used = false;
+		entry.dirty = false;
+	}
+}
+
+void JITGenerator::syncPC() {
+	if (lag) {
+		generator.addRegImm32(RBP, lag * instrSize);
+		generator.storeMem32(RBX, pcOffset, RBP);
+		lag = 0;
+	}
+}
+
+void JITGenerator::generatePrologue() {
+	// RBX = processor, RBP = program counter of the current instruction
+	// The start address and the limit (RDX) are stored on the stack
+	generator.pushReg64(RBX);
+	generator.pushReg64(RBP);
+	generator.movReg64(RBX, RDI);
+	generator.loadMem32(RBP, RDI, pcOffset);
+	generator.pushReg64(RBP);
+	generator.storeMem32(RSP, 4, RDX);
+	generator.jumpReg64(RSI);
+	
+	// RDX = link site that was taken, if any
+	epilogue = generator.tell();
+	generator.xorReg32(RDX, RDX);
+	
+	linkEpilogue = generator.tell();
+	generator.movReg32(RAX, RBP);
+	generator.popReg64(RCX);
+	generator.subRegReg32(RAX, RCX);
+	generator.shrImm32(RAX, instrSize == 4 ? 2 : 1);
+	generator.addRegImm32(RAX, 1);
+	generator.popReg64(RBP);
+	generator.popReg64(RBX);
+	generator.ret();
+}
+
+void JITGenerator::generateChain(int index) {
+	Instruction &instr = instrs[index];
+	instr.chain = generator.tell();
+	instr.lag = lag;
+	current = index;
+	for (CachedReg &entry : cache) {
+		entry.locked = false;
+		if (entry.used) {
+			instr.cached.push_back(std::make_pair(entry.reg, entry.offset));
+		}
+	}
+	
+	bool last = instr.terminator || index == count - 1;
+	
+	instr.inlined = generateInline(index);
+	if (instr.inlined) {
+		if (last) {
+			flushRegs();
+			syncPC();
+			generator.jumpRel32(epilogue - (generator.tell() + 5));
+		}
+		else {
+			lag++;
+		}
+		return;
+	}
+	
+	// Bodies, including loads and stores, access the guest registers in
+	// memory and may clobber the host registers, so the cache ends here
+	flushRegs();
+	syncPC();
+	
+	instr.call = generator.tell();
+	generator.movReg64(RDI, RBX);
+	generator.callRel(instr.body - (generator.tell() + 5));
+	
+	generator.compareMemReg32(RBX, pcOffset, RBP);
+	if (instr.branch != NoBranch) {
+		instr.exit = generator.tell();
+		generator.jumpIfNotEqual32(0); // Patched by generateBranch
+	}
+	else {
+		generator.jumpIfNotEqual32(epilogue - (generator.tell() + 6));
+	}
+	
+	if (last) {
+		generator.jumpRel32(epilogue - (generator.tell() + 5));
+	}
+	else {
+		lag = 1;
+	}
+}
+
+void JITGenerator::generateEntry(int index) {
+	Instruction &instr = instrs[index];
+	if (!instr.inlined) {
+		entries.push_back(instr.call);
+	}
+	else if (!instr.lag && instr.cached.empty()) {
+		entries.push_back(instr.chain);
+	}
+	else {
+		entries.push_back(generator.tell());
+		if (instr.lag) {
+			generator.subRegImm32(RBP, instr.lag * instrSize);
+		}
+		for (auto &entry : instr.cached) {
+			generator.loadMem32(entry.first, RBX, entry.second);
+		}
+		generator.jumpRel32(instr.chain - (generator.tell() + 5));
+	}
+}
+
+void JITGenerator::generateBranch(int index) {
+	Instruction &instr = instrs[index];
+	
+	if (instr.inlined) {
+		// Each exit writes back its own registers and catches up with
+		// the program counter, then they continue at the same code
+		std::vector<uint32_t> jumps;
+		for (Exit &exit : instr.exits) {
+			uint32_t stub = generator.tell();
+			generator.seek(exit.jump);
+			generator.jumpIf32(exit.cond, stub - (exit.jump + 6));
+			generator.seek(stub);
+			
+			for (auto &entry : exit.dirty) {
+				generator.storeMem32(RBX, entry.second, entry.first);
+			}
+			if (exit.lag) {
+				generator.addRegImm32(RBP, exit.lag * instrSize);
+			}
+			if (&exit != &instr.exits.back()) {
+				jumps.push_back(generator.tell());
+				generator.jumpRel32(0);
+			}
+		}
+		
+		uint32_t stub = generator.tell();
+		for (uint32_t jump : jumps) {
+			generator.seek(jump);
+			generator.jumpRel32(stub - (jump + 5));
+		}
+		generator.seek(stub);
+	}
+	else {
+		uint32_t stub = generator.tell();
+		generator.seek(instr.exit);
+		generator.jumpIfNotEqual32(stub - (instr.exit + 6));
+		generator.seek(stub);
+	}
+	
+	if (instr.branch == Relative) {
+		generator.movReg32(RAX, RBP);
+		generator.addRegImm32(RAX, instr.target - instrSize);
+	}
+	else {
+		generator.movImm32(RAX, instr.target);
+	}
+	
+	if (instr.inlined) {
+		generator.storeMem32(RBX, pcOffset, RAX);
+	}
+	else {
+		// If the program counter is not the branch target, an exception occurred
+		generator.compareMemReg32(RBX, pcOffset, RAX);
+		generator.jumpIfNotEqual32(epilogue - (generator.tell() + 6));
+	}
+	
+	generator.movReg32(RCX, RBP);
+	generator.subRegMem32(RCX, RSP, 0);
+	generator.compareRegMem32(RCX, RSP, 4);
+	generator.jumpIfNotCarry32(epilogue - (generator.tell() + 6));
+	
+	// Move to the branch target. The start address on the stack is
+	// adjusted so that the epilogue still returns the right count.
+	generator.movReg32(RCX, RAX);
+	generator.subRegReg32(RCX, RBP);
+	generator.addMemReg32(RSP, 0, RCX);
+	generator.movReg32(RBP, RAX);
+	generator.addRegImm32(RBP, instrSize);
+	generator.storeMem32(RBX, pcOffset, RBP);
+	
+	int target = index + (int)instr.target / instrSize;
+	if (instr.branch == Relative && target >= 0 && target < count) {
+		generator.jumpRel32(entries[target] - (generator.tell() + 5));
+	}
+	else {
+		generateLinkSite();
+	}
+}
+
+void JITGenerator::generateLinkSite() {
+	generator.loadMem32(RCX, RBX, contextOffset);
+	generator.andImm32(RCX, contextMask);
+	generator.compareImm32(RCX, 0);
+	
+	uint32_t site = generator.tell() - 4;
+	generator.jumpIfNotEqual(5);
+	generator.jumpRel32(0);
+	
+	// The site is not linked (yet), so return to the processor
+	generator.subRegImm32(RBP, instrSize);
+	generator.storeMem32(RBX, pcOffset, RBP);
+	generator.leaRel64(RDX, site - (generator.tell() + 7));
+	generator.jumpRel32(linkEpilogue - (generator.tell() + 5));
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include "cpu/x86codegenerator.h"
+
+#include <vector>
+#include <utility>
+#include <cstdint>
+
+
+/*	Base class of the code generators. A compiled page looks like this:
+
+	- count jump stubs that execute a single instruction
+	- count jump stubs that execute a block starting at an instruction
+	- the block prologue and epilogue
+	- the instruction bodies
+	- the block chain, which calls the bodies one after another
+	- the entry stubs, which prepare the registers for the block chain
+	- the branch stubs, which jump to the target of a taken branch
+	
+	A block ends when an instruction changes the program counter (branch or
+	exception), when the end of the page is reached or after an instruction
+	that was marked with endBlock. The number of executed instructions is
+	returned by the block. The caller also passes an instruction limit, which
+	is checked whenever the block follows a branch.
+	
+	Simple instructions may be generated inline in the block chain instead
+	of calling their body. Inline code keeps guest registers in host
+	registers, which are written back before the next call and at the end
+	of the block. The program counter is only updated at these points too.
+	Inline conditional branches jump to their branch stub directly, which
+	writes back the guest registers before it follows the branch.
+	
+	Branches with a known target continue the block at the target instead.
+	If the target is in the same page, the branch stub jumps to it directly.
+	Otherwise, the branch stub contains a link site, which is returned by the
+	block and can be patched by the JIT once the target page is compiled.
+*/
+
+class JITGenerator {
+public:
+	// Offsets in a link site, relative to the returned pointer
+	static const int LinkContext = 0;
+	static const int LinkTarget = 7;
+	static const int LinkEnd = 11;
+	
+	// Default instruction limit of a block with branches
+	static const int BlockLimit = 0x1000;
+	
+	JITGenerator(int count, int instrSize, uint32_t pcOffset);
+	virtual ~JITGenerator();
+	
+	char *get();
+	size_t size();
+	
+	// Instructions that may fault, with the offset of their slow path
+	std::vector<std::pair<uint32_t, uint32_t>> &getFaultSites();
+	
+	// Offsets of the host addresses in the code
+	std::vector<uint32_t> &getRelocations();
+
+protected:
+	void beginInstr();
+	void endBlock();
+	
+	void branch(uint32_t offset);
+	void branchAbs(uint32_t target);
+	
+	// Jumps from inline code to the branch stub of an instruction
+	void jumpToBranch(int index, Condition cond);
+	
+	void setLinkContext(uint32_t offset, uint32_t mask);
+	void addFaultSite(uint32_t addr, uint32_t handler);
+	
+	// Called before the block chain is generated. A generator that needs
+	// to look ahead may collect the instructions and generate them here.
+	virtual void generateBodies();
+	
+	// Generates the instruction inline in the block chain. Returns
+	// false if the instruction must be executed by its body.
+	virtual bool generateInline(int index);
+	
+	// Return the host register that holds a guest register in inline code
+	Register readReg(uint32_t offset);
+	Register writeReg(uint32_t offset);
+	
+	X86CodeGenerator generator;
+
+private:
+	enum BranchType {
+		NoBranch, Relative, Absolute
+	};
+	
+	struct Exit {
+		uint32_t jump;
+		Condition cond;
+		int lag;
+		std::vector<std::pair<Register, uint32_t>> dirty;
+	};
+	
+	struct Instruction {
+		uint32_t body;
+		bool terminator;
+		BranchType branch;
+		uint32_t target;
+		
+		uint32_t chain;
+		uint32_t call;
+		uint32_t exit;
+		bool inlined;
+		
+		int lag;
+		std::vector<std::pair<Register, uint32_t>> cached;
+		std::vector<Exit> exits;
+	};
+	
+	struct CachedReg {
+		Register reg;
+		uint32_t offset;
+		bool used;
+		bool dirty;
+		bool locked;
+		int age;
+	};
+	
+	void generatePrologue();
+	void generateChain(int index);
+	void generateEntry(int index);
+	void generateBranch(int index);
+	void generateLinkSite();
+	
+	void syncPC();
+	
+	CachedReg *findReg(uint32_t offset);
+	CachedReg *allocReg(uint32_t offset);
+	void flushRegs();
+	
+	int count;
+	int instrSize;
+	uint32_t pcOffset;
+	
+	uint32_t contextOffset;
+	uint32_t contextMask;
+	
+	uint32_t epilogue;
+	uint32_t linkEpilogue;
+	
+	std::vector<Instruction> instrs;
+	std::vector<uint32_t> entries;
+	
+	std::vector<std::pair<uint32_t, uint32_t>> faultSites;
+	
+	std::vector<CachedReg> cache;
+	int cacheAge;
+	int lag;
+	int current;
+};
@@ -1,4 +1,3 @@
-
 #include "mmucache.h"
 
 #include "common/logger.h"
@@ -6,12 +5,14 @@
 #include <cstring>
 
 
-MMUCache::MMUCache() {
+MMUCache::MMUCache(int pageBits) {
+	this->pageBits = pageBits;
 	reset();
 }
 
 void MMUCache::reset() {
-	invalidate();
+	memset(entries, 0, sizeof(entries));
+	generation = 1;
 	
 	#if STATS
 	hits = 0;
@@ -20,26 +21,53 @@ void MMUCache::reset() {
 }
 
 void MMUCache::invalidate() {
-	memset(entries, 0xFF, sizeof(entries));
+	if (++generation == 0) {
+		memset(entries, 0, sizeof(entries));
+		generation = 1;
+	}
 }
 
-void MMUCache::update(MemoryAccess type, bool supervisor, uint32_t vaddr, uint32_t paddr, uint32_t mask) {
+void MMUCache::invalidate(uint32_t vaddr) {
+	for (int type = 0; type < 3; type++) {
+		for (int supervisor = 0; supervisor < 2; supervisor++) {
+			MMUCacheEntry *set = getSet((MemoryAccess)type, supervisor, vaddr);
+			for (int i = 0; i < Ways; i++) {
+				set[i].generation = 0;
+			}
+		}
+	}
+}
+
+MMUCacheEntry *MMUCache::getSet(MemoryAccess type, bool supervisor, uint32_t vaddr) {
 	int index = (int)type * 2 + supervisor;
+	return entries[index][(vaddr >> pageBits) % Sets];
+}
+
+void MMUCache::update(MemoryAccess type, bool supervisor, uint32_t vaddr, uint32_t paddr, uint32_t mask) {
+	MMUCacheEntry *set = getSet(type, supervisor, vaddr);
 	
-	entries[index].vaddr = vaddr & ~mask;
-	entries[index].paddr = paddr;
-	entries[index].mask = mask;
+	// The oldest entry is replaced
+	for (int i = Ways - 1; i > 0; i--) {
+		set[i] = set[i - 1];
+	}
+	
+	set[0].vaddr = vaddr & ~mask;
+	set[0].paddr = paddr;
+	set[0].mask = mask;
+	set[0].generation = generation;
 }
 
 bool MMUCache::translate(uint32_t *addr, MemoryAccess type, bool supervisor) {
-	int index = (int)type * 2 + supervisor;
-	uint32_t mask = entries[index].mask;
-	if ((*addr & ~mask) == entries[index].vaddr) {
-		*addr = (*addr & mask) | entries[index].paddr;
-		#if STATS
-		hits++;
-		#endif
-		return true;
+	MMUCacheEntry *set = getSet(type, supervisor, *addr);
+	for (int i = 0; i < Ways; i++) {
+		MMUCacheEntry *entry = &set[i];
+		if ((*addr & ~entry->mask) == entry->vaddr && entry->generation == generation) {
+			*addr = (*addr & entry->mask) | entry->paddr;
+			#if STATS
+			hits++;
+			#endif
+			return true;
+		}
 	}
 	#if STATS
 	misses++;
@@ -11,15 +11,32 @@ struct MMUCacheEntry {
 	uint32_t vaddr;
 	uint32_t paddr;
 	uint32_t mask;
+	uint32_t generation;
 };
 
 
+/*	Software TLB with a set associative table for every combination of
+	access type and privilege level. The set is selected by the address
+	bits above pageBits, which is the smallest translation unit of the MMU.
+	Entries may cover a larger block, for example a section.
+	
+	Entries are only valid for the current generation, so that the whole
+	cache can be invalidated quickly.
+*/
+
 class MMUCache {
 public:
-	MMUCache();
+	static const int Sets = 256;
+	static const int Ways = 4;
+	
+	MMUCache(int pageBits);
 	
 	void reset();
 	void invalidate();
+	
+	// Invalidates the entries in the sets that the address maps to
+	void invalidate(uint32_t vaddr);
+	
 	void update(MemoryAccess type, bool supervisor, uint32_t vaddr, uint32_t paddr, uint32_t mask);
 	
 	bool translate(uint32_t *addr, MemoryAccess type, bool supervisor);
@@ -28,7 +45,12 @@ public:
 	uint64_t hits;
 	uint64_t misses;
 	#endif
-	
+
 private:
-	MMUCacheEntry entries[6];
+	MMUCacheEntry *getSet(MemoryAccess type, bool supervisor, uint32_t vaddr);
+	
+	int pageBits;
+	uint32_t generation;
+	
+	MMUCacheEntry entries[6][Sets][Ways];
 };
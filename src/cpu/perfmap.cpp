@@ -0,0 +1,138 @@
+#include "cpu/perfmap.h"
+
+#include "common/stringutils.h"
+#include "common/logger.h"
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+
+
+// See tools/perf/Documentation/jitdump-specification.txt in Linux
+struct JitDumpHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t size;
+	uint32_t machine;
+	uint32_t pad;
+	uint32_t pid;
+	uint64_t timestamp;
+	uint64_t flags;
+};
+
+struct JitDumpCodeLoad {
+	uint32_t id;
+	uint32_t size;
+	uint64_t timestamp;
+	uint32_t pid;
+	uint32_t tid;
+	uint64_t vma;
+	uint64_t codeAddr;
+	uint64_t codeSize;
+	uint64_t codeIndex;
+};
+
+static const uint32_t JitDumpMagic = 0x4A695444;
+static const uint32_t JitDumpMachine = 62; // EM_X86_64
+static const uint32_t JitCodeLoad = 0;
+
+static PerfMap *instance;
+
+
+// The jitdump may be enabled after the perf map
+void PerfMap::enable(bool jitdump) {
+	if (!instance) {
+		instance = new PerfMap(jitdump);
+	}
+	else if (jitdump && !instance->dump) {
+		std::lock_guard<std::mutex> lock(instance->mutex);
+		instance->openJitDump();
+	}
+}
+
+PerfMap *PerfMap::get() {
+	return instance;
+}
+
+PerfMap::PerfMap(bool jitdump) {
+	codeIndex = 0;
+	
+	std::string filename = StringUtils::format("/tmp/perf-%i.map", getpid());
+	map = fopen(filename.c_str(), "w");
+	if (!map) {
+		Logger::warning("Failed to create perf map: %s", filename);
+	}
+	
+	dump = nullptr;
+	if (jitdump) {
+		openJitDump();
+	}
+}
+
+void PerfMap::openJitDump() {
+	std::string filename = StringUtils::format("/tmp/jit-%i.dump", getpid());
+	dump = fopen(filename.c_str(), "w+");
+	if (!dump) {
+		Logger::warning("Failed to create jitdump: %s", filename);
+		return;
+	}
+	
+	// perf record finds the file through this mapping
+	long pagesize = sysconf(_SC_PAGESIZE);
+	void *marker = mmap(nullptr, pagesize, PROT_READ | PROT_EXEC, MAP_PRIVATE, fileno(dump), 0);
+	if (marker == MAP_FAILED) {
+		Logger::warning("Failed to map jitdump: %s", filename);
+		fclose(dump);
+		dump = nullptr;
+		return;
+	}
+	
+	JitDumpHeader header = {};
+	header.magic = JitDumpMagic;
+	header.version = 1;
+	header.size = sizeof(header);
+	header.machine = JitDumpMachine;
+	header.pid = getpid();
+	header.timestamp = getTimestamp();
+	fwrite(&header, sizeof(header), 1, dump);
+	fflush(dump);
+}
+
+void PerfMap::add(const void *code, size_t size, std::string name) {
+	std::lock_guard<std::mutex> lock(mutex);
+	
+	if (map) {
+		fprintf(map, "%lx %zx %s\n", (unsigned long)code, size, name.c_str());
+		fflush(map);
+	}
+	
+	if (dump) {
+		writeJitDump(code, size, name);
+	}
+}
+
+void PerfMap::writeJitDump(const void *code, size_t size, std::string name) {
+	JitDumpCodeLoad record;
+	record.id = JitCodeLoad;
+	record.size = sizeof(record) + name.size() + 1 + size;
+	record.timestamp = getTimestamp();
+	record.pid = getpid();
+	record.tid = syscall(SYS_gettid);
+	record.vma = (uint64_t)code;
+	record.codeAddr = (uint64_t)code;
+	record.codeSize = size;
+	record.codeIndex = codeIndex++;
+	
+	fwrite(&record, sizeof(record), 1, dump);
+	fwrite(name.c_str(), name.size() + 1, 1, dump);
+	fwrite(code, size, 1, dump);
+	fflush(dump);
+}
+
+uint64_t PerfMap::getTimestamp() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <string>
+#include <mutex>
+
+#include <cstdio>
+#include <cstdint>
+
+
+/*	Tells Linux perf where the compiled pages are, so that profiles of
+	the emulator show the guest code instead of anonymous memory.
+	
+	The perf map (/tmp/perf-<pid>.map) is a text file with one line per
+	page and is read by perf report directly. The code arena is reused
+	when it is full, so addresses in the perf map may become ambiguous.
+	
+	The jitdump file (/tmp/jit-<pid>.dump) also contains the code itself
+	and the time at which it was compiled. It must be merged into the
+	profile with perf inject --jit, and perf record must use the same
+	clock (-k mono).
+*/
+
+class PerfMap {
+public:
+	static void enable(bool jitdump);
+	
+	// Returns null unless enabled
+	static PerfMap *get();
+	
+	void add(const void *code, size_t size, std::string name);
+
+private:
+	PerfMap(bool jitdump);
+	
+	void openJitDump();
+	void writeJitDump(const void *code, size_t size, std::string name);
+	
+	static uint64_t getTimestamp();
+	
+	FILE *map;
+	FILE *dump;
+	
+	uint64_t codeIndex;
+	
+	std::mutex mutex;
+};
@@ -12,10 +12,15 @@
 
 #define PC offsetof(PPCProcessor, core.pc)
 #define CR offsetof(PPCProcessor, core.cr)
+#define MSR offsetof(PPCProcessor, core.msr)
 
 #define REG(i) (offsetof(PPCProcessor, core.regs) + (i) * 4)
 #define SPR(r) (offsetof(PPCProcessor, core.sprs[PPCCore::r]))
 
+#define FASTMEM_READ offsetof(PPCProcessor, fastmem.readTable)
+#define FASTMEM_WRITE offsetof(PPCProcessor, fastmem.writeTable)
+#define RESERVATION offsetof(PPCProcessor, reservation)
+
 #define FPR_PS0(i) (offsetof(PPCProcessor, core.fprs) + (i) * 8 + 4)
 #define FPR_PS1(i) (offsetof(PPCProcessor, core.fprs) + (i) * 8)
 #define FPR_IW0(i) (offsetof(PPCProcessor, core.fprs) + (i) * 8 + 4)
@@ -30,6 +35,21 @@ static uint32_t genmask(int start, int end) {
 	return (0xFFFFFFFF >> start) | (0xFFFFFFFF << (31 - end));
 }
 
+static uint32_t crmask(int crm) {
+	uint32_t mask = 0;
+	for (int i = 0; i < 8; i++) {
+		if (crm & (0x80 >> i)) {
+			mask |= 0xF0000000 >> (4 * i);
+		}
+	}
+	return mask;
+}
+
+// Branches that only test a condition register bit are generated inline
+static bool isConditionalBranch(PPCInstruction instr) {
+	return (instr.bo() & 0x14) == 4 && !instr.lk();
+}
+
 
 void executeInstr(PPCProcessor *cpu, PPCInstruction instr) {
 	#if STATS
@@ -64,35 +84,82 @@ static bool storeMemory(PPCProcessor *cpu, uint32_t addr, uint32_t value) {
 	return cpu->write<T>(addr, value);
 }
 
+bool loadLong(PPCProcessor *cpu, uint32_t addr, uint64_t *ptr) {
+	return cpu->read<uint64_t>(addr, ptr);
+}
+
 bool storeLong(PPCProcessor *cpu, uint32_t addr, uint64_t value) {
 	return cpu->write<uint64_t>(addr, value);
 }
 
-
-PPCCodeGenerator::PPCCodeGenerator() : generator(0x8000) {
-	generator.seek(0x400 * 5);
-	index = 0;
+static bool loadPaired(PPCProcessor *cpu, uint32_t addr, PPCInstruction instr) {
+	return psqLoad(cpu, addr, instr.rD(), instr.ps_i(), instr.ps_w());
 }
 
-char *PPCCodeGenerator::get() {
-	generator.seek(0);
-	for (int i = 0; i < index; i++) {
-		generator.jumpRel(offsets[i]);
-	}
-	return generator.get();
+static bool storePaired(PPCProcessor *cpu, uint32_t addr, PPCInstruction instr) {
+	return psqStore(cpu, addr, instr.rS(), instr.ps_i(), instr.ps_w());
 }
 
-size_t PPCCodeGenerator::size() {
-	return generator.size();
+
+PPCCodeGenerator::PPCCodeGenerator() : JITGenerator(0x400, 4, PC) {
+	// Links between pages depend on the PR and IR bits
+	setLinkContext(MSR, 0x4020);
+	
+	inlineIndex = 0;
+	fusedBranch = 0;
 }
 
 void PPCCodeGenerator::generate(uint32_t value) {
 	PPCInstruction instr;
 	instr.value = value;
 	
-	offsets[index] = generator.tell() - (index + 1) * 5;
+	beginInstr();
 	generateInstr(instr);
-	index++;
+	
+	values.push_back(value);
+}
+
+bool PPCCodeGenerator::generateInline(int index) {
+	#if METRICS
+	return false;
+	#else
+	PPCInstruction instr;
+	instr.value = values[index];
+	inlineIndex = index;
+	
+	int type = instr.opcode();
+	if (type == 10) inlineCompare(instr, true, true);
+	else if (type == 11) inlineCompare(instr, false, true);
+	else if (type == 14) inlineAddi(instr);
+	else if (type == 15) inlineAddis(instr);
+	else if (type == 16 && isConditionalBranch(instr)) inlineBc(instr);
+	else if (type == 19 && instr.opcode2() == 33) inlineCrLogic(instr, Nor);
+	else if (type == 19 && instr.opcode2() == 129) inlineCrLogic(instr, AndC);
+	else if (type == 19 && instr.opcode2() == 193) inlineCrLogic(instr, Xor);
+	else if (type == 19 && instr.opcode2() == 225) inlineCrLogic(instr, Nand);
+	else if (type == 19 && instr.opcode2() == 257) inlineCrLogic(instr, And);
+	else if (type == 19 && instr.opcode2() == 289) inlineCrLogic(instr, Eqv);
+	else if (type == 19 && instr.opcode2() == 417) inlineCrLogic(instr, OrC);
+	else if (type == 19 && instr.opcode2() == 449) inlineCrLogic(instr, Or);
+	else if (type == 20) inlineRlwimi(instr);
+	else if (type == 21) inlineRlwinm(instr);
+	else if (type == 24) inlineOri(instr);
+	else if (type == 25) inlineOris(instr);
+	else if (type == 26) inlineXori(instr);
+	else if (type == 27) inlineXoris(instr);
+	else if (type == 28) inlineAndi(instr);
+	else if (type == 29) inlineAndis(instr);
+	else if (type == 31 && instr.opcode2() == 0) inlineCompare(instr, false, false);
+	else if (type == 31 && instr.opcode2() == 19) inlineMfcr(instr);
+	else if (type == 31 && instr.opcode2() == 32) inlineCompare(instr, true, false);
+	else if (type == 31 && instr.opcode2() == 144) inlineMtcrf(instr);
+	else if (type == 31 && instr.opcode2() == 266) inlineAdd(instr);
+	else if (type == 31 && instr.opcode2() == 444) inlineOr(instr);
+	else {
+		return false;
+	}
+	return true;
+	#endif
 }
 
 void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
@@ -103,32 +170,32 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	int type = instr.opcode();
 	if (type == 4) {
 		int type = instr.opcode2();
-		if (type == 18) generateUnimplemented(instr);
-		else if (type == 20) generateUnimplemented(instr);
-		else if (type == 21) generateUnimplemented(instr);
+		if (type == 18) generateFloatArith(instr, Packed, Div);
+		else if (type == 20) generateFloatArith(instr, Packed, Sub);
+		else if (type == 21) generateFloatArith(instr, Packed, Add);
 		else if (type == 32) generateUnimplemented(instr);
-		else if (type == 40) generateUnimplemented(instr);
-		else if (type == 72) generateUnimplemented(instr);
-		else if (type == 136) generateUnimplemented(instr);
-		else if (type == 264) generateUnimplemented(instr);
-		else if (type == 528) generateUnimplemented(instr);
-		else if (type == 560) generateUnimplemented(instr);
-		else if (type == 592) generateUnimplemented(instr);
-		else if (type == 624) generateUnimplemented(instr);
+		else if (type == 40) generateFloatSign(instr, Packed, Negate);
+		else if (type == 72) generateFloatMove(instr, Packed);
+		else if (type == 136) generateFloatSign(instr, Packed, NegateAbs);
+		else if (type == 264) generateFloatSign(instr, Packed, Abs);
+		else if (type == 528) generatePsMerge(instr, false, false);
+		else if (type == 560) generatePsMerge(instr, false, true);
+		else if (type == 592) generatePsMerge(instr, true, false);
+		else if (type == 624) generatePsMerge(instr, true, true);
 		else if (type == 1014) generator.ret(); // dcbz_l
 		else {
 			int type = instr.opcode3();
-			if (type == 10) generateUnimplemented(instr);
-			else if (type == 11) generateUnimplemented(instr);
-			else if (type == 12) generateUnimplemented(instr);
-			else if (type == 13) generateUnimplemented(instr);
-			else if (type == 14) generateUnimplemented(instr);
-			else if (type == 15) generateUnimplemented(instr);
-			else if (type == 25) generateUnimplemented(instr);
-			else if (type == 28) generateUnimplemented(instr);
-			else if (type == 29) generateUnimplemented(instr);
-			else if (type == 30) generateUnimplemented(instr);
-			else if (type == 31) generateUnimplemented(instr);
+			if (type == 10) generatePsSum(instr, false);
+			else if (type == 11) generatePsSum(instr, true);
+			else if (type == 12) generateFloatArith(instr, Packed, Mul, 0);
+			else if (type == 13) generateFloatArith(instr, Packed, Mul, 1);
+			else if (type == 14) generateFloatMulAdd(instr, Packed, Add, false, 0);
+			else if (type == 15) generateFloatMulAdd(instr, Packed, Add, false, 1);
+			else if (type == 25) generateFloatArith(instr, Packed, Mul);
+			else if (type == 28) generateFloatMulAdd(instr, Packed, Sub, false);
+			else if (type == 29) generateFloatMulAdd(instr, Packed, Add, false);
+			else if (type == 30) generateFloatMulAdd(instr, Packed, Sub, true);
+			else if (type == 31) generateFloatMulAdd(instr, Packed, Add, true);
 			else {
 				generateError(instr);
 			}
@@ -136,8 +203,8 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	}
 	else if (type == 7) generateUnimplemented(instr);
 	else if (type == 8) generateUnimplemented(instr);
-	else if (type == 10) generateUnimplemented(instr);
-	else if (type == 11) generateUnimplemented(instr);
+	else if (type == 10) generateCompare(instr, true, true);
+	else if (type == 11) generateCompare(instr, false, true);
 	else if (type == 12) generateUnimplemented(instr);
 	else if (type == 13) generateUnimplemented(instr);
 	else if (type == 14) generateAddi(instr);
@@ -148,16 +215,16 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	else if (type == 19) {
 		int type = instr.opcode2();
 		if (type == 16) generateUnimplemented(instr);
-		else if (type == 33) generateUnimplemented(instr);
+		else if (type == 33) generateCrLogic(instr, Nor);
 		else if (type == 50) generateUnimplemented(instr);
-		else if (type == 129) generateUnimplemented(instr);
-		else if (type == 150) generator.ret(); // isync
-		else if (type == 193) generateUnimplemented(instr);
-		else if (type == 225) generateUnimplemented(instr);
-		else if (type == 257) generateUnimplemented(instr);
-		else if (type == 289) generateUnimplemented(instr);
-		else if (type == 417) generateUnimplemented(instr);
-		else if (type == 449) generateUnimplemented(instr);
+		else if (type == 129) generateCrLogic(instr, AndC);
+		else if (type == 150) generateIsync();
+		else if (type == 193) generateCrLogic(instr, Xor);
+		else if (type == 225) generateCrLogic(instr, Nand);
+		else if (type == 257) generateCrLogic(instr, And);
+		else if (type == 289) generateCrLogic(instr, Eqv);
+		else if (type == 417) generateCrLogic(instr, OrC);
+		else if (type == 449) generateCrLogic(instr, Or);
 		else if (type == 528) generateUnimplemented(instr);
 		else {
 			generateError(instr);
@@ -174,17 +241,17 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	else if (type == 29) generateAndis(instr);
 	else if (type == 31) {
 		int type = instr.opcode2();
-		if (type == 0) generateUnimplemented(instr);
+		if (type == 0) generateCompare(instr, false, false);
 		else if (type == 8) generateUnimplemented(instr);
 		else if (type == 10) generateUnimplemented(instr);
 		else if (type == 11) generateUnimplemented(instr);
-		else if (type == 19) generateUnimplemented(instr);
+		else if (type == 19) generateMfcr(instr);
 		else if (type == 20) generateUnimplemented(instr);
 		else if (type == 23) generateUnimplemented(instr);
 		else if (type == 24) generateUnimplemented(instr);
 		else if (type == 26) generateUnimplemented(instr);
 		else if (type == 28) generateUnimplemented(instr);
-		else if (type == 32) generateUnimplemented(instr);
+		else if (type == 32) generateCompare(instr, true, false);
 		else if (type == 40) generateUnimplemented(instr);
 		else if (type == 54) generator.ret(); // dcbst
 		else if (type == 55) generateUnimplemented(instr);
@@ -198,21 +265,21 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 		else if (type == 124) generateUnimplemented(instr);
 		else if (type == 136) generateUnimplemented(instr);
 		else if (type == 138) generateUnimplemented(instr);
-		else if (type == 144) generateUnimplemented(instr);
-		else if (type == 146) generateUnimplemented(instr);
+		else if (type == 144) generateMtcrf(instr);
+		else if (type == 146) generateContextSync(instr); // mtmsr
 		else if (type == 150) generateUnimplemented(instr);
 		else if (type == 151) generateUnimplemented(instr);
 		else if (type == 183) generateUnimplemented(instr);
 		else if (type == 200) generateUnimplemented(instr);
 		else if (type == 202) generateUnimplemented(instr);
-		else if (type == 210) generateUnimplemented(instr);
+		else if (type == 210) generateUnimplemented(instr); // mtsr
 		else if (type == 215) generateUnimplemented(instr);
 		else if (type == 234) generateUnimplemented(instr);
 		else if (type == 235) generateUnimplemented(instr);
 		else if (type == 247) generateUnimplemented(instr);
 		else if (type == 266) generateAdd(instr);
 		else if (type == 279) generateUnimplemented(instr);
-		else if (type == 306) generateUnimplemented(instr);
+		else if (type == 306) generateContextSync(instr); // tlbie
 		else if (type == 311) generateUnimplemented(instr);
 		else if (type == 316) generateUnimplemented(instr);
 		else if (type == 339) generateUnimplemented(instr);
@@ -224,7 +291,7 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 		else if (type == 439) generateUnimplemented(instr);
 		else if (type == 444) generateUnimplemented(instr);
 		else if (type == 459) generateUnimplemented(instr);
-		else if (type == 467) generateUnimplemented(instr);
+		else if (type == 467) generateMtspr(instr);
 		else if (type == 470) generator.ret(); // dcbi
 		else if (type == 491) generateUnimplemented(instr);
 		else if (type == 534) generateLwbrx(instr);
@@ -247,7 +314,7 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 		else if (type == 854) generator.ret(); // eieio
 		else if (type == 922) generateUnimplemented(instr);
 		else if (type == 954) generateUnimplemented(instr);
-		else if (type == 982) generateUnimplemented(instr);
+		else if (type == 982) generateContextSync(instr); // icbi
 		else if (type == 983) generateStfiwx(instr);
 		else if (type == 1014) generateUnimplemented(instr);
 		else {
@@ -258,16 +325,16 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	else if (type == 33) generateLoadu<uint32_t>(instr);
 	else if (type == 34) generateLoad<uint8_t>(instr);
 	else if (type == 35) generateLoadu<uint8_t>(instr);
-	else if (type == 36) generateUnimplemented(instr);
-	else if (type == 37) generateUnimplemented(instr);
-	else if (type == 38) generateUnimplemented(instr);
-	else if (type == 39) generateUnimplemented(instr);
+	else if (type == 36) generateStore<uint32_t>(instr);
+	else if (type == 37) generateStoreu<uint32_t>(instr);
+	else if (type == 38) generateStore<uint8_t>(instr);
+	else if (type == 39) generateStoreu<uint8_t>(instr);
 	else if (type == 40) generateLoad<uint16_t>(instr);
 	else if (type == 41) generateLoadu<uint16_t>(instr);
 	else if (type == 42) generateLoad<int16_t>(instr);
 	else if (type == 43) generateLoadu<int16_t>(instr);
-	else if (type == 44) generateUnimplemented(instr);
-	else if (type == 45) generateUnimplemented(instr);
+	else if (type == 44) generateStore<uint16_t>(instr);
+	else if (type == 45) generateStoreu<uint16_t>(instr);
 	else if (type == 46) generateUnimplemented(instr);
 	else if (type == 47) generateUnimplemented(instr);
 	else if (type == 48) generateUnimplemented(instr);
@@ -278,45 +345,47 @@ void PPCCodeGenerator::generateInstr(PPCInstruction instr) {
 	else if (type == 53) generateUnimplemented(instr);
 	else if (type == 54) generateUnimplemented(instr);
 	else if (type == 55) generateUnimplemented(instr);
-	else if (type == 56) generateUnimplemented(instr);
+	else if (type == 56) generatePsqLoad(instr, false);
+	else if (type == 57) generatePsqLoad(instr, true);
 	else if (type == 59) {
 		int type = instr.opcode3();
-		if (type == 18) generateUnimplemented(instr);
-		else if (type == 20) generateUnimplemented(instr);
-		else if (type == 21) generateUnimplemented(instr);
-		else if (type == 24) generateUnimplemented(instr);
-		else if (type == 25) generateUnimplemented(instr);
-		else if (type == 28) generateUnimplemented(instr);
-		else if (type == 29) generateUnimplemented(instr);
-		else if (type == 30) generateUnimplemented(instr);
-		else if (type == 31) generateUnimplemented(instr);
+		if (type == 18) generateFloatArith(instr, Single, Div);
+		else if (type == 20) generateFloatArith(instr, Single, Sub);
+		else if (type == 21) generateFloatArith(instr, Single, Add);
+		else if (type == 24) generateFres(instr);
+		else if (type == 25) generateFloatArith(instr, Single, Mul);
+		else if (type == 28) generateFloatMulAdd(instr, Single, Sub, false);
+		else if (type == 29) generateFloatMulAdd(instr, Single, Add, false);
+		else if (type == 30) generateFloatMulAdd(instr, Single, Sub, true);
+		else if (type == 31) generateFloatMulAdd(instr, Single, Add, true);
 		else {
 			generateError(instr);
 		}
 	}
-	else if (type == 60) generateUnimplemented(instr);
+	else if (type == 60) generatePsqStore(instr, false);
+	else if (type == 61) generatePsqStore(instr, true);
 	else if (type == 63) {
 		int type = instr.opcode2();
 		if (type == 0) generateUnimplemented(instr);
-		else if (type == 12) generateUnimplemented(instr);
-		else if (type == 15) generateUnimplemented(instr);
-		else if (type == 18) generateUnimplemented(instr);
-		else if (type == 20) generateUnimplemented(instr);
-		else if (type == 21) generateUnimplemented(instr);
+		else if (type == 12) generateFrsp(instr);
+		else if (type == 15) generateFctiwz(instr);
+		else if (type == 18) generateFloatArith(instr, Double, Div);
+		else if (type == 20) generateFloatArith(instr, Double, Sub);
+		else if (type == 21) generateFloatArith(instr, Double, Add);
 		else if (type == 26) generateUnimplemented(instr);
-		else if (type == 40) generateUnimplemented(instr);
-		else if (type == 72) generateUnimplemented(instr);
+		else if (type == 40) generateFloatSign(instr, Double, Negate);
+		else if (type == 72) generateFloatMove(instr, Single);
 		else if (type == 264) generateUnimplemented(instr);
 		else if (type == 583) generateUnimplemented(instr);
 		else if (type == 711) generateUnimplemented(instr);
 		else {
 			int type = instr.opcode3();
 			if (type == 23) generateUnimplemented(instr);
-			else if (type == 25) generateUnimplemented(instr);
-			else if (type == 28) generateUnimplemented(instr);
-			else if (type == 29) generateUnimplemented(instr);
-			else if (type == 30) generateUnimplemented(instr);
-			else if (type == 31) generateUnimplemented(instr);
+			else if (type == 25) generateFloatArith(instr, Double, Mul);
+			else if (type == 28) generateFloatMulAdd(instr, Double, Sub, false);
+			else if (type == 29) generateFloatMulAdd(instr, Double, Add, false);
+			else if (type == 30) generateFloatMulAdd(instr, Double, Sub, true);
+			else if (type == 31) generateFloatMulAdd(instr, Double, Add, true);
 			else {
 				generateError(instr);
 			}
@@ -341,9 +410,46 @@ void PPCCodeGenerator::generateError(PPCInstruction instr) {
 	generator.jumpAbs(RAX, (uint64_t)throwInstr);
 }
 
+// Calls the interpreter handler of the instruction directly. The handler
+// takes a pointer to the instruction, so its value is stored after the jump.
 void PPCCodeGenerator::generateUnimplemented(PPCInstruction instr) {
+	#if STATS
 	generator.movImm32(RSI, instr.value);
 	generator.jumpAbs(RAX, (uint64_t)executeInstr);
+	#else
+	PPCInstruction::Handler handler = instr.decode();
+	if (!handler) {
+		generator.ret();
+		return;
+	}
+	
+	generator.movReg64(RSI, RDI);
+	generator.leaRel64(RDI, 12);
+	generator.jumpAbs(RAX, (uint64_t)handler);
+	generator.u32(instr.value);
+	#endif
+}
+
+void PPCCodeGenerator::generateContextSync(PPCInstruction instr) {
+	// The instruction may change the address translation or
+	// invalidate the code that is being executed
+	generateUnimplemented(instr);
+	endBlock();
+}
+
+void PPCCodeGenerator::generateIsync() {
+	generator.ret();
+	endBlock();
+}
+
+void PPCCodeGenerator::generateMtspr(PPCInstruction instr) {
+	int spr = instr.spr();
+	if (spr == 1 || spr == 8 || spr == 9 || (spr >= 912 && spr < 920)) { // XER, LR, CTR, GQR
+		generateUnimplemented(instr);
+	}
+	else {
+		generateContextSync(instr);
+	}
 }
 
 template <class T>
@@ -355,15 +461,32 @@ void PPCCodeGenerator::generateLoad(PPCInstruction instr) {
 	else {
 		generator.movImm32(RSI, instr.d());
 	}
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_READ, sizeof(T));
+	uint32_t fault = generator.tell();
+	generateFastmemLoad<T>();
+	generator.storeMem32(RDI, REG(instr.rD()), RAX);
+	generator.ret();
+	
+	generateSlowPath(0, jump, fault);
 	generator.lea64(RDX, RDI, REG(instr.rD()));
 	generator.jumpAbs(RAX, (uint64_t)loadMemory<T>);
 }
 
 template <class T>
 void PPCCodeGenerator::generateLoadu(PPCInstruction instr) {
-	generator.pushReg64(RDI);
 	generator.loadMem32(RSI, RDI, REG(instr.rA()));
 	generator.addRegImm32(RSI, instr.d());
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_READ, sizeof(T));
+	uint32_t fault = generator.tell();
+	generateFastmemLoad<T>();
+	generator.storeMem32(RDI, REG(instr.rD()), RAX);
+	generator.addMemImm32(RDI, REG(instr.rA()), instr.d());
+	generator.ret();
+	
+	generateSlowPath(0, jump, fault);
+	generator.pushReg64(RDI);
 	generator.lea64(RDX, RDI, REG(instr.rD()));
 	generator.callAbs(RAX, (uint64_t)loadMemory<T>);
 	generator.popReg64(RDI);
@@ -374,6 +497,133 @@ void PPCCodeGenerator::generateLoadu(PPCInstruction instr) {
 	generator.ret();
 }
 
+template <class T>
+void PPCCodeGenerator::generateStore(PPCInstruction instr) {
+	if (instr.rA()) {
+		generator.loadMem32(RSI, RDI, REG(instr.rA()));
+		generator.addRegImm32(RSI, instr.d());
+	}
+	else {
+		generator.movImm32(RSI, instr.d());
+	}
+	
+	// Stores to the reserved address must reset the reservation
+	generator.loadMem64(RAX, RDI, RESERVATION);
+	generator.compareMemReg32(RAX, offsetof(PPCReservation, addr), RSI);
+	uint32_t reserved = generator.tell();
+	generator.jumpIfEqual32(0);
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_WRITE, sizeof(T));
+	generator.loadMem32(RDX, RDI, REG(instr.rS()));
+	uint32_t fault = generateFastmemStore<T>();
+	generator.ret();
+	
+	generateSlowPath(reserved, jump, fault);
+	generator.loadMem32(RDX, RDI, REG(instr.rS()));
+	generator.jumpAbs(RAX, (uint64_t)storeMemory<T>);
+}
+
+template <class T>
+void PPCCodeGenerator::generateStoreu(PPCInstruction instr) {
+	generator.loadMem32(RSI, RDI, REG(instr.rA()));
+	generator.addRegImm32(RSI, instr.d());
+	
+	generator.loadMem64(RAX, RDI, RESERVATION);
+	generator.compareMemReg32(RAX, offsetof(PPCReservation, addr), RSI);
+	uint32_t reserved = generator.tell();
+	generator.jumpIfEqual32(0);
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_WRITE, sizeof(T));
+	generator.loadMem32(RDX, RDI, REG(instr.rS()));
+	uint32_t fault = generateFastmemStore<T>();
+	generator.storeMem32(RDI, REG(instr.rA()), RSI);
+	generator.ret();
+	
+	generateSlowPath(reserved, jump, fault);
+	generator.pushReg64(RDI);
+	generator.loadMem32(RDX, RDI, REG(instr.rS()));
+	generator.callAbs(RAX, (uint64_t)storeMemory<T>);
+	generator.popReg64(RDI);
+	generator.testReg32(RAX, RAX);
+	generator.jumpIfNotZero(1);
+	generator.ret();
+	generator.addMemImm32(RDI, REG(instr.rA()), instr.d());
+	generator.ret();
+}
+
+// Translates the effective address in RSI to a host address in RAX. Jumps
+// to the slow path if the access crosses a page boundary. The translation
+// itself is not checked, invalid pages fault when they are accessed.
+uint32_t PPCCodeGenerator::generateFastmemAddress(uint32_t table, int size) {
+	uint32_t jump = 0;
+	generator.movReg32(RAX, RSI);
+	generator.andImm32(RAX, 0xFFF);
+	if (size > 1) {
+		generator.compareImm32(RAX, 0x1000 - size);
+		jump = generator.tell();
+		generator.jumpIfAbove32(0);
+	}
+	generator.movReg32(RDX, RSI);
+	generator.shrImm32(RDX, 12);
+	generator.loadMem64(RCX, RDI, table);
+	generator.loadIndex64(RCX, RCX, RDX);
+	generator.addRegReg64(RAX, RCX);
+	return jump;
+}
+
+template <class T>
+void PPCCodeGenerator::generateFastmemLoad() {
+	if (sizeof(T) == 1) {
+		generator.loadMem8(RAX, RAX, 0);
+	}
+	else if (sizeof(T) == 2) {
+		generator.loadMem16(RAX, RAX, 0);
+		generator.swap16(RAX);
+		if (std::is_signed<T>::value) {
+			generator.signExtend16(RAX);
+		}
+	}
+	else {
+		generator.loadMem32(RAX, RAX, 0);
+		generator.swap32(RAX);
+	}
+}
+
+// Stores RDX at the address in RAX and returns the offset of the store
+template <class T>
+uint32_t PPCCodeGenerator::generateFastmemStore() {
+	if (sizeof(T) == 1) {
+		uint32_t fault = generator.tell();
+		generator.storeMem8(RAX, 0, RDX);
+		return fault;
+	}
+	if (sizeof(T) == 2) {
+		generator.swap16(RDX);
+		uint32_t fault = generator.tell();
+		generator.storeMem16(RAX, 0, RDX);
+		return fault;
+	}
+	generator.swap32(RDX);
+	uint32_t fault = generator.tell();
+	generator.storeMem32(RAX, 0, RDX);
+	return fault;
+}
+
+// Patches the jumps to the slow path, which starts at the current position
+void PPCCodeGenerator::generateSlowPath(uint32_t reserved, uint32_t jump, uint32_t fault) {
+	uint32_t slow = generator.tell();
+	if (reserved) {
+		generator.seek(reserved);
+		generator.jumpIfEqual32(slow - (reserved + 6));
+	}
+	if (jump) {
+		generator.seek(jump);
+		generator.jumpIfAbove32(slow - (jump + 6));
+	}
+	generator.seek(slow);
+	addFaultSite(fault, slow);
+}
+
 void PPCCodeGenerator::generateConditionCheck(PPCInstruction instr) {
 	int bo = instr.bo();
 	if (!(bo & 4)) {
@@ -405,9 +655,11 @@ void PPCCodeGenerator::generateB(PPCInstruction instr) {
 	}
 	if (instr.aa()) {
 		generator.storeMemImm32(RDI, PC, instr.li());
+		branchAbs(instr.li());
 	}
 	else {
 		generator.addMemImm32(RDI, PC, instr.li() - 4);
+		branch(instr.li());
 	}
 	generator.ret();
 }
@@ -421,10 +673,51 @@ void PPCCodeGenerator::generateBc(PPCInstruction instr) {
 	generateConditionCheck(instr);
 	if (instr.aa()) {
 		generator.storeMemImm32(RDI, PC, instr.bd());
+		branchAbs(instr.bd());
 	}
 	else {
 		generator.addMemImm32(RDI, PC, instr.bd() - 4);
+		branch(instr.bd());
+	}
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateCompare(PPCInstruction instr, bool logical, bool immediate) {
+	generator.loadMem32(RAX, RDI, REG(instr.rA()));
+	if (immediate) {
+		generator.compareImm32(RAX, logical ? instr.uimm() : instr.simm());
 	}
+	else {
+		generator.compareRegMem32(RAX, RDI, REG(instr.rB()));
+	}
+	generateConditionUpdate(instr.crfD(), logical ? Below : Less);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateCrLogic(PPCInstruction instr, LogicOp op) {
+	uint32_t bit = 1 << (31 - instr.crbD());
+	
+	generator.loadMem32(RAX, RDI, CR);
+	generator.movReg32(RDX, RAX);
+	generateBitLogic(instr, op);
+	generator.andMemImm32(RDI, CR, ~bit);
+	generator.orMemReg32(RDI, CR, RAX);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateMfcr(PPCInstruction instr) {
+	generator.loadMem32(RAX, RDI, CR);
+	generator.storeMem32(RDI, REG(instr.rD()), RAX);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateMtcrf(PPCInstruction instr) {
+	uint32_t mask = crmask(instr.crm());
+	
+	generator.loadMem32(RAX, RDI, REG(instr.rS()));
+	generator.andImm32(RAX, mask);
+	generator.andMemImm32(RDI, CR, ~mask);
+	generator.orMemReg32(RDI, CR, RAX);
 	generator.ret();
 }
 
@@ -578,7 +871,7 @@ void PPCCodeGenerator::generateLfsx(PPCInstruction instr) {
 		generator.loadMem32(RSI, RDI, REG(instr.rB()));
 	}
 	generator.lea64(RDX, RDI, FPR_PS0(instr.rD()));
-	generator.jumpAbs(RAX, (uint64_t)loadMemory<float>);
+	generator.jumpAbs(RAX, (uint64_t)loadMemory<uint32_t>);
 }
 
 void PPCCodeGenerator::generateLfdx(PPCInstruction instr) {
@@ -590,7 +883,7 @@ void PPCCodeGenerator::generateLfdx(PPCInstruction instr) {
 		generator.loadMem32(RSI, RDI, REG(instr.rB()));
 	}
 	generator.lea64(RDX, RDI, FPR_DBL(instr.rD()));
-	generator.jumpAbs(RAX, (uint64_t)loadMemory<double>);
+	generator.jumpAbs(RAX, (uint64_t)loadLong);
 }
 
 void PPCCodeGenerator::generateStfsx(PPCInstruction instr) {
@@ -602,7 +895,7 @@ void PPCCodeGenerator::generateStfsx(PPCInstruction instr) {
 		generator.loadMem32(RSI, RDI, REG(instr.rB()));
 	}
 	generator.loadMem32(RDX, RDI, FPR_PS0(instr.rS()));
-	generator.jumpAbs(RAX, (uint64_t)storeMemory<float>);
+	generator.jumpAbs(RAX, (uint64_t)storeMemory<uint32_t>);
 }
 
 void PPCCodeGenerator::generateStfdx(PPCInstruction instr) {
@@ -629,31 +922,500 @@ void PPCCodeGenerator::generateStfiwx(PPCInstruction instr) {
 	generator.jumpAbs(RAX, (uint64_t)storeMemory<uint32_t>);
 }
 
+// Single precision operations only use ps0 and packed operations use
+// both ps0 and ps1. Because ps1 comes first in memory, ps0 is the second
+// lane of a packed register.
+void PPCCodeGenerator::loadFloat(FloatType type, XMMRegister reg, int index) {
+	if (type == Single) {
+		generator.loadSingle(reg, RDI, FPR_PS0(index));
+	}
+	else {
+		generator.loadDouble(reg, RDI, FPR_DBL(index));
+	}
+}
+
+void PPCCodeGenerator::storeFloat(FloatType type, int index, XMMRegister reg) {
+	if (type == Single) {
+		generator.storeSingle(RDI, FPR_PS0(index), reg);
+	}
+	else {
+		generator.storeDouble(RDI, FPR_DBL(index), reg);
+	}
+}
+
+void PPCCodeGenerator::loadSignMask(FloatType type, XMMRegister reg, bool invert) {
+	uint64_t mask = type == Double ? 0x8000000000000000 : 0x8000000080000000;
+	generator.movImm64(RAX, invert ? ~mask : mask);
+	generator.movRegToXMM64(reg, RAX);
+}
+
+void PPCCodeGenerator::generateFloatOp(FloatType type, FloatOp op, XMMRegister reg, XMMRegister other) {
+	typedef void (X86CodeGenerator::*Func)(XMMRegister, XMMRegister);
+	static const Func funcs[3][4] = {
+		{&X86CodeGenerator::addSingle, &X86CodeGenerator::subSingle, &X86CodeGenerator::mulSingle, &X86CodeGenerator::divSingle},
+		{&X86CodeGenerator::addDouble, &X86CodeGenerator::subDouble, &X86CodeGenerator::mulDouble, &X86CodeGenerator::divDouble},
+		{&X86CodeGenerator::addPacked, &X86CodeGenerator::subPacked, &X86CodeGenerator::mulPacked, &X86CodeGenerator::divPacked}
+	};
+	(generator.*funcs[type][op])(reg, other);
+}
+
+// Multiplications use C instead of B. The lane of C can be selected for
+// ps_muls0 and ps_muls1.
+void PPCCodeGenerator::generateFloatArith(PPCInstruction instr, FloatType type, FloatOp op, int lane) {
+	loadFloat(type, XMM0, instr.rA());
+	loadFloat(type, XMM1, op == Mul ? instr.rC() : instr.rB());
+	if (lane >= 0) {
+		generator.shufflePacked(XMM1, XMM1, lane ? 0x00 : 0x55);
+	}
+	generateFloatOp(type, op, XMM0, XMM1);
+	storeFloat(type, instr.rD(), XMM0);
+	generator.ret();
+}
+
+// Calculates A * C + B or A * C - B, with separate rounding steps
+void PPCCodeGenerator::generateFloatMulAdd(PPCInstruction instr, FloatType type, FloatOp op, bool negate, int lane) {
+	loadFloat(type, XMM0, instr.rA());
+	loadFloat(type, XMM1, instr.rC());
+	if (lane >= 0) {
+		generator.shufflePacked(XMM1, XMM1, lane ? 0x00 : 0x55);
+	}
+	generateFloatOp(type, Mul, XMM0, XMM1);
+	loadFloat(type, XMM1, instr.rB());
+	generateFloatOp(type, op, XMM0, XMM1);
+	if (negate) {
+		loadSignMask(type, XMM1, false);
+		generator.xorPacked(XMM0, XMM1);
+	}
+	storeFloat(type, instr.rD(), XMM0);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateFloatSign(PPCInstruction instr, FloatType type, SignOp op) {
+	loadFloat(type, XMM0, instr.rB());
+	loadSignMask(type, XMM1, op == Abs);
+	if (op == Negate) generator.xorPacked(XMM0, XMM1);
+	else if (op == Abs) generator.andPacked(XMM0, XMM1);
+	else {
+		generator.orPacked(XMM0, XMM1);
+	}
+	storeFloat(type, instr.rD(), XMM0);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateFloatMove(PPCInstruction instr, FloatType type) {
+	loadFloat(type, XMM0, instr.rB());
+	storeFloat(type, instr.rD(), XMM0);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateFres(PPCInstruction instr) {
+	generator.movImm32(RAX, 0x3F800000); // 1.0
+	generator.movRegToXMM32(XMM0, RAX);
+	generator.loadSingle(XMM1, RDI, FPR_PS0(instr.rB()));
+	generator.divSingle(XMM0, XMM1);
+	generator.storeSingle(RDI, FPR_PS0(instr.rD()), XMM0);
+	generator.storeSingle(RDI, FPR_PS1(instr.rD()), XMM0);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateFrsp(PPCInstruction instr) {
+	generator.loadDouble(XMM0, RDI, FPR_DBL(instr.rB()));
+	generator.convertDoubleToSingle(XMM0, XMM0);
+	generator.storeSingle(RDI, FPR_PS0(instr.rD()), XMM0);
+	generator.ret();
+}
+
+void PPCCodeGenerator::generateFctiwz(PPCInstruction instr) {
+	generator.loadSingle(XMM0, RDI, FPR_PS0(instr.rB()));
+	generator.truncateSingleToInt32(RAX, XMM0);
+	generator.storeMem32(RDI, FPR_IW1(instr.rD()), RAX);
+	generator.ret();
+}
+
+// ps_merge: ps0 comes from A and ps1 comes from B
+void PPCCodeGenerator::generatePsMerge(PPCInstruction instr, bool a, bool b) {
+	generator.loadMem32(RAX, RDI, a ? FPR_PS1(instr.rA()) : FPR_PS0(instr.rA()));
+	generator.loadMem32(RDX, RDI, b ? FPR_PS1(instr.rB()) : FPR_PS0(instr.rB()));
+	generator.storeMem32(RDI, FPR_PS0(instr.rD()), RAX);
+	generator.storeMem32(RDI, FPR_PS1(instr.rD()), RDX);
+	generator.ret();
+}
+
+// ps_sum: A.ps0 + B.ps1 goes into the selected lane, the other lane is copied from C
+void PPCCodeGenerator::generatePsSum(PPCInstruction instr, bool lane) {
+	generator.loadSingle(XMM0, RDI, FPR_PS0(instr.rA()));
+	generator.loadSingle(XMM1, RDI, FPR_PS1(instr.rB()));
+	generator.addSingle(XMM0, XMM1);
+	if (lane) {
+		generator.loadMem32(RAX, RDI, FPR_PS0(instr.rC()));
+		generator.storeSingle(RDI, FPR_PS1(instr.rD()), XMM0);
+		generator.storeMem32(RDI, FPR_PS0(instr.rD()), RAX);
+	}
+	else {
+		generator.loadMem32(RAX, RDI, FPR_PS1(instr.rC()));
+		generator.storeSingle(RDI, FPR_PS0(instr.rD()), XMM0);
+		generator.storeMem32(RDI, FPR_PS1(instr.rD()), RAX);
+	}
+	generator.ret();
+}
+
+// Loads of unquantized floats are done inline. Quantized types, which
+// are selected by bit 2 of the type field in the GQR, go through psqLoad.
+void PPCCodeGenerator::generatePsqLoad(PPCInstruction instr, bool update) {
+	if (instr.rA() || update) {
+		generator.loadMem32(RSI, RDI, REG(instr.rA()));
+		generator.addRegImm32(RSI, instr.ps_d());
+	}
+	else {
+		generator.movImm32(RSI, instr.ps_d());
+	}
+	
+	generator.bitTestMem32(RDI, SPR(GQR0) + instr.ps_i() * 4, 18);
+	uint32_t quantized = generator.tell();
+	generator.jumpIfCarry32(0);
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_READ, instr.ps_w() ? 4 : 8);
+	uint32_t fault = generator.tell();
+	if (instr.ps_w()) {
+		generator.loadMem32(RAX, RAX, 0);
+		generator.swap32(RAX);
+		generator.storeMem32(RDI, FPR_PS0(instr.rD()), RAX);
+		generator.storeMemImm32(RDI, FPR_PS1(instr.rD()), 0x3F800000); // 1.0
+	}
+	else {
+		generator.loadMem64(RAX, RAX, 0);
+		generator.swap64(RAX);
+		generator.storeMem64(RDI, FPR_DBL(instr.rD()), RAX);
+	}
+	if (update) {
+		generator.storeMem32(RDI, REG(instr.rA()), RSI);
+	}
+	generator.ret();
+	
+	uint32_t slow = generator.tell();
+	generator.seek(quantized);
+	generator.jumpIfCarry32(slow - (quantized + 6));
+	generator.seek(slow);
+	
+	generateSlowPath(0, jump, fault);
+	generator.movImm32(RDX, instr.value);
+	if (update) {
+		generator.pushReg64(RDI);
+		generator.callAbs(RAX, (uint64_t)loadPaired);
+		generator.popReg64(RDI);
+		generator.testReg32(RAX, RAX);
+		generator.jumpIfNotZero(1);
+		generator.ret();
+		generator.addMemImm32(RDI, REG(instr.rA()), instr.ps_d());
+		generator.ret();
+	}
+	else {
+		generator.jumpAbs(RAX, (uint64_t)loadPaired);
+	}
+}
+
+void PPCCodeGenerator::generatePsqStore(PPCInstruction instr, bool update) {
+	if (instr.rA() || update) {
+		generator.loadMem32(RSI, RDI, REG(instr.rA()));
+		generator.addRegImm32(RSI, instr.ps_d());
+	}
+	else {
+		generator.movImm32(RSI, instr.ps_d());
+	}
+	
+	generator.loadMem64(RAX, RDI, RESERVATION);
+	generator.compareMemReg32(RAX, offsetof(PPCReservation, addr), RSI);
+	uint32_t reserved = generator.tell();
+	generator.jumpIfEqual32(0);
+	
+	generator.bitTestMem32(RDI, SPR(GQR0) + instr.ps_i() * 4, 2);
+	uint32_t quantized = generator.tell();
+	generator.jumpIfCarry32(0);
+	
+	uint32_t jump = generateFastmemAddress(FASTMEM_WRITE, instr.ps_w() ? 4 : 8);
+	uint32_t fault;
+	if (instr.ps_w()) {
+		generator.loadMem32(RDX, RDI, FPR_PS0(instr.rS()));
+		generator.swap32(RDX);
+		fault = generator.tell();
+		generator.storeMem32(RAX, 0, RDX);
+	}
+	else {
+		generator.loadMem64(RDX, RDI, FPR_DBL(instr.rS()));
+		generator.swap64(RDX);
+		fault = generator.tell();
+		generator.storeMem64(RAX, 0, RDX);
+	}
+	if (update) {
+		generator.storeMem32(RDI, REG(instr.rA()), RSI);
+	}
+	generator.ret();
+	
+	uint32_t slow = generator.tell();
+	generator.seek(quantized);
+	generator.jumpIfCarry32(slow - (quantized + 6));
+	generator.seek(slow);
+	
+	generateSlowPath(reserved, jump, fault);
+	generator.movImm32(RDX, instr.value);
+	if (update) {
+		generator.pushReg64(RDI);
+		generator.callAbs(RAX, (uint64_t)storePaired);
+		generator.popReg64(RDI);
+		generator.testReg32(RAX, RAX);
+		generator.jumpIfNotZero(1);
+		generator.ret();
+		generator.addMemImm32(RDI, REG(instr.rA()), instr.ps_d());
+		generator.ret();
+	}
+	else {
+		generator.jumpAbs(RAX, (uint64_t)storePaired);
+	}
+}
+
+// Moves bits A and B of the condition register (in RAX and RDX) to bit D
+// and combines them. The result is left in RAX, with all other bits cleared.
+void PPCCodeGenerator::generateBitLogic(PPCInstruction instr, LogicOp op) {
+	int shiftA = (instr.crbA() - instr.crbD()) & 31;
+	int shiftB = (instr.crbB() - instr.crbD()) & 31;
+	if (shiftA) generator.rolImm32(RAX, shiftA);
+	if (shiftB) generator.rolImm32(RDX, shiftB);
+	
+	if (op == AndC || op == OrC) generator.notReg32(RDX);
+	
+	if (op == And || op == AndC || op == Nand) generator.andReg32(RAX, RDX);
+	else if (op == Or || op == OrC || op == Nor) generator.orReg32(RAX, RDX);
+	else {
+		generator.xorReg32(RAX, RDX);
+	}
+	
+	if (op == Nand || op == Nor || op == Eqv) generator.notReg32(RAX);
+	
+	generator.andImm32(RAX, 1 << (31 - instr.crbD()));
+}
+
+// Sets the LT, GT and EQ bits of a condition register field based on the
+// host flags. SO is left alone. Clobbers RAX and RDX.
+void PPCCodeGenerator::generateConditionUpdate(int field, Condition less) {
+	generator.movImm32(RAX, PPCCore::GT >> (4 * field));
+	generator.movImm32(RDX, PPCCore::LT >> (4 * field));
+	generator.moveIf32(less, RAX, RDX);
+	generator.movImm32(RDX, PPCCore::EQ >> (4 * field));
+	generator.moveIf32(Equal, RAX, RDX);
+	
+	generator.andMemImm32(RDI, CR, ~(0xE0000000 >> (4 * field)));
+	generator.orMemReg32(RDI, CR, RAX);
+}
+
 void PPCCodeGenerator::generateFlagsUpdate(bool rc) {
 	if (rc) {
-		generator.jumpIfSign(40);
-		generator.jumpIfZero(19); // 2 bytes
-		
-		// ~N & ~Z
-		generator.andMemImm32(RDI, CR, 0x5FFFFFFF); // 10 bytes
-		generator.bitTestSetMem32(RDI, CR, 30); // 8 bytes
-		generator.ret(); // 1 byte
-		
-		// ~N & Z
-		generator.andMemImm32(RDI, CR, 0x3FFFFFFF); // 10 bytes
-		generator.bitTestSetMem32(RDI, CR, 29); // 8 bytes
-		generator.ret(); // 1 byte
-		
-		generator.jumpIfZero(19); // 2 bytes
-		
-		// N & ~Z
-		generator.andMemImm32(RDI, CR, 0x9FFFFFFF);
-		generator.bitTestSetMem32(RDI, CR, 31);
-		generator.ret();
-		
-		// N & Z
-		generator.orMemImm32(RDI, CR, 0xA0000000);
-		generator.bitTestResetMem32(RDI, CR, 30);
+		generateConditionUpdate(0, Sign);
 	}
 	generator.ret();
 }
+
+void PPCCodeGenerator::inlineAddi(PPCInstruction instr) {
+	if (instr.rA()) {
+		generator.movReg32(RAX, readReg(REG(instr.rA())));
+		generator.addRegImm32(RAX, instr.simm());
+	}
+	else {
+		generator.movImm32(RAX, instr.simm());
+	}
+	generator.movReg32(writeReg(REG(instr.rD())), RAX);
+}
+
+void PPCCodeGenerator::inlineAddis(PPCInstruction instr) {
+	if (instr.rA()) {
+		generator.movReg32(RAX, readReg(REG(instr.rA())));
+		generator.addRegImm32(RAX, instr.simm() << 16);
+	}
+	else {
+		generator.movImm32(RAX, instr.simm() << 16);
+	}
+	generator.movReg32(writeReg(REG(instr.rD())), RAX);
+}
+
+void PPCCodeGenerator::inlineRlwimi(PPCInstruction instr) {
+	uint32_t mask = genmask(instr.mb(), instr.me());
+	
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.rolImm32(RAX, instr.sh());
+	generator.andImm32(RAX, mask);
+	generator.movReg32(RDX, readReg(REG(instr.rA())));
+	generator.andImm32(RDX, ~mask);
+	generator.orReg32(RAX, RDX);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+	inlineFlagsUpdate(instr.rc());
+}
+
+void PPCCodeGenerator::inlineRlwinm(PPCInstruction instr) {
+	uint32_t mask = genmask(instr.mb(), instr.me());
+	
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.rolImm32(RAX, instr.sh());
+	generator.andImm32(RAX, mask);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+	inlineFlagsUpdate(instr.rc());
+}
+
+void PPCCodeGenerator::inlineOri(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.orImm32(RAX, instr.uimm());
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+}
+
+void PPCCodeGenerator::inlineOris(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.orImm32(RAX, instr.uimm() << 16);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+}
+
+void PPCCodeGenerator::inlineXori(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.xorImm32(RAX, instr.uimm());
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+}
+
+void PPCCodeGenerator::inlineXoris(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.xorImm32(RAX, instr.uimm() << 16);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+}
+
+void PPCCodeGenerator::inlineAndi(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.andImm32(RAX, instr.uimm());
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+	inlineFlagsUpdate(true);
+}
+
+void PPCCodeGenerator::inlineAndis(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.andImm32(RAX, instr.uimm() << 16);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+	inlineFlagsUpdate(true);
+}
+
+void PPCCodeGenerator::inlineAdd(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rA())));
+	generator.movReg32(RDX, readReg(REG(instr.rB())));
+	generator.addRegReg32(RAX, RDX);
+	generator.movReg32(writeReg(REG(instr.rD())), RAX);
+	inlineFlagsUpdate(instr.rc());
+}
+
+void PPCCodeGenerator::inlineOr(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.movReg32(RDX, readReg(REG(instr.rB())));
+	generator.orReg32(RAX, RDX);
+	generator.movReg32(writeReg(REG(instr.rA())), RAX);
+	inlineFlagsUpdate(instr.rc());
+}
+
+void PPCCodeGenerator::inlineCompare(PPCInstruction instr, bool logical, bool immediate) {
+	inlineConditionClear(instr.crfD());
+	
+	generator.movReg32(RAX, readReg(REG(instr.rA())));
+	if (immediate) {
+		generator.compareImm32(RAX, logical ? instr.uimm() : instr.simm());
+	}
+	else {
+		generator.movReg32(RDX, readReg(REG(instr.rB())));
+		generator.compareReg32(RAX, RDX);
+	}
+	inlineConditionUpdate(instr.crfD(), logical);
+}
+
+void PPCCodeGenerator::inlineBc(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(CR));
+	generator.bitTestReg32(RAX, 31 - instr.bi());
+	jumpToBranch(inlineIndex, instr.bo() & 8 ? Below : NotBelow);
+	
+	// A fused comparison has already decided the branch
+	if (fusedBranch) {
+		uint32_t end = generator.tell();
+		generator.seek(fusedBranch);
+		generator.jumpRel32(end - (fusedBranch + 5));
+		generator.seek(end);
+		fusedBranch = 0;
+	}
+}
+
+void PPCCodeGenerator::inlineCrLogic(PPCInstruction instr, LogicOp op) {
+	uint32_t bit = 1 << (31 - instr.crbD());
+	
+	Register cr = readReg(CR);
+	generator.movReg32(RAX, cr);
+	generator.movReg32(RDX, cr);
+	generateBitLogic(instr, op);
+	generator.movReg32(RDX, cr);
+	generator.andImm32(RDX, ~bit);
+	generator.orReg32(RAX, RDX);
+	generator.movReg32(writeReg(CR), RAX);
+}
+
+void PPCCodeGenerator::inlineMfcr(PPCInstruction instr) {
+	generator.movReg32(RAX, readReg(CR));
+	generator.movReg32(writeReg(REG(instr.rD())), RAX);
+}
+
+void PPCCodeGenerator::inlineMtcrf(PPCInstruction instr) {
+	uint32_t mask = crmask(instr.crm());
+	
+	generator.movReg32(RAX, readReg(REG(instr.rS())));
+	generator.andImm32(RAX, mask);
+	generator.movReg32(RDX, readReg(CR));
+	generator.andImm32(RDX, ~mask);
+	generator.orReg32(RAX, RDX);
+	generator.movReg32(writeReg(CR), RAX);
+}
+
+// The bits of the field are cleared before the comparison, so that they
+// can be set afterwards without changing the host flags. Clobbers RDX.
+void PPCCodeGenerator::inlineConditionClear(int field) {
+	generator.movReg32(RDX, readReg(CR));
+	generator.andImm32(RDX, ~(0xE0000000 >> (4 * field)));
+	generator.movReg32(writeReg(CR), RDX);
+}
+
+void PPCCodeGenerator::inlineConditionUpdate(int field, bool logical) {
+	Condition less = logical ? Below : Less;
+	Condition greater = logical ? Above : Greater;
+	
+	generator.movImm32(RAX, PPCCore::GT >> (4 * field));
+	generator.movImm32(RDX, PPCCore::LT >> (4 * field));
+	generator.moveIf32(less, RAX, RDX);
+	generator.movImm32(RDX, PPCCore::EQ >> (4 * field));
+	generator.moveIf32(Equal, RAX, RDX);
+	
+	Register cr = writeReg(CR);
+	generator.leaIndex32(cr, cr, RAX);
+	
+	// If the next instruction branches on this field, the host flags
+	// decide the branch and the bit test of the branch is skipped
+	if (inlineIndex + 1 < (int)values.size()) {
+		PPCInstruction next;
+		next.value = values[inlineIndex + 1];
+		
+		int bit = next.bi() % 4;
+		if (next.opcode() == 16 && isConditionalBranch(next) && next.bi() / 4 == field && bit != 3) {
+			Condition cond = bit == 0 ? less : bit == 1 ? greater : Equal;
+			if (!(next.bo() & 8)) {
+				cond = (Condition)(cond ^ 1);
+			}
+			jumpToBranch(inlineIndex + 1, cond);
+			
+			fusedBranch = generator.tell();
+			generator.jumpRel32(0); // Patched by inlineBc
+		}
+	}
+}
+
+void PPCCodeGenerator::inlineFlagsUpdate(bool rc) {
+	if (rc) {
+		inlineConditionClear(0);
+		generator.compareImm32(RAX, 0);
+		inlineConditionUpdate(0, false);
+	}
+}
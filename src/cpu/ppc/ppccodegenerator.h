@@ -2,34 +2,49 @@
 #pragma once
 
 #include "cpu/ppc/ppcinstruction.h"
-#include "cpu/x86codegenerator.h"
+#include "cpu/jitgenerator.h"
 #include "physicalmemory.h"
 #include "config.h"
 
+#include <vector>
+#include <type_traits>
 #include <cstdint>
 
 
 class PPCProcessor;
 
 
-class PPCCodeGenerator {
+class PPCCodeGenerator : public JITGenerator {
 public:
 	PPCCodeGenerator();
 	
-	char *get();
-	size_t size();
-	
 	void generate(uint32_t value);
 	
 private:
+	enum FloatType { Single, Double, Packed };
+	enum FloatOp { Add, Sub, Mul, Div };
+	enum SignOp { Negate, Abs, NegateAbs };
+	enum LogicOp { And, AndC, Or, OrC, Xor, Nand, Nor, Eqv };
+	
+	bool generateInline(int index);
+	
 	void generateInstr(PPCInstruction instr);
 	void generateError(PPCInstruction instr);
 	void generateUnimplemented(PPCInstruction instr);
+	void generateContextSync(PPCInstruction instr);
+	
+	void generateIsync();
+	void generateMtspr(PPCInstruction instr);
 	
 	void generateConditionCheck(PPCInstruction instr);
 	void generateBc(PPCInstruction instr);
 	void generateB(PPCInstruction instr);
 	
+	void generateCompare(PPCInstruction instr, bool logical, bool immediate);
+	void generateCrLogic(PPCInstruction instr, LogicOp op);
+	void generateMfcr(PPCInstruction instr);
+	void generateMtcrf(PPCInstruction instr);
+	
 	void generateAddi(PPCInstruction instr);
 	void generateAddis(PPCInstruction instr);
 	void generateRlwimi(PPCInstruction instr);
@@ -55,16 +70,67 @@ private:
 	
 	void generateStfiwx(PPCInstruction instr);
 	
+	void generateFloatArith(PPCInstruction instr, FloatType type, FloatOp op, int lane = -1);
+	void generateFloatMulAdd(PPCInstruction instr, FloatType type, FloatOp op, bool negate, int lane = -1);
+	void generateFloatSign(PPCInstruction instr, FloatType type, SignOp op);
+	void generateFloatMove(PPCInstruction instr, FloatType type);
+	void generateFres(PPCInstruction instr);
+	void generateFrsp(PPCInstruction instr);
+	void generateFctiwz(PPCInstruction instr);
+	
+	void generatePsMerge(PPCInstruction instr, bool a, bool b);
+	void generatePsSum(PPCInstruction instr, bool lane);
+	void generatePsqLoad(PPCInstruction instr, bool update);
+	void generatePsqStore(PPCInstruction instr, bool update);
+	
 	template <class T> void generateLoad(PPCInstruction instr);
 	template <class T> void generateLoadu(PPCInstruction instr);
+	template <class T> void generateStore(PPCInstruction instr);
+	template <class T> void generateStoreu(PPCInstruction instr);
+	
+	uint32_t generateFastmemAddress(uint32_t table, int size);
+	template <class T> void generateFastmemLoad();
+	template <class T> uint32_t generateFastmemStore();
+	void generateSlowPath(uint32_t reserved, uint32_t jump, uint32_t fault);
 	
+	void loadFloat(FloatType type, XMMRegister reg, int index);
+	void storeFloat(FloatType type, int index, XMMRegister reg);
+	void loadSignMask(FloatType type, XMMRegister reg, bool invert);
+	void generateFloatOp(FloatType type, FloatOp op, XMMRegister reg, XMMRegister other);
+	
+	void generateBitLogic(PPCInstruction instr, LogicOp op);
+	void generateConditionUpdate(int field, Condition less);
 	void generateFlagsUpdate(bool rc);
 	
+	void inlineAddi(PPCInstruction instr);
+	void inlineAddis(PPCInstruction instr);
+	void inlineRlwimi(PPCInstruction instr);
+	void inlineRlwinm(PPCInstruction instr);
+	void inlineOri(PPCInstruction instr);
+	void inlineOris(PPCInstruction instr);
+	void inlineXori(PPCInstruction instr);
+	void inlineXoris(PPCInstruction instr);
+	void inlineAndi(PPCInstruction instr);
+	void inlineAndis(PPCInstruction instr);
+	void inlineAdd(PPCInstruction instr);
+	void inlineOr(PPCInstruction instr);
+	
+	void inlineCompare(PPCInstruction instr, bool logical, bool immediate);
+	void inlineBc(PPCInstruction instr);
+	void inlineCrLogic(PPCInstruction instr, LogicOp op);
+	void inlineMfcr(PPCInstruction instr);
+	void inlineMtcrf(PPCInstruction instr);
+	
+	void inlineConditionClear(int field);
+	void inlineConditionUpdate(int field, bool logical);
+	void inlineFlagsUpdate(bool rc);
+	
 	#if METRICS
 	void generateMetricsUpdate(PPCInstruction instr);
 	#endif
-
-	X86CodeGenerator generator;
-	uint32_t offsets[0x400];
-	int index;
+	
+	std::vector<uint32_t> values;
+	
+	int inlineIndex;
+	uint32_t fusedBranch;
 };
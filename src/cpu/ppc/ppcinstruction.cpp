@@ -4,6 +4,8 @@
 
 #include "common/exceptions.h"
 
+#include <limits>
+#include <type_traits>
 #include <cmath>
 
 
@@ -36,7 +38,9 @@ bool checkCondition(PPCInstruction *instr, PPCProcessor *cpu) {
 	int bo = instr->bo();
 	if (!(bo & 4)) {
 		cpu->core.sprs[PPCCore::CTR]--;
-		if ((bo & 2) && cpu->core.sprs[PPCCore::CTR] != 0) return false;
+		if (bo & 2) {
+			if (cpu->core.sprs[PPCCore::CTR] != 0) return false;
+		}
 		else if (cpu->core.sprs[PPCCore::CTR] == 0) return false;
 	}
 	if (bo & 0x10) return true;
@@ -67,10 +71,14 @@ void PPCInstr_mfsr(PPCInstruction *instr, PPCProcessor *cpu) {
 
 void PPCInstr_mtsr(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.sr[instr->sr()] = cpu->core.regs[instr->rS()];
+	cpu->invalidateSegments();
 }
 
 void PPCInstr_tlbie(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->mmu.cache.invalidate();
+	cpu->mmu.cache.invalidate(cpu->core.regs[instr->rB()]);
+	cpu->mmu.invalidatePageTable();
+	cpu->jit.unlink();
+	cpu->fastmem.invalidate();
 }
 
 void PPCInstr_rfi(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -81,6 +89,9 @@ void PPCInstr_rfi(PPCInstruction *instr, PPCProcessor *cpu) {
 
 /********** CACHE AND SYNCHRONIZATION INSTRUCTIONS **********/
 
+// dcbst, dcbf, dcbi, sync, eieio and isync
+void PPCInstr_nop(PPCInstruction *instr, PPCProcessor *cpu) {}
+
 void PPCInstr_dcbz(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
 	uint32_t addr = (base + cpu->core.regs[instr->rB()]) & ~0x1F;
@@ -107,6 +118,16 @@ void PPCInstr_icbi(PPCInstruction *instr, PPCProcessor *cpu) {
 
 /********** NORMAL INSTRUCTIONS **********/
 
+void PPCInstr_addi(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	cpu->core.regs[instr->rD()] = base + instr->simm();
+}
+
+void PPCInstr_addis(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	cpu->core.regs[instr->rD()] = base + (instr->simm() << 16);
+}
+
 void PPCInstr_mulli(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.regs[instr->rD()] = cpu->core.regs[instr->rA()] * instr->simm();
 }
@@ -274,6 +295,57 @@ void PPCInstr_andc(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.regs[instr->rA()] = result;
 }
 
+void PPCInstr_ori(PPCInstruction *instr, PPCProcessor *cpu) {
+	cpu->core.regs[instr->rA()] = cpu->core.regs[instr->rS()] | instr->uimm();
+}
+
+void PPCInstr_oris(PPCInstruction *instr, PPCProcessor *cpu) {
+	cpu->core.regs[instr->rA()] = cpu->core.regs[instr->rS()] | (instr->uimm() << 16);
+}
+
+void PPCInstr_xori(PPCInstruction *instr, PPCProcessor *cpu) {
+	cpu->core.regs[instr->rA()] = cpu->core.regs[instr->rS()] ^ instr->uimm();
+}
+
+void PPCInstr_xoris(PPCInstruction *instr, PPCProcessor *cpu) {
+	cpu->core.regs[instr->rA()] = cpu->core.regs[instr->rS()] ^ (instr->uimm() << 16);
+}
+
+void PPCInstr_andi(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t result = cpu->core.regs[instr->rS()] & instr->uimm();
+	updateConditions(&cpu->core, result);
+	cpu->core.regs[instr->rA()] = result;
+}
+
+void PPCInstr_andis(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t result = cpu->core.regs[instr->rS()] & (instr->uimm() << 16);
+	updateConditions(&cpu->core, result);
+	cpu->core.regs[instr->rA()] = result;
+}
+
+void PPCInstr_rlwimi(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t mask = genmask(instr->mb(), instr->me());
+	uint32_t value = rotl(cpu->core.regs[instr->rS()], instr->sh());
+	uint32_t result = (value & mask) | (cpu->core.regs[instr->rA()] & ~mask);
+	if (instr->rc()) updateConditions(&cpu->core, result);
+	cpu->core.regs[instr->rA()] = result;
+}
+
+void PPCInstr_rlwinm(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t mask = genmask(instr->mb(), instr->me());
+	uint32_t result = rotl(cpu->core.regs[instr->rS()], instr->sh()) & mask;
+	if (instr->rc()) updateConditions(&cpu->core, result);
+	cpu->core.regs[instr->rA()] = result;
+}
+
+void PPCInstr_rlwnm(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t mask = genmask(instr->mb(), instr->me());
+	int bits = cpu->core.regs[instr->rB()] & 0x1F;
+	uint32_t result = rotl(cpu->core.regs[instr->rS()], bits) & mask;
+	if (instr->rc()) updateConditions(&cpu->core, result);
+	cpu->core.regs[instr->rA()] = result;
+}
+
 void PPCInstr_slw(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t bits = cpu->core.regs[instr->rB()] & 0x3F;
 	uint32_t result = 0;
@@ -408,50 +480,50 @@ void PPCInstr_cmp(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_crnor(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		!cpu->core.cr.get(1 << instr->crbA()) && !cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		!cpu->core.cr.get(0x80000000 >> instr->crbA()) && !cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_crandc(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) && !cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) && !cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_crxor(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) != cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) != cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_crnand(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		!cpu->core.cr.get(1 << instr->crbA()) || !cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		!cpu->core.cr.get(0x80000000 >> instr->crbA()) || !cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_crand(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) && cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) && cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_creqv(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) == cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) == cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_crorc(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) || !cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) || !cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
 void PPCInstr_cror(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.cr.set(1 << instr->crbD(),
-		cpu->core.cr.get(1 << instr->crbA()) || cpu->core.cr.get(1 << instr->crbB())
+	cpu->core.cr.set(0x80000000 >> instr->crbD(),
+		cpu->core.cr.get(0x80000000 >> instr->crbA()) || cpu->core.cr.get(0x80000000 >> instr->crbB())
 	);
 }
 
@@ -472,6 +544,32 @@ void PPCInstr_mtcrf(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.cr = (cpu->core.cr & ~mask) | value;
 }
 
+void PPCInstr_b(PPCInstruction *instr, PPCProcessor *cpu) {
+	if (instr->lk()) {
+		cpu->core.sprs[PPCCore::LR] = cpu->core.pc;
+	}
+	if (instr->aa()) {
+		cpu->core.pc = instr->li();
+	}
+	else {
+		cpu->core.pc += instr->li() - 4;
+	}
+}
+
+void PPCInstr_bc(PPCInstruction *instr, PPCProcessor *cpu) {
+	if (instr->lk()) {
+		cpu->core.sprs[PPCCore::LR] = cpu->core.pc;
+	}
+	if (checkCondition(instr, cpu)) {
+		if (instr->aa()) {
+			cpu->core.pc = instr->bd();
+		}
+		else {
+			cpu->core.pc += instr->bd() - 4;
+		}
+	}
+}
+
 void PPCInstr_bclr(PPCInstruction *instr, PPCProcessor *cpu) {
 	if (checkCondition(instr, cpu)) {
 		uint32_t target = cpu->core.sprs[PPCCore::LR];
@@ -511,6 +609,21 @@ void PPCInstr_mtspr(PPCInstruction *instr, PPCProcessor *cpu) {
 	PPCCore::SPR spr = convertSpr(instr->spr());
 	cpu->core.sprs[spr] = cpu->core.regs[instr->rS()];
 	
+	if (spr == PPCCore::SDR1 || (spr >= PPCCore::IBAT0U && spr < PPCCore::IBAT0U + 0x20)) {
+		if (spr == PPCCore::SDR1) {
+			cpu->mmu.invalidatePageTable();
+		}
+		else {
+			cpu->mmu.invalidateBAT();
+		}
+		cpu->mmu.cache.invalidate();
+		cpu->jit.unlink();
+		cpu->fastmem.invalidate();
+	}
+	else if (spr == PPCCore::WPAR || spr == PPCCore::HID2) {
+		cpu->fastmem.invalidate();
+	}
+	
 	if (spr == PPCCore::DMAL) {
 		uint32_t dmau = cpu->core.sprs[PPCCore::DMAU];
 		uint32_t dmal = cpu->core.sprs[PPCCore::DMAL];
@@ -532,6 +645,16 @@ void PPCInstr_sc(PPCInstruction *instr, PPCProcessor *cpu) {
 	return cpu->core.triggerException(PPCCore::SystemCall);
 }
 
+template <class T>
+void PPCInstr_load(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t addr = (instr->rA() ? cpu->core.regs[instr->rA()] : 0) + instr->d();
+	
+	T value;
+	if (cpu->read<T>(addr, &value)) {
+		cpu->core.regs[instr->rD()] = value;
+	}
+}
+
 template <class T>
 void PPCInstr_loadu(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t addr = cpu->core.regs[instr->rA()] + instr->d();
@@ -653,6 +776,22 @@ void PPCInstr_stswi(PPCInstruction *instr, PPCProcessor *cpu) {
 	}
 }
 
+void PPCInstr_lwbrx(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
+	
+	uint32_t value;
+	if (cpu->read<uint32_t>(addr, &value)) {
+		cpu->core.regs[instr->rD()] = __builtin_bswap32(value);
+	}
+}
+
+void PPCInstr_stwbrx(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
+	cpu->write<uint32_t>(addr, __builtin_bswap32(cpu->core.regs[instr->rS()]));
+}
+
 void PPCInstr_lwarx(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
 	uint32_t addr = base + cpu->core.regs[instr->rB()];
@@ -701,12 +840,14 @@ void PPCInstr_lfdu(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_lfsx(PPCInstruction *instr, PPCProcessor *cpu) {
-	uint32_t addr = cpu->core.regs[instr->rA()] + cpu->core.regs[instr->rB()];
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
 	cpu->read<float>(addr, &cpu->core.fprs[instr->rD()].ps0);
 }
 
 void PPCInstr_lfdx(PPCInstruction *instr, PPCProcessor *cpu) {
-	uint32_t addr = cpu->core.regs[instr->rA()] + cpu->core.regs[instr->rB()];
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
 	cpu->read<double>(addr, &cpu->core.fprs[instr->rD()].dbl);
 }
 
@@ -749,15 +890,23 @@ void PPCInstr_stfdu(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_stfsx(PPCInstruction *instr, PPCProcessor *cpu) {
-	uint32_t addr = cpu->core.regs[instr->rA()] + cpu->core.regs[instr->rB()];
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
 	cpu->write<float>(addr, cpu->core.fprs[instr->rS()].ps0);
 }
 
 void PPCInstr_stfdx(PPCInstruction *instr, PPCProcessor *cpu) {
-	uint32_t addr = cpu->core.regs[instr->rA()] + cpu->core.regs[instr->rB()];
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
 	cpu->write<double>(addr, cpu->core.fprs[instr->rS()].dbl);
 }
 
+void PPCInstr_stfiwx(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t base = instr->rA() ? cpu->core.regs[instr->rA()] : 0;
+	uint32_t addr = base + cpu->core.regs[instr->rB()];
+	cpu->write<uint32_t>(addr, cpu->core.fprs[instr->rS()].iw1);
+}
+
 void PPCInstr_stfsux(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t addr = cpu->core.regs[instr->rA()] + cpu->core.regs[instr->rB()];
 	if (cpu->write<float>(addr, cpu->core.fprs[instr->rS()].ps0)) {
@@ -915,42 +1064,91 @@ void PPCInstr_mtfsf(PPCInstruction *instr, PPCProcessor *cpu) {
 
 /********** PAIRED SINGLE INSTRUCTIONS **********/
 
-void psqLoad(PPCProcessor *cpu, uint32_t addr, int rD, int i, int w) {
+// The scale of a quantized value is a signed 6-bit exponent
+static int psqScale(uint32_t config) {
+	int scale = config & 0x3F;
+	if (scale & 0x20) {
+		scale -= 0x40;
+	}
+	return scale;
+}
+
+static int psqSize(int type) {
+	if (type == 4 || type == 6) return 1;
+	if (type == 5 || type == 7) return 2;
+	return 4;
+}
+
+template <class T>
+static bool psqDequantize(PPCProcessor *cpu, uint32_t addr, int scale, float *value) {
+	typename std::make_unsigned<T>::type data;
+	if (!cpu->read(addr, &data)) {
+		return false;
+	}
+	*value = ldexpf((T)data, -scale);
+	return true;
+}
+
+template <class T>
+static bool psqQuantize(PPCProcessor *cpu, uint32_t addr, int scale, float value) {
+	float result = ldexpf(value, scale);
+	
+	T data;
+	if (!(result > std::numeric_limits<T>::min())) data = std::numeric_limits<T>::min();
+	else if (result >= std::numeric_limits<T>::max()) data = std::numeric_limits<T>::max();
+	else data = (T)result;
+	
+	return cpu->write<typename std::make_unsigned<T>::type>(addr, data);
+}
+
+static bool psqRead(PPCProcessor *cpu, uint32_t addr, int type, int scale, float *value) {
+	if (type == 4) return psqDequantize<uint8_t>(cpu, addr, scale, value);
+	if (type == 5) return psqDequantize<uint16_t>(cpu, addr, scale, value);
+	if (type == 6) return psqDequantize<int8_t>(cpu, addr, scale, value);
+	if (type == 7) return psqDequantize<int16_t>(cpu, addr, scale, value);
+	return cpu->read<float>(addr, value);
+}
+
+static bool psqWrite(PPCProcessor *cpu, uint32_t addr, int type, int scale, float value) {
+	if (type == 4) return psqQuantize<uint8_t>(cpu, addr, scale, value);
+	if (type == 5) return psqQuantize<uint16_t>(cpu, addr, scale, value);
+	if (type == 6) return psqQuantize<int8_t>(cpu, addr, scale, value);
+	if (type == 7) return psqQuantize<int16_t>(cpu, addr, scale, value);
+	return cpu->write<float>(addr, value);
+}
+
+bool psqLoad(PPCProcessor *cpu, uint32_t addr, int rD, int i, int w) {
 	uint32_t config = cpu->core.sprs[PPCCore::GQR0 + i];
-	int scale = (config >> 24) & 0x3F;
+	int scale = psqScale(config >> 24);
 	int type = (config >> 16) & 7;
-	if (type & 4) { //Dequantize
-		runtime_error("Dequantization not supported");
-	}
 	
-	if (w) {
-		if (cpu->read<float>(addr, &cpu->core.fprs[i].ps0)) {
-			cpu->core.fprs[i].ps1 = 1.0;
-		}
+	float ps0, ps1 = 1.0;
+	if (!psqRead(cpu, addr, type, scale, &ps0)) {
+		return false;
 	}
-	else {
-		if (cpu->read<float>(addr, &cpu->core.fprs[i].ps0)) {
-			cpu->read<float>(addr+4, &cpu->core.fprs[i].ps1);
+	if (!w) {
+		if (!psqRead(cpu, addr + psqSize(type), type, scale, &ps1)) {
+			return false;
 		}
 	}
+	
+	cpu->core.fprs[rD].ps0 = ps0;
+	cpu->core.fprs[rD].ps1 = ps1;
+	return true;
 }
 
-void psqStore(PPCProcessor *cpu, uint32_t addr, int rS, int i, int w) {
+bool psqStore(PPCProcessor *cpu, uint32_t addr, int rS, int i, int w) {
 	uint32_t config = cpu->core.sprs[PPCCore::GQR0 + i];
-	int scale = (config >> 8) & 0x3F;
+	int scale = psqScale(config >> 8);
 	int type = config & 7;
-	if (type & 4) { //Quantize
-		runtime_error("Quantization not supported");
-	}
 	
-	if (w) {
-		cpu->write<float>(addr, cpu->core.fprs[i].ps0);
+	if (!psqWrite(cpu, addr, type, scale, cpu->core.fprs[rS].ps0)) {
+		return false;
 	}
-	else {
-		if (cpu->write<float>(addr, cpu->core.fprs[i].ps0)) {
-			cpu->write<float>(addr+4, cpu->core.fprs[i].ps1);
-		}
+	if (!w) {
+		return psqWrite(cpu, addr + psqSize(type), type, scale, cpu->core.fprs[rS].ps1);
 	}
+	return true;
 }
 
 void PPCInstr_psq_l(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -958,11 +1156,25 @@ void PPCInstr_psq_l(PPCInstruction *instr, PPCProcessor *cpu) {
 	psqLoad(cpu, addr, instr->rD(), instr->ps_i(), instr->ps_w());
 }
 
+void PPCInstr_psq_lu(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t addr = cpu->core.regs[instr->rA()] + instr->ps_d();
+	if (psqLoad(cpu, addr, instr->rD(), instr->ps_i(), instr->ps_w())) {
+		cpu->core.regs[instr->rA()] = addr;
+	}
+}
+
 void PPCInstr_psq_st(PPCInstruction *instr, PPCProcessor *cpu) {
 	uint32_t addr = (instr->rA() ? cpu->core.regs[instr->rA()] : 0) + instr->ps_d();
 	psqStore(cpu, addr, instr->rS(), instr->ps_i(), instr->ps_w());
 }
 
+void PPCInstr_psq_stu(PPCInstruction *instr, PPCProcessor *cpu) {
+	uint32_t addr = cpu->core.regs[instr->rA()] + instr->ps_d();
+	if (psqStore(cpu, addr, instr->rS(), instr->ps_i(), instr->ps_w())) {
+		cpu->core.regs[instr->rA()] = addr;
+	}
+}
+
 void PPCInstr_ps_mr(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rB()].ps0;
 	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rB()].ps1;
@@ -984,8 +1196,10 @@ void PPCInstr_ps_nabs(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_ps_merge00(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps0;
-	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rB()].ps0;
+	float ps0 = cpu->core.fprs[instr->rA()].ps0;
+	float ps1 = cpu->core.fprs[instr->rB()].ps0;
+	cpu->core.fprs[instr->rD()].ps0 = ps0;
+	cpu->core.fprs[instr->rD()].ps1 = ps1;
 }
 
 void PPCInstr_ps_merge01(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -994,8 +1208,10 @@ void PPCInstr_ps_merge01(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_ps_merge10(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps1;
-	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rB()].ps0;
+	float ps0 = cpu->core.fprs[instr->rA()].ps1;
+	float ps1 = cpu->core.fprs[instr->rB()].ps0;
+	cpu->core.fprs[instr->rD()].ps0 = ps0;
+	cpu->core.fprs[instr->rD()].ps1 = ps1;
 }
 
 void PPCInstr_ps_merge11(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -1049,13 +1265,15 @@ void PPCInstr_ps_sum0(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_ps_sum1(PPCInstruction *instr, PPCProcessor *cpu) {
+	float ps1 = cpu->core.fprs[instr->rA()].ps0 + cpu->core.fprs[instr->rB()].ps1;
 	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rC()].ps0;
-	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rA()].ps0 + cpu->core.fprs[instr->rB()].ps1;
+	cpu->core.fprs[instr->rD()].ps1 = ps1;
 }
 
 void PPCInstr_ps_muls0(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps0 * cpu->core.fprs[instr->rC()].ps0;
-	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rA()].ps1 * cpu->core.fprs[instr->rC()].ps0;
+	float c = cpu->core.fprs[instr->rC()].ps0;
+	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps0 * c;
+	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rA()].ps1 * c;
 }
 
 void PPCInstr_ps_muls1(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -1064,8 +1282,9 @@ void PPCInstr_ps_muls1(PPCInstruction *instr, PPCProcessor *cpu) {
 }
 
 void PPCInstr_ps_madds0(PPCInstruction *instr, PPCProcessor *cpu) {
-	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps0 * cpu->core.fprs[instr->rC()].ps0 + cpu->core.fprs[instr->rB()].ps0;
-	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rA()].ps1 * cpu->core.fprs[instr->rC()].ps0 + cpu->core.fprs[instr->rB()].ps1;
+	float c = cpu->core.fprs[instr->rC()].ps0;
+	cpu->core.fprs[instr->rD()].ps0 = cpu->core.fprs[instr->rA()].ps0 * c + cpu->core.fprs[instr->rB()].ps0;
+	cpu->core.fprs[instr->rD()].ps1 = cpu->core.fprs[instr->rA()].ps1 * c + cpu->core.fprs[instr->rB()].ps1;
 }
 
 void PPCInstr_ps_madds1(PPCInstruction *instr, PPCProcessor *cpu) {
@@ -1081,176 +1300,252 @@ void PPCInstr_ps_cmpo0(PPCInstruction *instr, PPCProcessor *cpu) {
 	cpu->core.cr.set(PPCCore::EQ >> (4 * instr->crfD()), left == right);
 }
 
-void PPCInstruction::execute(PPCProcessor *cpu) {
-	int type = opcode();
-	if (type == 4) {
-		int type = opcode2();
-		if (type == 18) PPCInstr_ps_div(this, cpu);
-		else if (type == 20) PPCInstr_ps_sub(this, cpu);
-		else if (type == 21) PPCInstr_ps_add(this, cpu);
-		else if (type == 32) PPCInstr_ps_cmpo0(this, cpu);
-		else if (type == 40) PPCInstr_ps_neg(this, cpu);
-		else if (type == 72) PPCInstr_ps_mr(this, cpu);
-		else if (type == 136) PPCInstr_ps_nabs(this, cpu);
-		else if (type == 264) PPCInstr_ps_abs(this, cpu);
-		else if (type == 528) PPCInstr_ps_merge00(this, cpu);
-		else if (type == 560) PPCInstr_ps_merge01(this, cpu);
-		else if (type == 592) PPCInstr_ps_merge10(this, cpu);
-		else if (type == 624) PPCInstr_ps_merge11(this, cpu);
-		else {
-			int type = opcode3();
-			if (type == 10) PPCInstr_ps_sum0(this, cpu);
-			else if (type == 11) PPCInstr_ps_sum1(this, cpu);
-			else if (type == 12) PPCInstr_ps_muls0(this, cpu);
-			else if (type == 13) PPCInstr_ps_muls1(this, cpu);
-			else if (type == 14) PPCInstr_ps_madds0(this, cpu);
-			else if (type == 15) PPCInstr_ps_madds1(this, cpu);
-			else if (type == 25) PPCInstr_ps_mul(this, cpu);
-			else if (type == 28) PPCInstr_ps_msub(this, cpu);
-			else if (type == 29) PPCInstr_ps_madd(this, cpu);
-			else if (type == 30) PPCInstr_ps_nmsub(this, cpu);
-			else if (type == 31) PPCInstr_ps_nmadd(this, cpu);
+/********** DECODER **********/
+
+// Primary opcodes with extended opcodes have a table that is indexed by
+// bits 21-30 of the instruction. A-form instructions only use bits 26-30,
+// so they fill every entry with the same low bits that is still free.
+struct PPCDecodeTable {
+	PPCInstruction::Handler primary[64];
+	PPCInstruction::Handler extended[5][1024];
+	int groups[64];
+};
+
+static constexpr void setAForm(PPCInstruction::Handler *table, int type, PPCInstruction::Handler handler) {
+	for (int i = type; i < 1024; i += 32) {
+		if (!table[i]) {
+			table[i] = handler;
 		}
 	}
-	else if (type == 7) PPCInstr_mulli(this, cpu);
-	else if (type == 8) PPCInstr_subfic(this, cpu);
-	else if (type == 10) PPCInstr_cmpli(this, cpu);
-	else if (type == 11) PPCInstr_cmpi(this, cpu);
-	else if (type == 12) PPCInstr_addic(this, cpu);
-	else if (type == 13) PPCInstr_addic_rc(this, cpu);
-	else if (type == 17) PPCInstr_sc(this, cpu);
-	else if (type == 19) {
-		int type = opcode2();
-		if (type == 16) PPCInstr_bclr(this, cpu);
-		else if (type == 33) PPCInstr_crnor(this, cpu);
-		else if (type == 50) PPCInstr_rfi(this, cpu);
-		else if (type == 129) PPCInstr_crandc(this, cpu);
-		else if (type == 193) PPCInstr_crxor(this, cpu);
-		else if (type == 225) PPCInstr_crnand(this, cpu);
-		else if (type == 257) PPCInstr_crand(this, cpu);
-		else if (type == 289) PPCInstr_creqv(this, cpu);
-		else if (type == 417) PPCInstr_crorc(this, cpu);
-		else if (type == 449) PPCInstr_cror(this, cpu);
-		else if (type == 528) PPCInstr_bcctr(this, cpu);
-	}
-	else if (type == 31) {
-		int type = opcode2();
-		if (type == 0) PPCInstr_cmp(this, cpu);
-		else if (type == 8) PPCInstr_subfc(this, cpu);
-		else if (type == 10) PPCInstr_addc(this, cpu);
-		else if (type == 11) PPCInstr_mulhwu(this, cpu);
-		else if (type == 19) PPCInstr_mfcr(this, cpu);
-		else if (type == 20) PPCInstr_lwarx(this, cpu);
-		else if (type == 23) PPCInstr_loadx<uint32_t>(this, cpu);
-		else if (type == 24) PPCInstr_slw(this, cpu);
-		else if (type == 26) PPCInstr_cntlzw(this, cpu);
-		else if (type == 28) PPCInstr_and(this, cpu);
-		else if (type == 32) PPCInstr_cmpl(this, cpu);
-		else if (type == 40) PPCInstr_subf(this, cpu);
-		else if (type == 55) PPCInstr_loadux<uint32_t>(this, cpu);
-		else if (type == 60) PPCInstr_andc(this, cpu);
-		else if (type == 75) PPCInstr_mulhw(this, cpu);
-		else if (type == 83) PPCInstr_mfmsr(this, cpu);
-		else if (type == 87) PPCInstr_loadx<uint8_t>(this, cpu);
-		else if (type == 104) PPCInstr_neg(this, cpu);
-		else if (type == 119) PPCInstr_loadux<uint8_t>(this, cpu);
-		else if (type == 124) PPCInstr_nor(this, cpu);
-		else if (type == 136) PPCInstr_subfe(this, cpu);
-		else if (type == 138) PPCInstr_adde(this, cpu);
-		else if (type == 144) PPCInstr_mtcrf(this, cpu);
-		else if (type == 146) PPCInstr_mtmsr(this, cpu);
-		else if (type == 150) PPCInstr_stwcx(this, cpu);
-		else if (type == 151) PPCInstr_storex<uint32_t>(this, cpu);
-		else if (type == 183) PPCInstr_storeux<uint32_t>(this, cpu);
-		else if (type == 200) PPCInstr_subfze(this, cpu);
-		else if (type == 202) PPCInstr_addze(this, cpu);
-		else if (type == 210) PPCInstr_mtsr(this, cpu);
-		else if (type == 215) PPCInstr_storex<uint8_t>(this, cpu);
-		else if (type == 234) PPCInstr_addme(this, cpu);
-		else if (type == 235) PPCInstr_mullw(this, cpu);
-		else if (type == 247) PPCInstr_storeux<uint8_t>(this, cpu);
-		else if (type == 279) PPCInstr_loadx<uint16_t>(this, cpu);
-		else if (type == 306) PPCInstr_tlbie(this, cpu);
-		else if (type == 311) PPCInstr_loadux<uint16_t>(this, cpu);
-		else if (type == 316) PPCInstr_xor(this, cpu);
-		else if (type == 339) PPCInstr_mfspr(this, cpu);
-		else if (type == 343) PPCInstr_loadx<int16_t>(this, cpu);
-		else if (type == 371) PPCInstr_mftb(this, cpu);
-		else if (type == 375) PPCInstr_loadux<int16_t>(this, cpu);
-		else if (type == 407) PPCInstr_storex<uint16_t>(this, cpu);
-		else if (type == 412) PPCInstr_orc(this, cpu);
-		else if (type == 439) PPCInstr_storeux<uint16_t>(this, cpu);
-		else if (type == 444) PPCInstr_or(this, cpu);
-		else if (type == 459) PPCInstr_divwu(this, cpu);
-		else if (type == 467) PPCInstr_mtspr(this, cpu);
-		else if (type == 491) PPCInstr_divw(this, cpu);
-		else if (type == 536) PPCInstr_srw(this, cpu);
-		else if (type == 567) PPCInstr_lfsux(this, cpu);
-		else if (type == 595) PPCInstr_mfsr(this, cpu);
-		else if (type == 597) PPCInstr_lswi(this, cpu);
-		else if (type == 631) PPCInstr_lfdux(this, cpu);
-		else if (type == 695) PPCInstr_stfsux(this, cpu);
-		else if (type == 725) PPCInstr_stswi(this, cpu);
-		else if (type == 759) PPCInstr_stfdux(this, cpu);
-		else if (type == 792) PPCInstr_sraw(this, cpu);
-		else if (type == 824) PPCInstr_srawi(this, cpu);
-		else if (type == 922) PPCInstr_extsh(this, cpu);
-		else if (type == 954) PPCInstr_extsb(this, cpu);
-		else if (type == 982) PPCInstr_icbi(this, cpu);
-		else if (type == 1014) PPCInstr_dcbz(this, cpu);
-	}
-	else if (type == 36) PPCInstr_store<uint32_t>(this, cpu);
-	else if (type == 37) PPCInstr_storeu<uint32_t>(this, cpu);
-	else if (type == 38) PPCInstr_store<uint8_t>(this, cpu);
-	else if (type == 39) PPCInstr_storeu<uint8_t>(this, cpu);
-	else if (type == 44) PPCInstr_store<uint16_t>(this, cpu);
-	else if (type == 45) PPCInstr_storeu<uint16_t>(this, cpu);
-	else if (type == 46) PPCInstr_lmw(this, cpu);
-	else if (type == 47) PPCInstr_stmw(this, cpu);
-	else if (type == 48) PPCInstr_lfs(this, cpu);
-	else if (type == 49) PPCInstr_lfsu(this, cpu);
-	else if (type == 50) PPCInstr_lfd(this, cpu);
-	else if (type == 51) PPCInstr_lfdu(this, cpu);
-	else if (type == 52) PPCInstr_stfs(this, cpu);
-	else if (type == 53) PPCInstr_stfsu(this, cpu);
-	else if (type == 54) PPCInstr_stfd(this, cpu);
-	else if (type == 55) PPCInstr_stfdu(this, cpu);
-	else if (type == 56) PPCInstr_psq_l(this, cpu);
-	else if (type == 59) {
-		int type = opcode3();
-		if (type == 18) PPCInstr_fdivs(this, cpu);
-		else if (type == 20) PPCInstr_fsubs(this, cpu);
-		else if (type == 21) PPCInstr_fadds(this, cpu);
-		else if (type == 24) PPCInstr_fres(this, cpu);
-		else if (type == 25) PPCInstr_fmuls(this, cpu);
-		else if (type == 28) PPCInstr_fmsubs(this, cpu);
-		else if (type == 29) PPCInstr_fmadds(this, cpu);
-		else if (type == 30) PPCInstr_fnmsubs(this, cpu);
-		else if (type == 31) PPCInstr_fnmadds(this, cpu);
-	}
-	else if (type == 60) PPCInstr_psq_st(this, cpu);
-	else if (type == 63) {
-		int type = opcode2();
-		if (type == 0) PPCInstr_fcmpu(this, cpu);
-		else if (type == 12) PPCInstr_frsp(this, cpu);
-		else if (type == 15) PPCInstr_fctiwz(this, cpu);
-		else if (type == 18) PPCInstr_fdiv(this, cpu);
-		else if (type == 20) PPCInstr_fsub(this, cpu);
-		else if (type == 21) PPCInstr_fadd(this, cpu);
-		else if (type == 40) PPCInstr_fneg(this, cpu);
-		else if (type == 72) PPCInstr_fmr(this, cpu);
-		else if (type == 264) PPCInstr_fabs(this, cpu);
-		else if (type == 583) PPCInstr_mffs(this, cpu);
-		else if (type == 711) PPCInstr_mtfsf(this, cpu);
-		else {
-			int type = opcode3();
-			if (type == 23) PPCInstr_fsel(this, cpu);
-			else if (type == 25) PPCInstr_fmul(this, cpu);
-			else if (type == 26) PPCInstr_frsqrte(this, cpu);
-			else if (type == 28) PPCInstr_fmsub(this, cpu);
-			else if (type == 29) PPCInstr_fmadd(this, cpu);
-			else if (type == 30) PPCInstr_fnmsub(this, cpu);
-			else if (type == 31) PPCInstr_fnmadd(this, cpu);
-		}
+}
+
+static constexpr PPCDecodeTable makeDecodeTable() {
+	PPCDecodeTable table = {};
+	
+	table.groups[4] = 1;
+	table.groups[19] = 2;
+	table.groups[31] = 3;
+	table.groups[59] = 4;
+	table.groups[63] = 5;
+	
+	PPCInstruction::Handler *op4 = table.extended[0];
+	PPCInstruction::Handler *op19 = table.extended[1];
+	PPCInstruction::Handler *op31 = table.extended[2];
+	PPCInstruction::Handler *op59 = table.extended[3];
+	PPCInstruction::Handler *op63 = table.extended[4];
+	
+	op4[18] = PPCInstr_ps_div;
+	op4[20] = PPCInstr_ps_sub;
+	op4[21] = PPCInstr_ps_add;
+	op4[32] = PPCInstr_ps_cmpo0;
+	op4[40] = PPCInstr_ps_neg;
+	op4[72] = PPCInstr_ps_mr;
+	op4[136] = PPCInstr_ps_nabs;
+	op4[264] = PPCInstr_ps_abs;
+	op4[528] = PPCInstr_ps_merge00;
+	op4[560] = PPCInstr_ps_merge01;
+	op4[592] = PPCInstr_ps_merge10;
+	op4[624] = PPCInstr_ps_merge11;
+	op4[1014] = PPCInstr_nop; // dcbz_l
+	setAForm(op4, 10, PPCInstr_ps_sum0);
+	setAForm(op4, 11, PPCInstr_ps_sum1);
+	setAForm(op4, 12, PPCInstr_ps_muls0);
+	setAForm(op4, 13, PPCInstr_ps_muls1);
+	setAForm(op4, 14, PPCInstr_ps_madds0);
+	setAForm(op4, 15, PPCInstr_ps_madds1);
+	setAForm(op4, 25, PPCInstr_ps_mul);
+	setAForm(op4, 28, PPCInstr_ps_msub);
+	setAForm(op4, 29, PPCInstr_ps_madd);
+	setAForm(op4, 30, PPCInstr_ps_nmsub);
+	setAForm(op4, 31, PPCInstr_ps_nmadd);
+	
+	table.primary[7] = PPCInstr_mulli;
+	table.primary[8] = PPCInstr_subfic;
+	table.primary[10] = PPCInstr_cmpli;
+	table.primary[11] = PPCInstr_cmpi;
+	table.primary[12] = PPCInstr_addic;
+	table.primary[13] = PPCInstr_addic_rc;
+	table.primary[14] = PPCInstr_addi;
+	table.primary[15] = PPCInstr_addis;
+	table.primary[16] = PPCInstr_bc;
+	table.primary[17] = PPCInstr_sc;
+	table.primary[18] = PPCInstr_b;
+	
+	op19[16] = PPCInstr_bclr;
+	op19[33] = PPCInstr_crnor;
+	op19[50] = PPCInstr_rfi;
+	op19[129] = PPCInstr_crandc;
+	op19[150] = PPCInstr_nop;
+	op19[193] = PPCInstr_crxor;
+	op19[225] = PPCInstr_crnand;
+	op19[257] = PPCInstr_crand;
+	op19[289] = PPCInstr_creqv;
+	op19[417] = PPCInstr_crorc;
+	op19[449] = PPCInstr_cror;
+	op19[528] = PPCInstr_bcctr;
+	
+	table.primary[20] = PPCInstr_rlwimi;
+	table.primary[21] = PPCInstr_rlwinm;
+	table.primary[23] = PPCInstr_rlwnm;
+	table.primary[24] = PPCInstr_ori;
+	table.primary[25] = PPCInstr_oris;
+	table.primary[26] = PPCInstr_xori;
+	table.primary[27] = PPCInstr_xoris;
+	table.primary[28] = PPCInstr_andi;
+	table.primary[29] = PPCInstr_andis;
+	
+	op31[0] = PPCInstr_cmp;
+	op31[8] = PPCInstr_subfc;
+	op31[10] = PPCInstr_addc;
+	op31[11] = PPCInstr_mulhwu;
+	op31[19] = PPCInstr_mfcr;
+	op31[20] = PPCInstr_lwarx;
+	op31[23] = PPCInstr_loadx<uint32_t>;
+	op31[24] = PPCInstr_slw;
+	op31[26] = PPCInstr_cntlzw;
+	op31[28] = PPCInstr_and;
+	op31[32] = PPCInstr_cmpl;
+	op31[40] = PPCInstr_subf;
+	op31[54] = PPCInstr_nop;
+	op31[55] = PPCInstr_loadux<uint32_t>;
+	op31[60] = PPCInstr_andc;
+	op31[75] = PPCInstr_mulhw;
+	op31[83] = PPCInstr_mfmsr;
+	op31[86] = PPCInstr_nop;
+	op31[87] = PPCInstr_loadx<uint8_t>;
+	op31[104] = PPCInstr_neg;
+	op31[119] = PPCInstr_loadux<uint8_t>;
+	op31[124] = PPCInstr_nor;
+	op31[136] = PPCInstr_subfe;
+	op31[138] = PPCInstr_adde;
+	op31[144] = PPCInstr_mtcrf;
+	op31[146] = PPCInstr_mtmsr;
+	op31[150] = PPCInstr_stwcx;
+	op31[151] = PPCInstr_storex<uint32_t>;
+	op31[183] = PPCInstr_storeux<uint32_t>;
+	op31[200] = PPCInstr_subfze;
+	op31[202] = PPCInstr_addze;
+	op31[210] = PPCInstr_mtsr;
+	op31[215] = PPCInstr_storex<uint8_t>;
+	op31[234] = PPCInstr_addme;
+	op31[235] = PPCInstr_mullw;
+	op31[247] = PPCInstr_storeux<uint8_t>;
+	op31[266] = PPCInstr_add;
+	op31[279] = PPCInstr_loadx<uint16_t>;
+	op31[306] = PPCInstr_tlbie;
+	op31[311] = PPCInstr_loadux<uint16_t>;
+	op31[316] = PPCInstr_xor;
+	op31[339] = PPCInstr_mfspr;
+	op31[343] = PPCInstr_loadx<int16_t>;
+	op31[371] = PPCInstr_mftb;
+	op31[375] = PPCInstr_loadux<int16_t>;
+	op31[407] = PPCInstr_storex<uint16_t>;
+	op31[412] = PPCInstr_orc;
+	op31[439] = PPCInstr_storeux<uint16_t>;
+	op31[444] = PPCInstr_or;
+	op31[459] = PPCInstr_divwu;
+	op31[467] = PPCInstr_mtspr;
+	op31[470] = PPCInstr_nop;
+	op31[491] = PPCInstr_divw;
+	op31[534] = PPCInstr_lwbrx;
+	op31[535] = PPCInstr_lfsx;
+	op31[536] = PPCInstr_srw;
+	op31[567] = PPCInstr_lfsux;
+	op31[595] = PPCInstr_mfsr;
+	op31[597] = PPCInstr_lswi;
+	op31[598] = PPCInstr_nop;
+	op31[599] = PPCInstr_lfdx;
+	op31[631] = PPCInstr_lfdux;
+	op31[662] = PPCInstr_stwbrx;
+	op31[663] = PPCInstr_stfsx;
+	op31[695] = PPCInstr_stfsux;
+	op31[725] = PPCInstr_stswi;
+	op31[727] = PPCInstr_stfdx;
+	op31[759] = PPCInstr_stfdux;
+	op31[792] = PPCInstr_sraw;
+	op31[824] = PPCInstr_srawi;
+	op31[854] = PPCInstr_nop;
+	op31[922] = PPCInstr_extsh;
+	op31[954] = PPCInstr_extsb;
+	op31[982] = PPCInstr_icbi;
+	op31[983] = PPCInstr_stfiwx;
+	op31[1014] = PPCInstr_dcbz;
+	
+	table.primary[32] = PPCInstr_load<uint32_t>;
+	table.primary[33] = PPCInstr_loadu<uint32_t>;
+	table.primary[34] = PPCInstr_load<uint8_t>;
+	table.primary[35] = PPCInstr_loadu<uint8_t>;
+	table.primary[36] = PPCInstr_store<uint32_t>;
+	table.primary[37] = PPCInstr_storeu<uint32_t>;
+	table.primary[38] = PPCInstr_store<uint8_t>;
+	table.primary[39] = PPCInstr_storeu<uint8_t>;
+	table.primary[40] = PPCInstr_load<uint16_t>;
+	table.primary[41] = PPCInstr_loadu<uint16_t>;
+	table.primary[42] = PPCInstr_load<int16_t>;
+	table.primary[43] = PPCInstr_loadu<int16_t>;
+	table.primary[44] = PPCInstr_store<uint16_t>;
+	table.primary[45] = PPCInstr_storeu<uint16_t>;
+	table.primary[46] = PPCInstr_lmw;
+	table.primary[47] = PPCInstr_stmw;
+	table.primary[48] = PPCInstr_lfs;
+	table.primary[49] = PPCInstr_lfsu;
+	table.primary[50] = PPCInstr_lfd;
+	table.primary[51] = PPCInstr_lfdu;
+	table.primary[52] = PPCInstr_stfs;
+	table.primary[53] = PPCInstr_stfsu;
+	table.primary[54] = PPCInstr_stfd;
+	table.primary[55] = PPCInstr_stfdu;
+	table.primary[56] = PPCInstr_psq_l;
+	table.primary[57] = PPCInstr_psq_lu;
+	
+	setAForm(op59, 18, PPCInstr_fdivs);
+	setAForm(op59, 20, PPCInstr_fsubs);
+	setAForm(op59, 21, PPCInstr_fadds);
+	setAForm(op59, 24, PPCInstr_fres);
+	setAForm(op59, 25, PPCInstr_fmuls);
+	setAForm(op59, 28, PPCInstr_fmsubs);
+	setAForm(op59, 29, PPCInstr_fmadds);
+	setAForm(op59, 30, PPCInstr_fnmsubs);
+	setAForm(op59, 31, PPCInstr_fnmadds);
+	
+	table.primary[60] = PPCInstr_psq_st;
+	table.primary[61] = PPCInstr_psq_stu;
+	
+	op63[0] = PPCInstr_fcmpu;
+	op63[12] = PPCInstr_frsp;
+	op63[15] = PPCInstr_fctiwz;
+	op63[18] = PPCInstr_fdiv;
+	op63[20] = PPCInstr_fsub;
+	op63[21] = PPCInstr_fadd;
+	op63[40] = PPCInstr_fneg;
+	op63[72] = PPCInstr_fmr;
+	op63[264] = PPCInstr_fabs;
+	op63[583] = PPCInstr_mffs;
+	op63[711] = PPCInstr_mtfsf;
+	setAForm(op63, 23, PPCInstr_fsel);
+	setAForm(op63, 25, PPCInstr_fmul);
+	setAForm(op63, 26, PPCInstr_frsqrte);
+	setAForm(op63, 28, PPCInstr_fmsub);
+	setAForm(op63, 29, PPCInstr_fmadd);
+	setAForm(op63, 30, PPCInstr_fnmsub);
+	setAForm(op63, 31, PPCInstr_fnmadd);
+	
+	return table;
+}
+
+static constexpr PPCDecodeTable decodeTable = makeDecodeTable();
+
+PPCInstruction::Handler PPCInstruction::decode() {
+	int group = decodeTable.groups[opcode()];
+	if (group) {
+		return decodeTable.extended[group - 1][opcode2()];
+	}
+	return decodeTable.primary[opcode()];
+}
+
+void PPCInstruction::execute(PPCProcessor *cpu) {
+	Handler handler = decode();
+	if (handler) {
+		handler(this, cpu);
 	}
 }
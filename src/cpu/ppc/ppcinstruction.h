@@ -7,6 +7,8 @@
 class PPCProcessor;
 
 struct PPCInstruction {
+	typedef void (*Handler)(PPCInstruction *instr, PPCProcessor *cpu);
+	
 	uint32_t value;
 	
 	inline int opcode() { return value >> 26; }
@@ -67,7 +69,11 @@ struct PPCInstruction {
 		}
 		return val;
 	}
-	inline bool ps_i() { return (value >> 12) & 7; }
+	inline int ps_i() { return (value >> 12) & 7; }
 	
+	Handler decode();
 	void execute(PPCProcessor *cpu);
 };
+
+bool psqLoad(PPCProcessor *cpu, uint32_t addr, int rD, int i, int w);
+bool psqStore(PPCProcessor *cpu, uint32_t addr, int rS, int i, int w);
@@ -1,14 +1,34 @@
 
 #include "ppcmmu.h"
 
+#include <cstring>
 
-PPCMMU::PPCMMU(PhysicalMemory *physmem, PPCCore *core) {
+
+PPCMMU::PPCMMU(PhysicalMemory *physmem, PPCCore *core) : cache(17) {
 	this->physmem = physmem;
 	this->core = core;
+	
+	memset(pteCache, 0, sizeof(pteCache));
+	pteGeneration = 1;
+	
+	physmem->addModifiedPages(&modified);
 }
 
 void PPCMMU::reset() {
 	cache.reset();
+	invalidateBAT();
+	invalidatePageTable();
+}
+
+void PPCMMU::invalidateBAT() {
+	batValid = false;
+}
+
+void PPCMMU::invalidatePageTable() {
+	if (++pteGeneration == 0) {
+		memset(pteCache, 0, sizeof(pteCache));
+		pteGeneration = 1;
+	}
 }
 
 bool PPCMMU::translate(uint32_t *addr, MemoryAccess type, bool supervisor) {
@@ -29,12 +49,12 @@ bool PPCMMU::translateVirtual(uint32_t *addr, MemoryAccess type, bool supervisor
 	if (type == MemoryAccess::Instruction) {
 		if (!(core->msr & 0x20)) return true;
 		if (cache.translate(addr, type, supervisor)) return true;
-		if (translateBAT(addr, PPCCore::IBAT0U, type, supervisor)) return true;
+		if (translateBAT(addr, type, supervisor)) return true;
 	}
 	else {
 		if (!(core->msr & 0x10)) return true;
 		if (cache.translate(addr, type, supervisor)) return true;
-		if (translateBAT(addr, PPCCore::DBAT0U, type, supervisor)) return true;
+		if (translateBAT(addr, type, supervisor)) return true;
 	}
 	
 	uint32_t segment = core->sr[*addr >> 28];
@@ -47,18 +67,50 @@ bool PPCMMU::translateVirtual(uint32_t *addr, MemoryAccess type, bool supervisor
 		uint32_t vsid = segment & 0xFFFFFF;
 		
 		bool key = supervisor ? (segment >> 30) & 1 : (segment >> 29) & 1;
+		bool write = type == MemoryAccess::DataWrite;
 		
-		uint32_t primaryHash = (vsid & 0x7FFFF) ^ pageIndex;
-		if (searchPageTable(addr, vsid, pageIndex, primaryHash, false, key, type, supervisor)) return true;
-		if (searchPageTable(addr, vsid, pageIndex, ~primaryHash, true, key, type, supervisor)) return true;
+		uint32_t pte;
+		if (findPTE(&pte, vsid, pageIndex, key, write)) {
+			cache.update(type, supervisor, *addr, pte & 0xFFFFF000, 0x1FFFF);
+			*addr = (pte & 0xFFFFF000) | (*addr & 0x1FFFF);
+			return true;
+		}
 	}
 	
 	return false;
 }
 
-bool PPCMMU::translateBAT(uint32_t *addr, int bat, MemoryAccess type, bool supervisor) {
+bool PPCMMU::translateBAT(uint32_t *addr, MemoryAccess type, bool supervisor) {
+	if (!batValid) {
+		updateBAT();
+	}
+	
+	uint32_t block = batTable[(int)type * 2 + supervisor][*addr >> 17];
+	if (!block) return false;
+	
+	uint32_t base = block & ~0x1FFFF;
+	cache.update(type, supervisor, *addr, base, 0x1FFFF);
+	*addr = (*addr & 0x1FFFF) | base;
+	return true;
+}
+
+void PPCMMU::updateBAT() {
+	for (int i = 0; i < 3; i++) {
+		MemoryAccess type = (MemoryAccess)i;
+		int bat = type == MemoryAccess::Instruction ? PPCCore::IBAT0U : PPCCore::DBAT0U;
+		updateBAT(batTable[i * 2], bat, type, false);
+		updateBAT(batTable[i * 2 + 1], bat, type, true);
+	}
+	batValid = true;
+}
+
+void PPCMMU::updateBAT(uint32_t *table, int bat, MemoryAccess type, bool supervisor) {
+	memset(table, 0, sizeof(batTable[0]));
+	
+	// The first BAT that matches has priority, so
+	// the table is filled in reverse order
 	bool write = type == MemoryAccess::DataWrite;
-	for (int i = 0; i < 8; i++) {
+	for (int i = 7; i >= 0; i--) {
 		uint32_t batu = core->sprs[bat + i * 2 + i / 4 * 8];
 		uint32_t batl = core->sprs[bat + i * 2 + i / 4 * 8 + 1];
 		
@@ -69,26 +121,68 @@ bool PPCMMU::translateBAT(uint32_t *addr, int bat, MemoryAccess type, bool super
 		bool vs = batu & 2;
 		if (!((vp && !supervisor) || (vs && supervisor))) continue;
 		
-		uint32_t addrMask = ~((batu >> 2) & 0x7FF);
-		uint32_t effectiveBlock = batu >> 17;
-		uint32_t addrBlock = *addr >> 17;
-		if ((effectiveBlock & addrMask) != (addrBlock & addrMask)) continue;
+		uint32_t blockMask = (batu >> 2) & 0x7FF;
+		uint32_t effectiveBlock = (batu >> 17) & ~blockMask;
+		uint32_t physicalBlock = (batl >> 17) & ~blockMask;
 		
-		uint32_t brpn = batl >> 17;
-		addrBlock = (addrBlock & ~addrMask) | (brpn & addrMask);
-		cache.update(type, supervisor, *addr, addrBlock << 17, 0x1FFFF);
-		*addr = (*addr & 0x1FFFF) | (addrBlock << 17);
+		// Visit every block that is covered by the mask
+		uint32_t offset = 0;
+		do {
+			// The lowest bit marks the entry as valid
+			table[effectiveBlock | offset] = ((physicalBlock | offset) << 17) | 1;
+			offset = (offset - blockMask) & blockMask;
+		} while (offset);
+	}
+}
+
+bool PPCMMU::findPTE(uint32_t *pte, uint32_t vsid, uint32_t pageIndex, bool key, bool write) {
+	if (modified.pending) {
+		checkPageTable();
+	}
+	
+	uint32_t primaryHash = (vsid & 0x7FFFF) ^ pageIndex;
+	uint32_t tag = pageIndex | (key << 11) | (write << 12);
+	
+	PTECacheEntry *entry = &pteCache[(primaryHash ^ (tag >> 1)) & 0xFFF];
+	if (entry->generation == pteGeneration && entry->vsid == vsid && entry->tag == tag) {
+		*pte = entry->pte;
+		return true;
+	}
+	
+	if (searchPageTable(pte, vsid, pageIndex, primaryHash, false, key, write) ||
+		searchPageTable(pte, vsid, pageIndex, ~primaryHash, true, key, write)) {
+		entry->vsid = vsid;
+		entry->tag = tag;
+		entry->pte = *pte;
+		entry->generation = pteGeneration;
 		return true;
 	}
 	return false;
 }
 
+// Discards the search results if the page table was modified
+void PPCMMU::checkPageTable() {
+	uint32_t sdr1 = core->sprs[PPCCore::SDR1];
+	uint32_t start = sdr1 & 0xFFFF0000;
+	uint32_t size = ((sdr1 & 0x1FF) + 1) << 16;
+	translatePhysical(&start);
+	
+	bool invalidate = false;
+	modified.collect([&](uint32_t page) {
+		if ((page << 12) - start < size) {
+			invalidate = true;
+		}
+	});
+	
+	if (invalidate) {
+		invalidatePageTable();
+	}
+}
+
 bool PPCMMU::searchPageTable(
-	uint32_t *addr, uint32_t vsid, uint32_t pageIndex,
-	uint32_t hash, bool secondary, int key, MemoryAccess type,
-	bool supervisor
+	uint32_t *pte, uint32_t vsid, uint32_t pageIndex,
+	uint32_t hash, bool secondary, bool key, bool write
 ) {
-	bool write = type == MemoryAccess::DataWrite;
 	uint32_t sdr1 = core->sprs[PPCCore::SDR1];
 	uint32_t pageTable = sdr1 & 0xFFFF0000;
 	uint32_t pageMask = sdr1 & 0x1FF;
@@ -98,6 +192,11 @@ bool PPCMMU::searchPageTable(
 	uint32_t pteAddr = pageTable | (maskedHash << 6);
 	translatePhysical(&pteAddr);
 	
+	// Protect the page first, so that no write can be missed
+	if (!isHardware(pteAddr)) {
+		physmem->protectCode(pteAddr);
+	}
+	
 	for (int i = 0; i < 8; i++, pteAddr += 8) {
 		//Read PTE
 		uint32_t pteHi = physmem->read<uint32_t>(pteAddr);
@@ -114,9 +213,7 @@ bool PPCMMU::searchPageTable(
 		if (key && !pp) continue;
 		if (write && (pp == 3 || (key && pp == 1))) continue;
 		
-		//Translate address
-		cache.update(type, supervisor, *addr, pteLo & 0xFFFFF000, 0x1FFFF);
-		*addr = (pteLo & 0xFFFFF000) | (*addr & 0x1FFFF);
+		*pte = pteLo;
 		return true;
 	}
 	return false;
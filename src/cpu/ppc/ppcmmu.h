@@ -16,17 +16,47 @@ public:
 	void reset();
 	bool translate(uint32_t *addr, MemoryAccess type, bool supervisor);
 	
+	// Must be called when a BAT register is changed
+	void invalidateBAT();
+	
+	// Must be called when SDR1 is changed or a TLB entry is invalidated
+	void invalidatePageTable();
+	
 	MMUCache cache;
 	
 private:
 	void translatePhysical(uint32_t *addr);
 	bool translateVirtual(uint32_t *addr, MemoryAccess type, bool supervisor);
-	bool translateBAT(uint32_t *addr, int bat, MemoryAccess type, bool supervisor);
+	bool translateBAT(uint32_t *addr, MemoryAccess type, bool supervisor);
+	void updateBAT();
+	void updateBAT(uint32_t *table, int bat, MemoryAccess type, bool supervisor);
+	bool findPTE(uint32_t *pte, uint32_t vsid, uint32_t pageIndex, bool key, bool write);
 	bool searchPageTable(
-		uint32_t *addr, uint32_t vsid, uint32_t pageIndex, uint32_t hash,
-		bool secondary, int key, MemoryAccess type, bool supervisor
+		uint32_t *pte, uint32_t vsid, uint32_t pageIndex, uint32_t hash,
+		bool secondary, bool key, bool write
 	);
+	void checkPageTable();
 	
 	PhysicalMemory *physmem;
 	PPCCore *core;
+	
+	// For every access type and privilege level, the physical
+	// address of every 128KB block, or 0 if no BAT matches it
+	uint32_t batTable[6][0x8000];
+	bool batValid;
+	
+	// Results of page table searches. The pages of the page table
+	// that were searched are write protected, and all results are
+	// discarded when one of them is modified.
+	struct PTECacheEntry {
+		uint32_t vsid;
+		uint32_t tag;
+		uint32_t pte;
+		uint32_t generation;
+	};
+	
+	PTECacheEntry pteCache[0x1000];
+	uint32_t pteGeneration;
+	
+	ModifiedPages modified;
 };
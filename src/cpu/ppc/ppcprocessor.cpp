@@ -10,7 +10,8 @@
 PPCProcessor::PPCProcessor(Emulator *emulator, PPCReservation *reservation, int index) :
 	Processor(emulator, index + 1, true),
 	mmu(&emulator->physmem, &core),
-	jit(&emulator->physmem, this)
+	jit(&emulator->physmem, this, "ppc"),
+	fastmem(3)
 {
 	this->reservation = reservation;
 	
@@ -23,12 +24,15 @@ PPCProcessor::PPCProcessor(Emulator *emulator, PPCReservation *reservation, int
 
 void PPCProcessor::reset() {
 	jit.reset();
+	fastmem.invalidate();
 	core.reset();
+	mmu.reset();
 	core.sprs[PPCCore::PIR] = index - 1;
 	core.sprs[PPCCore::PVR] = 0x70010201;
 	
 	#if STATS
 	instrsExecuted = 0;
+	instrsInterpreted = 0;
 	#endif
 	
 	#if METRICS
@@ -36,6 +40,8 @@ void PPCProcessor::reset() {
 	#endif
 	
 	timer = 0;
+	segmentsModified = false;
+	blockAddr = 0;
 }
 
 void PPCProcessor::copy(uint32_t dst, uint32_t src, uint32_t length) {
@@ -63,23 +69,89 @@ void PPCProcessor::copy(uint32_t dst, uint32_t src, uint32_t length) {
 	physmem->write(dst, data);
 }
 
+void PPCProcessor::invalidateSegments() {
+	segmentsModified = true;
+}
+
+void PPCProcessor::updateSegments() {
+	if (segmentsModified) {
+		mmu.cache.invalidate();
+		jit.unlink();
+		fastmem.invalidate();
+		segmentsModified = false;
+	}
+}
+
+#if WATCHPOINTS
+void PPCProcessor::addWatchpoint(bool write, bool virt, uint32_t addr) {
+	Processor::addWatchpoint(write, virt, addr);
+	fastmem.invalidate();
+}
+#endif
+
+// Real mode, translated supervisor mode or translated user mode
+int PPCProcessor::getFastmemContext() {
+	if (!(core.msr & 0x10)) return 0;
+	return core.msr & 0x4000 ? 2 : 1;
+}
+
+void PPCProcessor::mapFastmem(uint32_t vaddr, uint32_t paddr, bool write) {
+	if (isHardware(paddr)) return;
+	
+	#if WATCHPOINTS
+	if (hasWatchpoints()) return;
+	#endif
+	
+	// Writes to the gather pipe must go through the slow path
+	if (write && (core.sprs[PPCCore::HID2] & 0x40000000)) {
+		if (paddr >> 12 == core.sprs[PPCCore::WPAR] >> 12) return;
+	}
+	
+	fastmem.map(getFastmemContext(), vaddr, physmem->getPointer(paddr), write);
+}
+
+// Instructions that may change the address translation or the code that
+// is being executed. The JIT ends its blocks at the same instructions.
+static bool isContextSync(PPCInstruction instr) {
+	int type = instr.opcode();
+	if (type == 19) return instr.opcode2() == 150; // isync
+	if (type == 31) {
+		int type = instr.opcode2();
+		if (type == 467) {
+			int spr = instr.spr();
+			return !(spr == 1 || spr == 8 || spr == 9 || (spr >= 912 && spr < 920));
+		}
+		return type == 146 || type == 306 || type == 982;
+	}
+	return false;
+}
+
 void PPCProcessor::step() {
 	uint32_t addr = core.pc;
 	
+	updateSegments();
+	fastmem.select(getFastmemContext());
+	
 	bool supervisor = !(core.msr & 0x4000);
 	if (mmu.translate(&addr, MemoryAccess::Instruction, supervisor)) {
 		#if STATS
 		instrsExecuted++;
 		#endif
 		
-		core.pc += 4;
-		jit.execute(addr);
+		if (jit.isHot(addr)) {
+			blockAddr = core.pc;
+			core.pc += 4;
+			jit.execute(addr);
+		}
+		else {
+			interpret(addr, 1);
+		}
 	}
 	else {
 		core.triggerException(PPCCore::ISI);
 	}
 	
-	updateTimer();
+	updateTimer(1);
 	checkDebugPoints();
 	
 	#if BREAKPOINTS
@@ -87,6 +159,90 @@ void PPCProcessor::step() {
 	#endif
 }
 
+void PPCProcessor::stepBlock() {
+	#if BREAKPOINTS
+	if (!breakpoints.empty()) {
+		step();
+		return;
+	}
+	#endif
+	
+	uint32_t pc = core.pc;
+	uint32_t addr = core.pc;
+	int instrs = 1;
+	
+	updateSegments();
+	fastmem.select(getFastmemContext());
+	
+	bool supervisor = !(core.msr & 0x4000);
+	if (mmu.translate(&addr, MemoryAccess::Instruction, supervisor)) {
+		if (jit.isHot(addr)) {
+			blockAddr = pc;
+			core.pc += 4;
+			instrs = jit.executeBlock(addr, getBlockLimit());
+			
+			uint32_t target = core.pc;
+			if (jit.isLinkPending() && mmu.translate(&target, MemoryAccess::Instruction, supervisor)) {
+				jit.link(target, core.msr & 0x4020);
+			}
+		}
+		else {
+			instrs = interpret(addr, getBlockLimit());
+		}
+		
+		#if STATS
+		instrsExecuted += instrs;
+		#endif
+	}
+	else {
+		core.triggerException(PPCCore::ISI);
+	}
+	
+	updateTimer(instrs);
+	checkDebugPoints();
+	
+	// Branch to self, nothing happens until the next interrupt
+	if (core.pc == pc && physmem->read<uint32_t>(addr) == 0x48000000) {
+		idle();
+	}
+}
+
+// Executes the instructions of a page that is not compiled yet, until a
+// branch, an exception or the end of the page. Returns the number of
+// instructions.
+int PPCProcessor::interpret(uint32_t addr, int limit) {
+	int instrs = 0;
+	while (true) {
+		PPCInstruction instr;
+		instr.value = physmem->read<uint32_t>(addr);
+		
+		PPCInstruction::Handler handler = instr.decode();
+		if (!handler) {
+			runtime_error("PPC instruction: 0x%08X (at 0x%08X)", instr.value, core.pc);
+		}
+		
+		#if METRICS
+		metrics.update(instr);
+		#endif
+		
+		uint32_t pc = core.pc + 4;
+		core.pc = pc;
+		handler(&instr, this);
+		
+		instrs++;
+		addr += 4;
+		
+		if (core.pc != pc || isContextSync(instr)) break;
+		if (instrs == limit || !(addr & 0xFFF)) break;
+	}
+	
+	#if STATS
+	instrsInterpreted += instrs;
+	#endif
+	
+	return instrs;
+}
+
 void PPCProcessor::checkDebugPoints() {
 	if (core.pc == 0xFFF1AB34) {
 		uint32_t addr = core.regs[6];
@@ -104,24 +260,63 @@ void PPCProcessor::checkDebugPoints() {
 	}
 }
 
-void PPCProcessor::updateTimer() {
-	core.sprs[PPCCore::TBL]++;
-	if (core.sprs[PPCCore::TBL] == 0) {
-		core.sprs[PPCCore::TBU]++;
+// Blocks must stop when the decrementer underflows
+// or when the interrupts are checked again
+int PPCProcessor::getBlockLimit() {
+	int limit = JITGenerator::BlockLimit;
+	if (core.sprs[PPCCore::DEC] < (uint32_t)limit) {
+		limit = core.sprs[PPCCore::DEC] + 1;
 	}
+	if (100 - timer < limit) {
+		limit = 100 - timer;
+	}
+	return limit;
+}
+
+void PPCProcessor::updateTimer(int instrs) {
+	uint64_t tb = ((uint64_t)core.sprs[PPCCore::TBU] << 32) | core.sprs[PPCCore::TBL];
+	tb += instrs;
+	core.sprs[PPCCore::TBL] = tb;
+	core.sprs[PPCCore::TBU] = tb >> 32;
 	
-	core.sprs[PPCCore::DEC]--;
-	if (core.sprs[PPCCore::DEC] == -1) {
+	uint32_t dec = core.sprs[PPCCore::DEC];
+	core.sprs[PPCCore::DEC] = dec - instrs;
+	if (dec < (uint32_t)instrs) {
 		core.triggerException(PPCCore::Decrementer);
 	}
 	
-	timer++;
-	if (timer == 100) {
+	timer += instrs;
+	if (timer >= 100) {
 		checkInterrupts();
 		timer = 0;
 	}
 }
 
+void PPCProcessor::idle() {
+	if (!(core.msr & 0x8000)) return;
+	
+	// Waits until the decrementer underflows at most, and
+	// skips the time that actually passed while waiting
+	uint32_t dec = core.sprs[PPCCore::DEC];
+	uint32_t instrs = dec == 0xFFFFFFFF ? dec : dec + 1;
+	bool interrupt = hardware->idle_ppc(index - 1, &instrs);
+	
+	uint64_t tb = ((uint64_t)core.sprs[PPCCore::TBU] << 32) | core.sprs[PPCCore::TBL];
+	tb += instrs;
+	core.sprs[PPCCore::TBL] = tb;
+	core.sprs[PPCCore::TBU] = tb >> 32;
+	
+	core.sprs[PPCCore::DEC] = dec - instrs;
+	if (dec < instrs) {
+		core.triggerException(PPCCore::Decrementer);
+	}
+	
+	if (interrupt) {
+		checkInterrupts();
+	}
+	timer = 0;
+}
+
 void PPCProcessor::checkInterrupts() {
 	if (hardware->check_interrupts_ppc(index - 1)) {
 		core.triggerException(PPCCore::ExternalInterrupt);
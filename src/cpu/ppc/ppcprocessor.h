@@ -7,6 +7,7 @@
 #include "cpu/ppc/ppccodegenerator.h"
 #include "cpu/ppc/ppcmmu.h"
 #include "cpu/processor.h"
+#include "cpu/fastmem.h"
 #include "cpu/jit.h"
 
 #include "hardware/pi.h"
@@ -27,6 +28,7 @@ public:
 		checkWatchpoints(false, true, addr, sizeof(T));
 		#endif
 		
+		uint32_t vaddr = addr;
 		bool supervisor = !(core.msr & 0x4000);
 		if (!mmu.translate(&addr, MemoryAccess::DataRead, supervisor)) {
 			core.sprs[PPCCore::DAR] = addr;
@@ -39,6 +41,8 @@ public:
 		checkWatchpoints(false, false, addr, sizeof(T));
 		#endif
 		
+		mapFastmem(vaddr, addr, false);
+		
 		*value = physmem->read<T>(addr);
 		return true;
 	}
@@ -51,6 +55,7 @@ public:
 		
 		reservation->write(addr);
 		
+		uint32_t vaddr = addr;
 		bool supervisor = !(core.msr & 0x4000);
 		if (!mmu.translate(&addr, MemoryAccess::DataWrite, supervisor)) {
 			core.sprs[PPCCore::DAR] = addr;
@@ -63,6 +68,8 @@ public:
 		checkWatchpoints(true, false, addr, sizeof(T));
 		#endif
 		
+		mapFastmem(vaddr, addr, true);
+		
 		if (addr == (core.sprs[PPCCore::WPAR] & ~0x1F)) {
 			if (core.sprs[PPCCore::HID2] & 0x40000000) {
 				wg->write_data(value);
@@ -76,17 +83,32 @@ public:
 	
 	void copy(uint32_t dst, uint32_t src, uint32_t size);
 	
+	// Must be called when a segment register is changed. The old
+	// translations remain in use until the next block is executed,
+	// so that a context switch only flushes them once.
+	void invalidateSegments();
+	
 	void step();
+	void stepBlock();
 	void reset();
 	
+	#if WATCHPOINTS
+	void addWatchpoint(bool write, bool virt, uint32_t addr);
+	#endif
+	
 	PPCCore core;
 	PPCMMU mmu;
 	PPCReservation *reservation;
 	
 	JIT<PPCCodeGenerator, uint32_t> jit;
+	Fastmem fastmem;
+	
+	// Virtual address at which the JIT was entered last
+	uint32_t blockAddr;
 	
 	#if STATS
 	uint64_t instrsExecuted;
+	uint64_t instrsInterpreted;
 	#endif
 	
 	#if METRICS
@@ -94,11 +116,19 @@ public:
 	#endif
 	
 private:
-	void updateTimer();
+	int getFastmemContext();
+	void mapFastmem(uint32_t vaddr, uint32_t paddr, bool write);
+	
+	int interpret(uint32_t addr, int limit);
+	int getBlockLimit();
+	void updateTimer(int instrs);
+	void idle();
 	void checkDebugPoints();
 	void checkInterrupts();
+	void updateSegments();
 	
 	int timer;
+	bool segmentsModified;
 	
 	WGController *wg;
 	
@@ -14,6 +14,8 @@ public:
 	void write(uint32_t addr);
 	
 private:
+	friend class PPCCodeGenerator;
+	
 	void *owner;
 	uint32_t addr;
 };
@@ -64,10 +64,14 @@ void Processor::threadFunc(Processor *cpu) {
 
 void Processor::mainLoop() {
 	while (!paused && enabled) {
-		step();
+		stepBlock();
 	}
 }
 
+void Processor::stepBlock() {
+	step();
+}
+
 #if BREAKPOINTS
 void Processor::checkBreakpoints(uint32_t pc) {
 	if (isBreakpoint(pc)) {
@@ -120,6 +124,11 @@ bool Processor::isWatchpoint(bool write, bool virt, uint32_t addr, int length) {
 	return false;
 }
 
+bool Processor::hasWatchpoints() {
+	return !watchpoints[0][0].empty() || !watchpoints[0][1].empty() ||
+		!watchpoints[1][0].empty() || !watchpoints[1][1].empty();
+}
+
 void Processor::addWatchpoint(bool write, bool virt, uint32_t addr) {
 	watchpoints[write][virt].push_back(addr);
 }
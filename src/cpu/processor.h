@@ -30,6 +30,7 @@ public:
 	
 	virtual void reset() = 0;
 	virtual void step() = 0;
+	virtual void stepBlock();
 
 	#if BREAKPOINTS
 	bool isBreakpoint(uint32_t addr);
@@ -41,7 +42,8 @@ public:
 	
 	#if WATCHPOINTS
 	bool isWatchpoint(bool write, bool virt, uint32_t addr, int size);
-	void addWatchpoint(bool write, bool virt, uint32_t addr);
+	bool hasWatchpoints();
+	virtual void addWatchpoint(bool write, bool virt, uint32_t addr);
 	void removeWatchpoint(bool write, bool virt, uint32_t addr);
 	
 	std::vector<uint32_t> watchpoints[2][2];
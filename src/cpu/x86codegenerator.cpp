@@ -4,14 +4,35 @@
 #include <cstdlib>
 
 
+// A generator is created for every compiled page, so the
+// largest buffer is kept for the next one in the same thread
+static thread_local char *spareBuffer;
+static thread_local size_t spareCapacity;
+
+
 X86CodeGenerator::X86CodeGenerator(size_t size) {
-	buffer = (char *)malloc(size);
-	capacity = size;
+	if (spareBuffer && spareCapacity >= size) {
+		buffer = spareBuffer;
+		capacity = spareCapacity;
+		spareBuffer = nullptr;
+	}
+	else {
+		buffer = (char *)malloc(size);
+		capacity = size;
+	}
 	offset = 0;
+	length = 0;
 }
 
 X86CodeGenerator::~X86CodeGenerator() {
-	free(buffer);
+	if (capacity > spareCapacity || !spareBuffer) {
+		free(spareBuffer);
+		spareBuffer = buffer;
+		spareCapacity = capacity;
+	}
+	else {
+		free(buffer);
+	}
 }
 
 char *X86CodeGenerator::get() {
@@ -27,7 +48,11 @@ size_t X86CodeGenerator::tell() {
 }
 
 size_t X86CodeGenerator::size() {
-	return capacity;
+	return length;
+}
+
+std::vector<uint32_t> &X86CodeGenerator::getRelocations() {
+	return relocations;
 }
 
 void X86CodeGenerator::reserve(size_t size) {
@@ -35,6 +60,9 @@ void X86CodeGenerator::reserve(size_t size) {
 		capacity *= 2;
 		buffer = (char *)realloc(buffer, capacity);
 	}
+	if (offset + size > length) {
+		length = offset + size;
+	}
 }
 
 void X86CodeGenerator::u8(uint8_t value) {
@@ -59,8 +87,8 @@ bool X86CodeGenerator::isU8(uint32_t value) {
 }
 
 void X86CodeGenerator::displace(uint8_t mod, Register base, uint32_t offset) {
-	u8(mod | 0x80 | base);
-	if (base == RSP) {
+	u8(mod | 0x80 | (base & 7));
+	if ((base & 7) == RSP) {
 		u8(0x24);
 	}
 	u32(offset);
@@ -70,6 +98,12 @@ void X86CodeGenerator::rex() {
 	u8(0x48);
 }
 
+void X86CodeGenerator::rex(Register reg, Register base) {
+	if (reg >= R8 || base >= R8) {
+		u8(0x40 | ((reg & 8) >> 1) | ((base & 8) >> 3));
+	}
+}
+
 void X86CodeGenerator::ret() {
 	u8(0xC3);
 }
@@ -86,9 +120,14 @@ void X86CodeGenerator::popReg64(Register reg) {
 	u8(0x58 + reg);
 }
 
+void X86CodeGenerator::pushFlags() {
+	u8(0x9C);
+}
+
 void X86CodeGenerator::movReg32(Register dest, Register source) {
+	rex(source, dest);
 	u8(0x89);
-	u8(0xC0 | (source << 3) | dest);
+	u8(0xC0 | ((source & 7) << 3) | (dest & 7));
 }
 
 void X86CodeGenerator::movReg64(Register dest, Register source) {
@@ -109,8 +148,9 @@ void X86CodeGenerator::movImm64(Register dest, uint64_t value) {
 }
 
 void X86CodeGenerator::loadMem32(Register dest, Register base, uint32_t offset) {
+	rex(dest, base);
 	u8(0x8B);
-	displace(dest << 3, base, offset);
+	displace((dest & 7) << 3, base, offset);
 }
 
 void X86CodeGenerator::loadMem64(Register dest, Register base, uint32_t offset) {
@@ -119,7 +159,54 @@ void X86CodeGenerator::loadMem64(Register dest, Register base, uint32_t offset)
 	displace(dest << 3, base, offset);
 }
 
+void X86CodeGenerator::loadMem8(Register dest, Register base, uint32_t offset) {
+	rex(dest, base);
+	u8(0x0F);
+	u8(0xB6);
+	displace((dest & 7) << 3, base, offset);
+}
+
+void X86CodeGenerator::loadMem16(Register dest, Register base, uint32_t offset) {
+	rex(dest, base);
+	u8(0x0F);
+	u8(0xB7);
+	displace((dest & 7) << 3, base, offset);
+}
+
+void X86CodeGenerator::loadIndex64(Register dest, Register base, Register index) {
+	rex();
+	u8(0x8B);
+	u8((dest << 3) | RSP);
+	u8(0xC0 | (index << 3) | base);
+}
+
+void X86CodeGenerator::loadSingle(XMMRegister dest, Register base, uint32_t offset) {
+	sseMem(0xF3, 0x10, dest, base, offset);
+}
+
+void X86CodeGenerator::loadDouble(XMMRegister dest, Register base, uint32_t offset) {
+	sseMem(0xF2, 0x10, dest, base, offset);
+}
+
 void X86CodeGenerator::storeMem32(Register base, uint32_t offset, Register source) {
+	rex(source, base);
+	u8(0x89);
+	displace((source & 7) << 3, base, offset);
+}
+
+void X86CodeGenerator::storeMem64(Register base, uint32_t offset, Register source) {
+	rex();
+	u8(0x89);
+	displace(source << 3, base, offset);
+}
+
+void X86CodeGenerator::storeMem8(Register base, uint32_t offset, Register source) {
+	u8(0x88);
+	displace(source << 3, base, offset);
+}
+
+void X86CodeGenerator::storeMem16(Register base, uint32_t offset, Register source) {
+	u8(0x66);
 	u8(0x89);
 	displace(source << 3, base, offset);
 }
@@ -130,17 +217,89 @@ void X86CodeGenerator::storeMemImm32(Register base, uint32_t offset, uint32_t va
 	u32(value);
 }
 
+void X86CodeGenerator::storeSingle(Register base, uint32_t offset, XMMRegister source) {
+	sseMem(0xF3, 0x11, source, base, offset);
+}
+
+void X86CodeGenerator::storeDouble(Register base, uint32_t offset, XMMRegister source) {
+	sseMem(0xF2, 0x11, source, base, offset);
+}
+
+void X86CodeGenerator::movSingle(XMMRegister dest, XMMRegister source) {
+	sse(0xF3, 0x10, dest, source);
+}
+
+void X86CodeGenerator::movRegToXMM32(XMMRegister dest, Register source) {
+	sse(0x66, 0x6E, dest, source);
+}
+
+void X86CodeGenerator::movRegToXMM64(XMMRegister dest, Register source) {
+	u8(0x66);
+	rex();
+	u8(0x0F);
+	u8(0x6E);
+	u8(0xC0 | (dest << 3) | source);
+}
+
 void X86CodeGenerator::lea64(Register reg, Register base, uint32_t offset) {
 	rex();
 	u8(0x8D);
 	displace(reg << 3, base, offset);
 }
 
+void X86CodeGenerator::leaIndex32(Register reg, Register base, Register index) {
+	if (reg >= R8 || base >= R8 || index >= R8) {
+		u8(0x40 | ((reg & 8) >> 1) | ((index & 8) >> 2) | ((base & 8) >> 3));
+	}
+	u8(0x8D);
+	if ((base & 7) == RBP) {
+		u8(0x44 | ((reg & 7) << 3));
+		u8(((index & 7) << 3) | (base & 7));
+		u8(0);
+	}
+	else {
+		u8(0x04 | ((reg & 7) << 3));
+		u8(((index & 7) << 3) | (base & 7));
+	}
+}
+
+void X86CodeGenerator::leaRel64(Register reg, uint32_t offset) {
+	rex();
+	u8(0x8D);
+	u8(0x05 | (reg << 3));
+	u32(offset);
+}
+
+void X86CodeGenerator::swap16(Register reg) {
+	u8(0x66);
+	u8(0xC1);
+	u8(0xC0 + reg);
+	u8(8);
+}
+
 void X86CodeGenerator::swap32(Register reg) {
 	u8(0x0F);
 	u8(0xC8 + reg);
 }
 
+void X86CodeGenerator::swap64(Register reg) {
+	rex();
+	u8(0x0F);
+	u8(0xC8 + reg);
+}
+
+void X86CodeGenerator::signExtend16(Register reg) {
+	u8(0x0F);
+	u8(0xBF);
+	u8(0xC0 | (reg << 3) | reg);
+}
+
+void X86CodeGenerator::signExtend32(Register reg) {
+	rex();
+	u8(0x63);
+	u8(0xC0 | (reg << 3) | reg);
+}
+
 void X86CodeGenerator::addRegReg32(Register reg, Register other) {
 	u8(0x01);
 	u8(0xC0 | (other << 3) | reg);
@@ -157,6 +316,11 @@ void X86CodeGenerator::addRegImm64(Register reg, uint32_t value) {
 	addRegImm32(reg, value);
 }
 
+void X86CodeGenerator::addRegReg64(Register reg, Register other) {
+	rex();
+	addRegReg32(reg, other);
+}
+
 void X86CodeGenerator::addMemReg32(Register base, uint32_t offset, Register other) {
 	u8(0x01);
 	displace(other << 3, base, offset);
@@ -189,6 +353,11 @@ void X86CodeGenerator::subRegImm64(Register reg, uint32_t value) {
 	subRegImm32(reg, value);
 }
 
+void X86CodeGenerator::subRegMem32(Register reg, Register base, uint32_t offset) {
+	u8(0x2B);
+	displace(reg << 3, base, offset);
+}
+
 void X86CodeGenerator::adcRegReg32(Register reg, Register other) {
 	u8(0x11);
 	u8(0xC0 | (other << 3) | reg);
@@ -216,11 +385,21 @@ void X86CodeGenerator::mulReg32(Register reg) {
 	u8(0xE0 | reg);
 }
 
+void X86CodeGenerator::imulReg32(Register reg) {
+	u8(0xF7);
+	u8(0xE8 | reg);
+}
+
 void X86CodeGenerator::negReg32(Register reg) {
 	u8(0xF7);
 	u8(0xD8 | reg);
 }
 
+void X86CodeGenerator::negReg64(Register reg) {
+	rex();
+	negReg32(reg);
+}
+
 void X86CodeGenerator::decMem32(Register base, uint32_t offset) {
 	u8(0xFF);
 	displace(8, base, offset);
@@ -287,6 +466,16 @@ void X86CodeGenerator::sarImm32(Register reg, uint8_t bits) {
 	}
 }
 
+void X86CodeGenerator::shlImm64(Register reg, uint8_t bits) {
+	rex();
+	shlImm32(reg, bits);
+}
+
+void X86CodeGenerator::shrImm64(Register reg, uint8_t bits) {
+	rex();
+	shrImm32(reg, bits);
+}
+
 void X86CodeGenerator::rolImm32(Register reg, uint8_t bits) {
 	if (bits == 1) {
 		u8(0xD1);
@@ -379,11 +568,17 @@ void X86CodeGenerator::notReg32(Register reg) {
 }
 
 void X86CodeGenerator::callAbs(Register temp, uint64_t addr) {
+	relocations.push_back(offset + 2);
 	movImm64(temp, addr);
 	u8(0xFF);
 	u8(0xD0 | temp);
 }
 
+void X86CodeGenerator::callRel(uint32_t offset) {
+	u8(0xE8);
+	u32(offset);
+}
+
 void X86CodeGenerator::jumpRel(uint32_t offset) {
 	if (isU8(offset)) {
 		u8(0xEB);
@@ -395,22 +590,45 @@ void X86CodeGenerator::jumpRel(uint32_t offset) {
 	}
 }
 
+void X86CodeGenerator::jumpRel32(uint32_t offset) {
+	u8(0xE9);
+	u32(offset);
+}
+
 void X86CodeGenerator::jumpAbs(Register temp, uint64_t addr) {
+	relocations.push_back(offset + 2);
 	movImm64(temp, addr);
 	u8(0xFF);
 	u8(0xE0 | temp);
 }
 
+void X86CodeGenerator::jumpReg64(Register reg) {
+	u8(0xFF);
+	u8(0xE0 | reg);
+}
+
 void X86CodeGenerator::jumpIfCarry(uint8_t offset) {
 	u8(0x72);
 	u8(offset);
 }
 
+void X86CodeGenerator::jumpIfCarry32(uint32_t offset) {
+	u8(0x0F);
+	u8(0x82);
+	u32(offset);
+}
+
 void X86CodeGenerator::jumpIfNotCarry(uint8_t offset) {
 	u8(0x73);
 	u8(offset);
 }
 
+void X86CodeGenerator::jumpIfNotCarry32(uint32_t offset) {
+	u8(0x0F);
+	u8(0x83);
+	u32(offset);
+}
+
 void X86CodeGenerator::jumpIfOverflow(uint8_t offset) {
 	u8(0x70);
 	u8(offset);
@@ -451,11 +669,42 @@ void X86CodeGenerator::jumpIfNotEqual(uint8_t offset) {
 	u8(offset);
 }
 
+void X86CodeGenerator::jumpIfNotEqual32(uint32_t offset) {
+	u8(0x0F);
+	u8(0x85);
+	u32(offset);
+}
+
 void X86CodeGenerator::jumpIfBelow(uint8_t offset) {
 	u8(0x72);
 	u8(offset);
 }
 
+void X86CodeGenerator::jumpIfAbove32(uint32_t offset) {
+	u8(0x0F);
+	u8(0x87);
+	u32(offset);
+}
+
+void X86CodeGenerator::jumpIfEqual32(uint32_t offset) {
+	u8(0x0F);
+	u8(0x84);
+	u32(offset);
+}
+
+void X86CodeGenerator::jumpIf32(Condition cond, uint32_t offset) {
+	u8(0x0F);
+	u8(0x80 | cond);
+	u32(offset);
+}
+
+void X86CodeGenerator::moveIf32(Condition cond, Register dest, Register source) {
+	rex(dest, source);
+	u8(0x0F);
+	u8(0x40 | cond);
+	u8(0xC0 | ((dest & 7) << 3) | (source & 7));
+}
+
 void X86CodeGenerator::compareImm32(Register reg, uint32_t value) {
 	if (reg == RAX) {
 		u8(0x3D);
@@ -468,6 +717,21 @@ void X86CodeGenerator::compareImm32(Register reg, uint32_t value) {
 	}
 }
 
+void X86CodeGenerator::compareReg32(Register reg, Register other) {
+	u8(0x3B);
+	u8(0xC0 | (reg << 3) | other);
+}
+
+void X86CodeGenerator::compareMemReg32(Register base, uint32_t offset, Register reg) {
+	u8(0x39);
+	displace(reg << 3, base, offset);
+}
+
+void X86CodeGenerator::compareRegMem32(Register reg, Register base, uint32_t offset) {
+	u8(0x3B);
+	displace(reg << 3, base, offset);
+}
+
 void X86CodeGenerator::testReg32(Register a, Register b) {
 	u8(0x85);
 	u8(0xC0 | (b << 3) | a);
@@ -507,3 +771,101 @@ void X86CodeGenerator::bitTestResetReg32(Register reg, uint8_t bit) {
 	u8(0xF0 | reg);
 	u8(bit);
 }
+
+void X86CodeGenerator::bitScanReverse32(Register dest, Register source) {
+	u8(0x0F);
+	u8(0xBD);
+	u8(0xC0 | (dest << 3) | source);
+}
+
+void X86CodeGenerator::addSingle(XMMRegister reg, XMMRegister other) {
+	sse(0xF3, 0x58, reg, other);
+}
+
+void X86CodeGenerator::addDouble(XMMRegister reg, XMMRegister other) {
+	sse(0xF2, 0x58, reg, other);
+}
+
+void X86CodeGenerator::addPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x58, reg, other);
+}
+
+void X86CodeGenerator::subSingle(XMMRegister reg, XMMRegister other) {
+	sse(0xF3, 0x5C, reg, other);
+}
+
+void X86CodeGenerator::subDouble(XMMRegister reg, XMMRegister other) {
+	sse(0xF2, 0x5C, reg, other);
+}
+
+void X86CodeGenerator::subPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x5C, reg, other);
+}
+
+void X86CodeGenerator::mulSingle(XMMRegister reg, XMMRegister other) {
+	sse(0xF3, 0x59, reg, other);
+}
+
+void X86CodeGenerator::mulDouble(XMMRegister reg, XMMRegister other) {
+	sse(0xF2, 0x59, reg, other);
+}
+
+void X86CodeGenerator::mulPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x59, reg, other);
+}
+
+void X86CodeGenerator::divSingle(XMMRegister reg, XMMRegister other) {
+	sse(0xF3, 0x5E, reg, other);
+}
+
+void X86CodeGenerator::divDouble(XMMRegister reg, XMMRegister other) {
+	sse(0xF2, 0x5E, reg, other);
+}
+
+void X86CodeGenerator::divPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x5E, reg, other);
+}
+
+void X86CodeGenerator::andPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x54, reg, other);
+}
+
+void X86CodeGenerator::orPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x56, reg, other);
+}
+
+void X86CodeGenerator::xorPacked(XMMRegister reg, XMMRegister other) {
+	sse(0, 0x57, reg, other);
+}
+
+void X86CodeGenerator::shufflePacked(XMMRegister reg, XMMRegister other, uint8_t order) {
+	sse(0, 0xC6, reg, other);
+	u8(order);
+}
+
+void X86CodeGenerator::convertDoubleToSingle(XMMRegister dest, XMMRegister source) {
+	sse(0xF2, 0x5A, dest, source);
+}
+
+void X86CodeGenerator::truncateSingleToInt32(Register dest, XMMRegister source) {
+	sse(0xF3, 0x2C, dest, source);
+}
+
+void X86CodeGenerator::sse(uint8_t prefix, uint8_t opcode, int reg, int rm) {
+	if (prefix) {
+		u8(prefix);
+	}
+	u8(0x0F);
+	u8(opcode);
+	u8(0xC0 | (reg << 3) | rm);
+}
+
+void X86CodeGenerator::sseMem(uint8_t prefix, uint8_t opcode, XMMRegister reg, Register base, uint32_t offset) {
+	if (prefix) {
+		u8(prefix);
+	}
+	rex(RAX, base);
+	u8(0x0F);
+	u8(opcode);
+	displace(reg << 3, base, offset);
+}
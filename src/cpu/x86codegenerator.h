@@ -1,12 +1,25 @@
 
 #pragma once
 
+#include <vector>
+
 #include <cstdint>
 #include <cstddef>
 
 
 enum Register {
-	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI
+	RAX, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+	R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+enum XMMRegister {
+	XMM0, XMM1, XMM2, XMM3, XMM4, XMM5, XMM6, XMM7
+};
+
+// Condition codes, in encoding order. Flipping the lowest bit negates them.
+enum Condition {
+	Overflow, NotOverflow, Below, NotBelow, Equal, NotEqual, NotAbove, Above,
+	Sign, NotSign, Parity, NotParity, Less, NotLess, NotGreater, Greater
 };
 
 
@@ -21,6 +34,9 @@ public:
 	void seek(size_t pos);
 	size_t tell();
 	
+	// Offsets of the absolute addresses in callAbs and jumpAbs
+	std::vector<uint32_t> &getRelocations();
+	
 	void u8(uint8_t value); // 1 byte
 	void u32(uint32_t value); // 4 bytes
 	void u64(uint64_t value); // 8 bytes
@@ -29,6 +45,7 @@ public:
 	void displace(uint8_t mod, Register base, uint32_t offset); // 2, 3, 5 or 6 bytes
 	
 	void rex(); // 1 byte
+	void rex(Register reg, Register base); // 0 or 1 byte
 	
 	void ret(); // 1 byte
 	
@@ -36,6 +53,7 @@ public:
 	
 	void pushReg64(Register reg); // 1 byte
 	void popReg64(Register reg); // 1 byte
+	void pushFlags(); // 1 byte
 	
 	void movReg32(Register dest, Register source); // 2 bytes
 	void movReg64(Register dest, Register source); // 3 bytes
@@ -44,17 +62,42 @@ public:
 	
 	void loadMem32(Register dest, Register base, uint32_t offset); // 6+ bytes
 	void loadMem64(Register dest, Register base, uint32_t offset); // 7+ bytes
+	void loadMem8(Register dest, Register base, uint32_t offset); // 7+ bytes, zero extended
+	void loadMem16(Register dest, Register base, uint32_t offset); // 7+ bytes, zero extended
+	
+	void loadIndex64(Register dest, Register base, Register index); // 4 bytes, [base + index * 8]
+	
+	void loadSingle(XMMRegister dest, Register base, uint32_t offset); // 8+ bytes
+	void loadDouble(XMMRegister dest, Register base, uint32_t offset); // 8+ bytes, also loads two singles
 	
 	void storeMem32(Register base, uint32_t offset, Register source); // 6+ bytes
+	void storeMem64(Register base, uint32_t offset, Register source); // 7+ bytes
 	void storeMemImm32(Register base, uint32_t offset, uint32_t value); // 10+ bytes
+	void storeMem8(Register base, uint32_t offset, Register source); // 6+ bytes
+	void storeMem16(Register base, uint32_t offset, Register source); // 7+ bytes
+	
+	void storeSingle(Register base, uint32_t offset, XMMRegister source); // 8+ bytes
+	void storeDouble(Register base, uint32_t offset, XMMRegister source); // 8+ bytes, also stores two singles
+	
+	void movSingle(XMMRegister dest, XMMRegister source); // 4 bytes, only replaces the lowest lane
+	void movRegToXMM32(XMMRegister dest, Register source); // 4 bytes
+	void movRegToXMM64(XMMRegister dest, Register source); // 5 bytes
 	
 	void lea64(Register reg, Register base, uint32_t offset); // 7+ bytes
+	void leaIndex32(Register reg, Register base, Register index); // 3 to 5 bytes, [base + index]
+	void leaRel64(Register reg, uint32_t offset); // 7 bytes
 	
+	void swap16(Register reg); // 4 bytes
 	void swap32(Register reg); // 2 bytes
+	void swap64(Register reg); // 3 bytes
+	
+	void signExtend16(Register reg); // 3 bytes
+	void signExtend32(Register reg); // 3 bytes, to 64 bits
 	
 	void addRegReg32(Register reg, Register other); // 2 bytes
 	void addRegImm32(Register reg, uint32_t value); // 6 bytes
 	void addRegImm64(Register reg, uint32_t value); // 7 bytes
+	void addRegReg64(Register reg, Register other); // 3 bytes
 	void addMemReg32(Register base, uint32_t offset, Register other); // 6+ bytes
 	void addMemImm32(Register base, uint32_t offset, uint32_t value); // 10+ bytes
 	void addRegMem32(Register reg, Register base, uint32_t offset); // 6+ bytes
@@ -62,6 +105,7 @@ public:
 	void subRegReg32(Register reg, Register other); // 2 bytes
 	void subRegImm32(Register reg, uint32_t value); // 6 bytes
 	void subRegImm64(Register reg, uint32_t value); // 7 bytes
+	void subRegMem32(Register reg, Register base, uint32_t offset); // 6+ bytes
 	
 	void adcRegReg32(Register reg, Register other); // 2 bytes
 	void adcRegImm32(Register reg, uint32_t imm); // 6 bytes
@@ -70,8 +114,10 @@ public:
 	void sbbRegImm32(Register reg, uint32_t imm); // 6 bytes
 	
 	void mulReg32(Register reg); // 2 bytes
+	void imulReg32(Register reg); // 2 bytes
 	
 	void negReg32(Register reg); // 2 bytes
+	void negReg64(Register reg); // 3 bytes
 	
 	void decMem32(Register base, uint32_t offset); //6+ bytes
 	
@@ -86,6 +132,9 @@ public:
 	void shrImm32(Register reg, uint8_t bits); // 2 or 3 bytes
 	void sarImm32(Register reg, uint8_t bits); // 2 or 3 bytes
 	
+	void shlImm64(Register reg, uint8_t bits); // 3 or 4 bytes
+	void shrImm64(Register reg, uint8_t bits); // 3 or 4 bytes
+	
 	void rolImm32(Register reg, uint8_t bits); // 2 or 3 bytes
 	void rorImm32(Register reg, uint8_t bits); // 2 or 3 bytes
 	void rcrImm32(Register reg, uint8_t bits); // 2 or 3 bytes
@@ -105,12 +154,17 @@ public:
 	void notReg32(Register reg); // 2 bytes
 	
 	void callAbs(Register temp, uint64_t addr); // 12 bytes
+	void callRel(uint32_t offset); // 5 bytes
 	
 	void jumpRel(uint32_t offset); // 2 or 5 bytes
+	void jumpRel32(uint32_t offset); // 5 bytes
 	void jumpAbs(Register temp, uint64_t addr); // 12 bytes
+	void jumpReg64(Register reg); // 2 bytes
 	
 	void jumpIfCarry(uint8_t offset); // 2 bytes
+	void jumpIfCarry32(uint32_t offset); // 6 bytes
 	void jumpIfNotCarry(uint8_t offset); // 2 bytes
+	void jumpIfNotCarry32(uint32_t offset); // 6 bytes
 	
 	void jumpIfOverflow(uint8_t offset); // 2 bytes
 	void jumpIfNotOverflow(uint8_t offset); // 2 bytes
@@ -123,10 +177,20 @@ public:
 	
 	void jumpIfEqual(uint8_t offset); // 2 bytes
 	void jumpIfNotEqual(uint8_t offset); // 2 bytes
+	void jumpIfNotEqual32(uint32_t offset); // 6 bytes
 	
 	void jumpIfBelow(uint8_t offset); // 2 bytes
+	void jumpIfAbove32(uint32_t offset); // 6 bytes
+	
+	void jumpIfEqual32(uint32_t offset); // 6 bytes
+	
+	void jumpIf32(Condition cond, uint32_t offset); // 6 bytes
+	void moveIf32(Condition cond, Register dest, Register source); // 3 or 4 bytes
 	
 	void compareImm32(Register reg, uint32_t value); // 5 or 6 bytes
+	void compareReg32(Register reg, Register other); // 2 bytes
+	void compareMemReg32(Register base, uint32_t offset, Register reg); // 6+ bytes
+	void compareRegMem32(Register reg, Register base, uint32_t offset); // 6+ bytes
 	
 	void testReg32(Register a, Register b); // 2 bytes
 	
@@ -137,10 +201,43 @@ public:
 	void bitTestResetMem32(Register base, uint32_t offset, uint8_t bit); // 8+ bytes
 	void bitTestResetReg32(Register reg, uint8_t bit); // 4 bytes
 	
+	void bitScanReverse32(Register dest, Register source); // 3 bytes
+	
+	void addSingle(XMMRegister reg, XMMRegister other); // 4 bytes
+	void addDouble(XMMRegister reg, XMMRegister other); // 4 bytes
+	void addPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	
+	void subSingle(XMMRegister reg, XMMRegister other); // 4 bytes
+	void subDouble(XMMRegister reg, XMMRegister other); // 4 bytes
+	void subPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	
+	void mulSingle(XMMRegister reg, XMMRegister other); // 4 bytes
+	void mulDouble(XMMRegister reg, XMMRegister other); // 4 bytes
+	void mulPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	
+	void divSingle(XMMRegister reg, XMMRegister other); // 4 bytes
+	void divDouble(XMMRegister reg, XMMRegister other); // 4 bytes
+	void divPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	
+	void andPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	void orPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	void xorPacked(XMMRegister reg, XMMRegister other); // 3 bytes
+	
+	void shufflePacked(XMMRegister reg, XMMRegister other, uint8_t order); // 4 bytes
+	
+	void convertDoubleToSingle(XMMRegister dest, XMMRegister source); // 4 bytes
+	void truncateSingleToInt32(Register dest, XMMRegister source); // 4 bytes
+
 private:
 	void reserve(size_t size);
 	
+	void sse(uint8_t prefix, uint8_t opcode, int reg, int rm);
+	void sseMem(uint8_t prefix, uint8_t opcode, XMMRegister reg, Register base, uint32_t offset);
+	
 	char *buffer;
 	size_t offset;
+	size_t length;
 	size_t capacity;
+	
+	std::vector<uint32_t> relocations;
 };
@@ -745,6 +745,16 @@ void ARMDebugger::printStats() {
 		cpu->jit.instrSize, divide(cpu->jit.instrSize, cpu->jit.instrsCompiled)
 	);
 	Sys::out->write("    \n");
+	Sys::out->write("    ARM instrs executed by the interpreter:\n");
+	Sys::out->write(
+		"        Status register moves (mode change): %i\n",
+		cpu->fallbackInstrs[ARMCodeGenerator::StatusRegisterMove]
+	);
+	Sys::out->write(
+		"        Coprocessor transfers:               %i\n",
+		cpu->fallbackInstrs[ARMCodeGenerator::CoprocessorTransfer]
+	);
+	Sys::out->write("    \n");
 	Sys::out->write(
 		"    Thumb instrs executed:  %i\n",
 		cpu->thumb.instrsExecuted
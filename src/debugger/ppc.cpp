@@ -23,6 +23,10 @@ PPCDebugger::PPCDebugger(PhysicalMemory *physmem, PPCProcessor *cpu, int index)
 	this->physmem = physmem;
 	this->index = index;
 	this->cpu = cpu;
+	
+	cpu->jit.setSymbolizer([this](uint32_t addr) {
+		return formatPage(addr);
+	});
 }
 
 Processor *PPCDebugger::getProcessor() {
@@ -486,6 +490,21 @@ std::string PPCDebugger::formatAddress(uint32_t addr, ModuleList &modules) {
 	return StringUtils::format("%08X", addr);
 }
 
+// Names a compiled page for profilers. Pages are compiled when they
+// are entered, so the module is found through the entry address.
+std::string PPCDebugger::formatPage(uint32_t addr) {
+	std::string name = StringUtils::format("ppc%i %08X", index, addr);
+	
+	uint32_t pc = cpu->blockAddr & ~0xFFF;
+	uint32_t phys = pc;
+	bool supervisor = !(cpu->core.msr & 0x4000);
+	if (cpu->mmu.translate(&phys, MemoryAccess::Instruction, supervisor) && phys == addr) {
+		ModuleList modules = getModules();
+		name += " " + formatAddress(pc, modules);
+	}
+	return name;
+}
+
 PPCDebugger::ModuleList PPCDebugger::getModules() {
 	ModuleList modules;
 	
@@ -569,6 +588,10 @@ void PPCDebugger::printStats() {
 		"    Instructions executed (jit): %i (%i%%)\n", cpu->jit.instrsExecuted,
 		percentage(cpu->jit.instrsExecuted, cpu->instrsExecuted)
 	);
+	Sys::out->write(
+		"    Instructions interpreted:    %i (%i%%)\n", cpu->instrsInterpreted,
+		percentage(cpu->instrsInterpreted, cpu->instrsExecuted)
+	);
 	Sys::out->write(
 		"    Instructions compiled (jit): %i (avg usage: %i)\n", cpu->jit.instrsCompiled,
 		divide(cpu->jit.instrsExecuted, cpu->jit.instrsCompiled)
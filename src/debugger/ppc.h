@@ -53,6 +53,7 @@ private:
 	void printThreadWait(uint32_t thread);
 	
 	std::string formatAddress(uint32_t addr, ModuleList &modules);
+	std::string formatPage(uint32_t addr);
 	ModuleList getModules();
 	
 	PhysicalMemory *physmem;
@@ -2,10 +2,24 @@
 #include "hardware.h"
 #include "emulator.h"
 
+#include "common/exceptions.h"
 #include "common/logger.h"
 #include "common/buffer.h"
 #include "common/fileutils.h"
 
+#include <algorithm>
+#include <chrono>
+
+#include <cstring>
+
+
+// Idle processors assume that a tick or instruction takes about this many
+// nanoseconds, and never sleep longer than the timeout without checking
+// their interrupts again.
+static const uint64_t IdleTickTime = 100;
+static const uint64_t IdleInstrTime = 1;
+static const uint64_t IdleTimeout = 1000000;
+
 
 Hardware::Hardware(Emulator *emulator) :
 	latte(emulator),
@@ -15,20 +29,56 @@ Hardware::Hardware(Emulator *emulator) :
 	aes(&emulator->physmem),
 	sha(&emulator->physmem),
 	nand(&emulator->physmem),
-	gpu(&emulator->physmem),
+	gpu(&emulator->physmem, &scheduler),
+	ai(&scheduler),
 	
-	ohci00(&emulator->physmem, 0),
-	ohci01(&emulator->physmem, 1),
-	ohci1(&emulator->physmem, 2),
-	ohci2(&emulator->physmem, 3),
+	ohci00(&emulator->physmem, &scheduler, 0),
+	ohci01(&emulator->physmem, &scheduler, 1),
+	ohci1(&emulator->physmem, &scheduler, 2),
+	ohci2(&emulator->physmem, &scheduler, 3),
 	
 	sdio0(&emulator->physmem, SDIOController::TYPE_SD),
 	sdio1(&emulator->physmem, SDIOController::TYPE_WIFI),
 	sdio2(&emulator->physmem, SDIOController::TYPE_MLC),
 	sdio3(&emulator->physmem, SDIOController::TYPE_UNK)
-	{}
+{
+	idle_waiters = 0;
+	wakeups = 0;
+	
+	regionCount = 0;
+	memset(pages, 0, sizeof(pages));
+	
+	map32(0xC000000, 0xC100000, &pi);
+	map32(0xC200000, 0xC280000, &gpu);
+	map16(0xC280000, 0xC2C0000, &dsp);
+	map32(0xD000000, 0xD001000, &latte);
+	map32(0xD006800, 0xD006C00, &exi, true);
+	map32(0xD006C00, 0xD006E00, &ai);
+	map32(0xD010000, 0xD020000, &nand);
+	map32(0xD020000, 0xD030000, &aes, true);
+	map32(0xD030000, 0xD040000, &sha, true);
+	map32(0xD040000, 0xD050000, &ehci0, true);
+	map32(0xD050000, 0xD060000, &ohci00, true);
+	map32(0xD060000, 0xD070000, &ohci01, true);
+	map32(0xD070000, 0xD080000, &sdio0, true);
+	map32(0xD080000, 0xD090000, &sdio1, true);
+	map32(0xD0B0000, 0xD0B4000, &ahmn);
+	map16(0xD0B4000, 0xD0B4800, &mem);
+	map32(0xD100000, 0xD110000, &sdio2, true);
+	map32(0xD110000, 0xD120000, &sdio3, true);
+	map32(0xD120000, 0xD130000, &ehci1, true);
+	map32(0xD130000, 0xD140000, &ohci1, true);
+	map32(0xD140000, 0xD150000, &ehci2, true);
+	map32(0xD150000, 0xD160000, &ohci2, true);
+	map32(0xD160000, 0xD170000, &ahci);
+	
+	// Bit 23 is not ignored in this range
+	map32(0xD0000000, 0xD2000000, &gpu);
+}
 
 void Hardware::reset() {
+	scheduler.reset();
+	
 	latte.reset();
 	pi.reset();
 	
@@ -59,33 +109,54 @@ void Hardware::reset() {
 	sdio3.reset();
 }
 
+Hardware::Region *Hardware::map(uint32_t start, uint32_t end, void *device, bool relative) {
+	if (regionCount == MaxRegions) {
+		runtime_error("Too many hardware regions");
+	}
+	
+	Region *region = &regions[regionCount++];
+	memset(region, 0, sizeof(Region));
+	region->start = start;
+	region->end = end;
+	region->base = relative ? start : 0;
+	region->device = device;
+	
+	for (uint32_t page = start & ~0xFFF; page < end; page += 0x1000) {
+		uint32_t key;
+		Region **next = getPage(page, &key);
+		while (*next) {
+			next = &(*next)->next;
+		}
+		*next = region;
+	}
+	return region;
+}
+
+Hardware::Region **Hardware::getPage(uint32_t addr, uint32_t *key) {
+	if (addr >> 28) {
+		*key = addr;
+		return &pages[0x2000 | ((addr >> 12) & 0x1FFF)];
+	}
+	*key = addr & ~0x800000;
+	return &pages[(*key >> 12) & 0x1FFF];
+}
+
+Hardware::Region *Hardware::lookup(uint32_t addr, uint32_t *key) {
+	for (Region *region = *getPage(addr, key); region; region = region->next) {
+		if (region->start <= *key && *key < region->end) {
+			return region;
+		}
+	}
+	return nullptr;
+}
+
 template <>
 uint32_t Hardware::read(uint32_t addr) {
-	uint32_t masked = addr & ~0x800000;
-	
-	if (0xC000000 <= masked && masked < 0xC100000) return pi.read(masked);
-	if (0xC200000 <= masked && masked < 0xC280000) return gpu.read(masked);
-	if (0xD000000 <= masked && masked < 0xD001000) return latte.read(masked);
-	if (0xD006800 <= masked && masked < 0xD006C00) return exi.read(masked - 0xD006800);
-	if (0xD006C00 <= masked && masked < 0xD006E00) return ai.read(masked);
-	if (0xD010000 <= masked && masked < 0xD020000) return nand.read(masked);
-	if (0xD020000 <= masked && masked < 0xD030000) return aes.read(masked - 0xD020000);
-	if (0xD030000 <= masked && masked < 0xD040000) return sha.read(masked - 0xD030000);
-	if (0xD040000 <= masked && masked < 0xD050000) return ehci0.read(masked - 0xD040000);
-	if (0xD050000 <= masked && masked < 0xD060000) return ohci00.read(masked - 0xD050000);
-	if (0xD060000 <= masked && masked < 0xD070000) return ohci01.read(masked - 0xD060000);
-	if (0xD070000 <= masked && masked < 0xD080000) return sdio0.read(masked - 0xD070000);
-	if (0xD080000 <= masked && masked < 0xD090000) return sdio1.read(masked - 0xD080000);
-	if (0xD0B0000 <= masked && masked < 0xD0B4000) return ahmn.read(masked);
-	if (0xD100000 <= masked && masked < 0xD110000) return sdio2.read(masked - 0xD100000);
-	if (0xD110000 <= masked && masked < 0xD120000) return sdio3.read(masked - 0xD110000);
-	if (0xD120000 <= masked && masked < 0xD130000) return ehci1.read(masked - 0xD120000);
-	if (0xD130000 <= masked && masked < 0xD140000) return ohci1.read(masked - 0xD130000);
-	if (0xD140000 <= masked && masked < 0xD150000) return ehci2.read(masked - 0xD140000);
-	if (0xD150000 <= masked && masked < 0xD160000) return ohci2.read(masked - 0xD150000);
-	if (0xD160000 <= masked && masked < 0xD170000) return ahci.read(masked);
-	
-	if (0xD0000000 <= addr && addr < 0xD2000000) return gpu.read(addr);
+	uint32_t key;
+	Region *region = lookup(addr, &key);
+	if (region && region->read32) {
+		return region->read32(region->device, key - region->base);
+	}
 	
 	Logger::warning("Unknown physical memory read: 0x%08X", addr);
 	return 0;
@@ -93,32 +164,13 @@ uint32_t Hardware::read(uint32_t addr) {
 
 template <>
 void Hardware::write(uint32_t addr, uint32_t value) {
-	uint32_t masked = addr & ~0x800000;
-	
-	if (0xC000000 <= masked && masked < 0xC100000) pi.write(masked, value);
-	else if (0xC200000 <= masked && masked < 0xC280000) gpu.write(masked, value);
-	else if (0xD000000 <= masked && masked < 0xD001000) latte.write(masked, value);
-	else if (0xD006800 <= masked && masked < 0xD006C00) exi.write(masked - 0xD006800, value);
-	else if (0xD006C00 <= masked && masked < 0xD006E00) ai.write(masked, value);
-	else if (0xD010000 <= masked && masked < 0xD020000) nand.write(masked, value);
-	else if (0xD020000 <= masked && masked < 0xD030000) aes.write(masked - 0xD020000, value);
-	else if (0xD030000 <= masked && masked < 0xD040000) sha.write(masked - 0xD030000, value);
-	else if (0xD040000 <= masked && masked < 0xD050000) ehci0.write(masked - 0xD040000, value);
-	else if (0xD050000 <= masked && masked < 0xD060000) ohci00.write(masked - 0xD050000, value);
-	else if (0xD060000 <= masked && masked < 0xD070000) ohci01.write(masked - 0xD060000, value);
-	else if (0xD070000 <= masked && masked < 0xD080000) sdio0.write(masked - 0xD070000, value);
-	else if (0xD080000 <= masked && masked < 0xD090000) sdio1.write(masked - 0xD080000, value);
-	else if (0xD0B0000 <= masked && masked < 0xD0B4000) ahmn.write(masked, value);
-	else if (0xD100000 <= masked && masked < 0xD110000) sdio2.write(masked - 0xD100000, value);
-	else if (0xD110000 <= masked && masked < 0xD120000) sdio3.write(masked - 0xD110000, value);
-	else if (0xD120000 <= masked && masked < 0xD130000) ehci1.write(masked - 0xD120000, value);
-	else if (0xD130000 <= masked && masked < 0xD140000) ohci1.write(masked - 0xD130000, value);
-	else if (0xD140000 <= masked && masked < 0xD150000) ehci2.write(masked - 0xD140000, value);
-	else if (0xD150000 <= masked && masked < 0xD160000) ohci2.write(masked - 0xD150000, value);
-	else if (0xD160000 <= masked && masked < 0xD170000) ahci.write(masked, value);
-	
-	else if (0xD0000000 <= addr && addr < 0xD2000000) gpu.write(addr, value);
+	wake();
 	
+	uint32_t key;
+	Region *region = lookup(addr, &key);
+	if (region && region->write32) {
+		region->write32(region->device, key - region->base, value);
+	}
 	else {
 		Logger::warning("Unknown physical memory write: 0x%08X (0x%08X)", addr, value);
 	}
@@ -126,10 +178,11 @@ void Hardware::write(uint32_t addr, uint32_t value) {
 
 template <>
 uint16_t Hardware::read(uint32_t addr) {
-	uint32_t masked = addr & ~0x800000;
-	
-	if (0xC280000 <= masked && masked < 0xC2C0000) return dsp.read(masked);
-	if (0xD0B4000 <= masked && masked < 0xD0B4800) return mem.read(masked);
+	uint32_t key;
+	Region *region = lookup(addr, &key);
+	if (region && region->read16) {
+		return region->read16(region->device, key - region->base);
+	}
 	
 	Logger::warning("Unknown physical memory read: 0x%08X", addr);
 	return 0;
@@ -137,26 +190,25 @@ uint16_t Hardware::read(uint32_t addr) {
 
 template <>
 void Hardware::write(uint32_t addr, uint16_t value) {
-	uint32_t masked = addr & ~0x800000;
+	wake();
 	
-	if (0xC280000 <= masked && masked < 0xC2C0000) dsp.write(masked, value);
-	else if (0xD0B4000 <= masked && masked < 0xD0B4800) mem.write(masked, value);
+	uint32_t key;
+	Region *region = lookup(addr, &key);
+	if (region && region->write16) {
+		region->write16(region->device, key - region->base, value);
+	}
 	else {
 		Logger::warning("Unknown physical memory write: 0x%08X (0x%04X)", addr, value);
 	}
 }
 
 void Hardware::update() {
-	ai.update();
+	scheduler.advance(1);
+	
 	dsp.update();
 	gpu.update();
 	latte.update();
 	
-	ohci00.update();
-	ohci01.update();
-	ohci1.update();
-	ohci2.update();
-	
 	if (nand.check_interrupts()) latte.irq_arm.intsr_all |= 1 << 1;
 	if (aes.check_interrupts()) latte.irq_arm.intsr_all |= 1 << 2;
 	if (sha.check_interrupts()) latte.irq_arm.intsr_all |= 1 << 3;
@@ -176,6 +228,80 @@ void Hardware::update() {
 	for (int i = 0; i < 3; i++) {
 		pi.set_irq(i, 24, latte.irq_ppc[i].check_interrupts());
 	}
+	
+	if (idle_waiters) {
+		for (int i = 0; i < 3; i++) {
+			if (pi.check_interrupts(i)) {
+				wake();
+				break;
+			}
+		}
+	}
+}
+
+// Skips straight to the next event that may interrupt the ARM. Events
+// for the PPC are not skipped, because the PPC keeps running in real
+// time, so until they are due the ARM waits for a device access.
+void Hardware::idle_arm() {
+	uint64_t delay = scheduler.getDelay(Scheduler::ARM);
+	uint64_t delay_ppc = scheduler.getDelay(Scheduler::PPC);
+	
+	if (delay != UINT64_MAX && delay <= delay_ppc) {
+		if (delay > 1) {
+			scheduler.advance(delay - 1);
+		}
+	}
+	else {
+		uint64_t limit = std::min(delay_ppc, IdleTimeout / IdleTickTime);
+		uint64_t generation = wakeups;
+		
+		auto start = std::chrono::steady_clock::now();
+		wait(limit * IdleTickTime, [&] { return wakeups != generation; });
+		auto elapsed = std::chrono::steady_clock::now() - start;
+		
+		uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		uint64_t ticks = std::min(time / IdleTickTime, limit);
+		if (ticks > 1) {
+			scheduler.advance(ticks - 1);
+		}
+	}
+	update();
+}
+
+// Returns true if an interrupt arrived before the given number of
+// instructions would have been executed. The number is updated to the
+// instructions that passed, which never goes beyond the next event that
+// may interrupt the PPC. Other events wake it up through update().
+bool Hardware::idle_ppc(int core, uint32_t *instrs) {
+	uint64_t limit = std::min<uint64_t>(*instrs, IdleTimeout / IdleInstrTime);
+	uint64_t delay = scheduler.getDelay(Scheduler::PPC);
+	if (delay < limit * IdleInstrTime / IdleTickTime) {
+		limit = delay * IdleTickTime / IdleInstrTime;
+	}
+	
+	auto start = std::chrono::steady_clock::now();
+	bool result = wait(limit * IdleInstrTime, [&] { return check_interrupts_ppc(core); });
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	
+	uint64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+	*instrs = std::min(time / IdleInstrTime, limit);
+	return result;
+}
+
+bool Hardware::wait(uint64_t time, std::function<bool()> condition) {
+	std::unique_lock<std::mutex> lock(idle_mutex);
+	idle_waiters++;
+	bool result = idle_cond.wait_for(lock, std::chrono::nanoseconds(time), condition);
+	idle_waiters--;
+	return result;
+}
+
+void Hardware::wake() {
+	if (idle_waiters) {
+		std::lock_guard<std::mutex> lock(idle_mutex);
+		wakeups++;
+		idle_cond.notify_all();
+	}
 }
 
 bool Hardware::check_interrupts_arm() {
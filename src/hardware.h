@@ -14,11 +14,17 @@
 #include "hardware/nand.h"
 #include "hardware/ohci.h"
 #include "hardware/pi.h"
+#include "hardware/scheduler.h"
 #include "hardware/sdio.h"
 #include "hardware/sha.h"
 
 #include "common/logger.h"
 
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <mutex>
+
 
 class Emulator;
 
@@ -40,8 +46,16 @@ public:
 	void reset();
 	void update();
 	
+	// Sleep instead of spinning while a processor waits for an interrupt
+	void idle_arm();
+	bool idle_ppc(int core, uint32_t *instrs);
+	void wake();
+	
 	bool check_interrupts_arm();
 	bool check_interrupts_ppc(int core);
+	
+	// Must be constructed before the devices
+	Scheduler scheduler;
 
 	LatteController latte;
 	PIController pi;
@@ -71,6 +85,67 @@ public:
 	SDIOController sdio1;
 	SDIOController sdio2;
 	SDIOController sdio3;
+
+private:
+	// A range of device registers. Accesses of other widths are unknown.
+	struct Region {
+		uint32_t start;
+		uint32_t end;
+		uint32_t base;
+		void *device;
+		
+		uint32_t (*read32)(void *device, uint32_t addr);
+		void (*write32)(void *device, uint32_t addr, uint32_t value);
+		uint16_t (*read16)(void *device, uint32_t addr);
+		void (*write16)(void *device, uint32_t addr, uint16_t value);
+		
+		// Regions that share the same page
+		Region *next;
+	};
+	
+	static const int MaxRegions = 32;
+	
+	// If relative is true, the device receives the offset
+	// from the start of the range instead of the address
+	template <class T>
+	void map32(uint32_t start, uint32_t end, T *device, bool relative = false) {
+		Region *region = map(start, end, device, relative);
+		region->read32 = [](void *device, uint32_t addr) -> uint32_t {
+			return ((T *)device)->read(addr);
+		};
+		region->write32 = [](void *device, uint32_t addr, uint32_t value) {
+			((T *)device)->write(addr, value);
+		};
+	}
+	
+	template <class T>
+	void map16(uint32_t start, uint32_t end, T *device, bool relative = false) {
+		Region *region = map(start, end, device, relative);
+		region->read16 = [](void *device, uint32_t addr) -> uint16_t {
+			return ((T *)device)->read(addr);
+		};
+		region->write16 = [](void *device, uint32_t addr, uint16_t value) {
+			((T *)device)->write(addr, value);
+		};
+	}
+	
+	Region *map(uint32_t start, uint32_t end, void *device, bool relative);
+	Region *lookup(uint32_t addr, uint32_t *key);
+	Region **getPage(uint32_t addr, uint32_t *key);
+	
+	bool wait(uint64_t time, std::function<bool()> condition);
+	
+	Region regions[MaxRegions];
+	int regionCount;
+	
+	// The register space at 0xC000000, where bit 23 is ignored,
+	// followed by the range at 0xD0000000, both in 4KB pages
+	Region *pages[0x4000];
+	
+	std::mutex idle_mutex;
+	std::condition_variable idle_cond;
+	std::atomic<int> idle_waiters;
+	std::atomic<uint64_t> wakeups;
 };
 
 
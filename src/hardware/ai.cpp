@@ -3,29 +3,33 @@
 
 #include "common/logger.h"
 
+#include <algorithm>
+
+AIController::AIController(Scheduler *scheduler) {
+	this->scheduler = scheduler;
+}
+
 void AIController::reset() {
-	timer = 0;
-	
 	control = 0;
 	volume = 0;
+	
 	samples = 0;
+	samples_start = scheduler->getTicks();
 }
 
-void AIController::update() {
-	int limit = control & 0x40 ? 60 : 40;
-	
-	timer++;
-	if (timer == limit) {
-		samples++;
-		timer = 0;
-	}
+uint32_t AIController::get_rate() {
+	return control & 0x40 ? 60 : 40;
+}
+
+uint32_t AIController::get_samples() {
+	return samples + (scheduler->getTicks() - samples_start) / get_rate();
 }
 
 uint32_t AIController::read(uint32_t addr) {
 	switch (addr) {
 		case AI_CONTROL: return control;
 		case AI_VOLUME: return volume;
-		case AI_AISCNT: return samples;
+		case AI_AISCNT: return get_samples();
 	}
 	Logger::warning("Unknown ai read: 0x%X", addr);
 	return 0;
@@ -33,10 +37,15 @@ uint32_t AIController::read(uint32_t addr) {
 
 void AIController::write(uint32_t addr, uint32_t value) {
 	if (addr == AI_CONTROL) {
+		// The counter continues at the new rate, but keeps
+		// the progress towards the next sample
+		uint64_t ticks = scheduler->getTicks();
+		uint64_t progress = (ticks - samples_start) % get_rate();
+		
+		samples = value & 0x20 ? 0 : get_samples();
 		control = value;
-		if (value & 0x20) {
-			samples = 0;
-		}
+		
+		samples_start = ticks - std::min<uint64_t>(progress, get_rate() - 1);
 	}
 	else if (addr == AI_VOLUME) volume = value;
 	else {
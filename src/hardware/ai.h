@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include "hardware/scheduler.h"
+
 #include <cstdint>
 
 class AIController {
@@ -12,16 +14,23 @@ public:
 		AI_AIIT = 0xD006C0C
 	};
 	
+	AIController(Scheduler *scheduler);
+	
 	void reset();
-	void update();
 	
 	uint32_t read(uint32_t addr);
 	void write(uint32_t addr, uint32_t value);
 	
 private:
-	int timer;
+	// The sample counter is derived from the scheduler ticks
+	uint32_t get_samples();
+	uint32_t get_rate();
+	
+	Scheduler *scheduler;
 	
 	uint32_t control;
 	uint32_t volume;
+	
 	uint32_t samples;
+	uint64_t samples_start;
 };
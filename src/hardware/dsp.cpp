@@ -12,13 +12,20 @@ DSPController::DSPController(Emulator *emulator) {
 
 void DSPController::reset() {
 	int_enabled = false;
+	ticks = 0;
 	
 	interpreter->reset();
 }
 
+// The DSP executes one instruction per tick, but the instructions
+// are executed in blocks once enough ticks have passed
 void DSPController::update() {
 	if (interpreter->isEnabled() && !interpreter->isPaused()) {
-		interpreter->step();
+		if (++ticks >= DSPInterpreter::BlockLimit) {
+			while (ticks > 0 && interpreter->isEnabled() && !interpreter->isPaused()) {
+				ticks -= interpreter->execute(ticks);
+			}
+		}
 	}
 }
 
@@ -32,6 +32,9 @@ public:
 private:
 	DSPInterpreter *interpreter;
 	
+	// Ticks for which the DSP has not executed an instruction yet
+	int ticks;
+	
 	bool int_status;
 	bool int_enabled;
 };
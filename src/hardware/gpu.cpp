@@ -518,11 +518,14 @@ HDPHandle *HDPController::find_handle(uint32_t addr) {
 }
 
 
-GPUController::GPUController(PhysicalMemory *physmem) :
+GPUController::GPUController(PhysicalMemory *physmem, Scheduler *scheduler) :
 	cp(physmem),
 	dma(physmem)
 {
 	this->physmem = physmem;
+	this->scheduler = scheduler;
+	
+	vsync_event = scheduler->add([this] { trigger_vsync(); }, Scheduler::PPC);
 }
 
 void GPUController::reset() {
@@ -546,6 +549,8 @@ void GPUController::reset() {
 	cp.reset();
 	dma.reset();
 	hdp.reset();
+	
+	scheduler->schedule(vsync_event, 35000);
 }
 
 void GPUController::trigger_irq(uint32_t type, uint32_t data1, uint32_t data2, uint32_t data3) {
@@ -557,14 +562,13 @@ void GPUController::trigger_irq(uint32_t type, uint32_t data1, uint32_t data2, u
 	physmem->write<uint32_t>(ih_rb_wptr_addr, pos + 16);
 }
 
+void GPUController::trigger_vsync() {
+	if (dc0.crtc_interrupt_control & 0x01000000) trigger_irq(2, 3, 0, 0);
+	if (dc1.crtc_interrupt_control & 0x01000000) trigger_irq(6, 3, 0, 0);
+	scheduler->schedule(vsync_event, 35000);
+}
+
 void GPUController::update() {
-	timer++;
-	if (timer == 35000) { // Trigger vsync
-		if (dc0.crtc_interrupt_control & 0x01000000) trigger_irq(2, 3, 0, 0);
-		if (dc1.crtc_interrupt_control & 0x01000000) trigger_irq(6, 3, 0, 0);
-		timer = 0;
-	}
-	
 	if (dma.check_interrupts()) {
 		trigger_irq(0xE0, 0, 0, 0);
 	}
@@ -1,6 +1,8 @@
 
 #pragma once
 
+#include "hardware/scheduler.h"
+
 #include <vector>
 
 #include <cstdint>
@@ -338,7 +340,7 @@ public:
 		GPU_TILING_END = 0xD2000000
 	};
 	
-	GPUController(PhysicalMemory *physmem);
+	GPUController(PhysicalMemory *physmem, Scheduler *scheduler);
 	
 	void reset();
 	void update();
@@ -350,8 +352,12 @@ public:
 	
 private:
 	void trigger_irq(uint32_t type, uint32_t data1, uint32_t data2, uint32_t data3);
+	void trigger_vsync();
 
 	PhysicalMemory *physmem;
+	Scheduler *scheduler;
+	
+	int vsync_event;
 	
 	DCController dc0;
 	DCController dc1;
@@ -372,6 +378,4 @@ private:
 	
 	uint32_t gb_tiling_config;
 	uint32_t cc_rb_backend_disable;
-	
-	uint32_t timer;
 };
@@ -39,6 +39,12 @@ LatteController::LatteController(Emulator *emulator) :
 {
 	this->emulator = emulator;
 	this->physmem = &emulator->physmem;
+	this->scheduler = &emulator->hardware.scheduler;
+	
+	alarm_event = scheduler->add([this] {
+		irq_arm.intsr_all |= 1 << 0;
+		schedule_alarm();
+	}, Scheduler::ARM);
 	
 	memset(iv, 0, sizeof(iv));
 	
@@ -50,7 +56,7 @@ LatteController::LatteController(Emulator *emulator) :
 }
 
 void LatteController::reset() {
-	timer = 0;
+	set_timer(0);
 	alarm = 0;
 	wdgcfg = 0;
 	dbgintsts = 0;
@@ -103,11 +109,29 @@ void LatteController::reset() {
 	for (int i = 0; i < 3; i++) {
 		ipc[i].reset();
 	}
+	
+	schedule_alarm();
+}
+
+uint32_t LatteController::get_timer() {
+	return scheduler->getTicks() - timer_start;
+}
+
+void LatteController::set_timer(uint32_t value) {
+	timer_start = scheduler->getTicks() - value;
+}
+
+void LatteController::schedule_alarm() {
+	uint64_t delay = (uint32_t)(alarm - get_timer());
+	if (delay == 0) {
+		delay = 1ull << 32;
+	}
+	scheduler->schedule(alarm_event, delay);
 }
 
 uint32_t LatteController::read(uint32_t addr) {
 	switch (addr) {
-		case LT_TIMER: return timer;
+		case LT_TIMER: return get_timer();
 		case LT_WDG_CFG: return wdgcfg;
 		case LT_DBG_INT_STATUS: return dbgintsts;
 		case LT_SRNPROT: return srnprot;
@@ -167,8 +191,14 @@ uint32_t LatteController::read(uint32_t addr) {
 }
 
 void LatteController::write(uint32_t addr, uint32_t value) {
-	if (addr == LT_TIMER) timer = value;
-	else if (addr == LT_ALARM) alarm = value;
+	if (addr == LT_TIMER) {
+		set_timer(value);
+		schedule_alarm();
+	}
+	else if (addr == LT_ALARM) {
+		alarm = value;
+		schedule_alarm();
+	}
 	else if (addr == LT_WDG_CFG) wdgcfg = value;
 	else if (addr == LT_DMA_INT_STATUS) {}
 	else if (addr == LT_CPU_INT_STATUS) {}
@@ -290,12 +320,9 @@ void LatteController::reset_ppc() {
 	}
 }
 
+// The GPIO interrupts are levels of input pins that may change through
+// any register or I2C write, so they are sampled on every update
 void LatteController::update() {
-	timer++;
-	if (timer == alarm) {
-		irq_arm.intsr_all |= 1 << 0;
-	}
-	
 	gpio.update();
 	gpio2.update();
 	
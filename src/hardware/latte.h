@@ -5,6 +5,7 @@
 #include "hardware/ipc.h"
 #include "hardware/irq.h"
 #include "hardware/gpio.h"
+#include "hardware/scheduler.h"
 
 #include "common/buffer.h"
 
@@ -129,8 +130,14 @@ private:
 	void start_ppc();
 	void reset_ppc();
 	
-	uint32_t timer;
+	uint32_t get_timer();
+	void set_timer(uint32_t value);
+	void schedule_alarm();
+	
+	// The timer is derived from the scheduler ticks
+	uint64_t timer_start;
 	uint32_t alarm;
+	int alarm_event;
 	uint32_t wdgcfg;
 	uint32_t dbgintsts;
 	uint32_t dbginten;
@@ -186,4 +193,5 @@ private:
 	
 	Emulator *emulator;
 	PhysicalMemory *physmem;
+	Scheduler *scheduler;
 };
@@ -57,9 +57,12 @@ const char *OHCIStateNames[] = {
 	"USBReset", "USBResume", "USBOperational", "USBSuspend"
 };
 
-OHCIController::OHCIController(PhysicalMemory *physmem, int index) {
+OHCIController::OHCIController(PhysicalMemory *physmem, Scheduler *scheduler, int index) {
 	this->physmem = physmem;
+	this->scheduler = scheduler;
 	this->index = index;
+	
+	frame_event = scheduler->add([this] { process_frame(); }, Scheduler::ARM);
 }
 
 void OHCIController::reset() {
@@ -71,13 +74,13 @@ void OHCIController::reset() {
 	bulk_head_ed = 0;
 	done_head = 0;
 	fminterval = 0x2EDF;
-	fmremaining = 0;
 	fmnumber = 0;
 	periodic_start = 0;
 	descriptor_a = (1 << 24) | 3;
 	descriptor_b = 0;
 	
 	state = USBReset;
+	scheduler->cancel(frame_event);
 	
 	for (int i = 0; i < 4; i++) {
 		ports[i].reset();
@@ -117,7 +120,10 @@ void OHCIController::write(uint32_t addr, uint32_t value) {
 		if (state != this->state) {
 			Logger::info("OHCI state set to %s", OHCIStateNames[state]);
 			if (state == USBOperational) {
-				fmremaining = fminterval;
+				scheduler->schedule(frame_event, fminterval + 1);
+			}
+			else {
+				scheduler->cancel(frame_event);
 			}
 			this->state = state;
 		}
@@ -156,22 +162,19 @@ void OHCIController::write(uint32_t addr, uint32_t value) {
 	}
 }
 
-void OHCIController::update() {
-	if (state == USBOperational) {
-		if (fmremaining-- == 0) {
-			fmremaining = fminterval;
-			fmnumber++;
-			
-			physmem->write(hcca + 0x80, &fmnumber, 2);
-			
-			interrupt_status |= 4;
-			if ((fmnumber & ~0x7FFF) == 0) {
-				interrupt_status |= 0x20;
-			}
-			
-			process_periodic();
-		}
+void OHCIController::process_frame() {
+	fmnumber++;
+	
+	physmem->write(hcca + 0x80, &fmnumber, 2);
+	
+	interrupt_status |= 4;
+	if ((fmnumber & ~0x7FFF) == 0) {
+		interrupt_status |= 0x20;
 	}
+	
+	process_periodic();
+	
+	scheduler->schedule(frame_event, fminterval + 1);
 }
 
 bool OHCIController::check_interrupts() {
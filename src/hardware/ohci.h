@@ -1,6 +1,7 @@
 
 #pragma once
 
+#include "hardware/scheduler.h"
 #include "hardware/usb.h"
 
 #include <cstdint>
@@ -71,10 +72,9 @@ public:
 		USBReset, USBResume, USBOperational, USBSuspend
 	};
 	
-	OHCIController(PhysicalMemory *physmem, int index);
+	OHCIController(PhysicalMemory *physmem, Scheduler *scheduler, int index);
 	
 	void reset();
-	void update();
 	
 	uint32_t read(uint32_t addr);
 	void write(uint32_t addr, uint32_t value);
@@ -82,6 +82,7 @@ public:
 	bool check_interrupts();
 	
 private:
+	void process_frame();
 	void process_periodic();
 	void process_control();
 	void process_bulk();
@@ -99,7 +100,6 @@ private:
 	uint32_t bulk_head_ed;
 	uint32_t done_head;
 	uint16_t fminterval;
-	uint16_t fmremaining;
 	uint16_t fmnumber;
 	uint16_t periodic_start;
 	uint32_t descriptor_a;
@@ -111,5 +111,7 @@ private:
 	USBDummyDevice devices[4];
 	
 	int index;
+	int frame_event;
 	PhysicalMemory *physmem;
+	Scheduler *scheduler;
 };
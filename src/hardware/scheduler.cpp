@@ -0,0 +1,88 @@
+
+#include "hardware/scheduler.h"
+
+#include <algorithm>
+
+
+Scheduler::Scheduler() {
+	ticks = 0;
+}
+
+void Scheduler::reset() {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	
+	queue = decltype(queue)();
+	for (Event &event : events) {
+		event.generation++;
+		event.pending = false;
+	}
+	ticks = 0;
+}
+
+int Scheduler::add(Callback callback, int targets) {
+	Event event;
+	event.callback = callback;
+	event.targets = targets;
+	event.generation = 0;
+	event.pending = false;
+	event.deadline = 0;
+	events.push_back(event);
+	return events.size() - 1;
+}
+
+void Scheduler::schedule(int event, uint64_t delay) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	
+	Entry entry;
+	entry.deadline = ticks + delay;
+	entry.event = event;
+	entry.generation = ++events[event].generation;
+	queue.push(entry);
+	
+	events[event].pending = true;
+	events[event].deadline = entry.deadline;
+}
+
+void Scheduler::cancel(int event) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	events[event].generation++;
+	events[event].pending = false;
+}
+
+bool Scheduler::advance(uint64_t ticks) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	
+	this->ticks += ticks;
+	
+	bool triggered = false;
+	while (!queue.empty() && queue.top().deadline <= this->ticks) {
+		Entry entry = queue.top();
+		queue.pop();
+		
+		Event &event = events[entry.event];
+		if (event.generation == entry.generation) {
+			event.generation++;
+			event.pending = false;
+			event.callback();
+			triggered = true;
+		}
+	}
+	return triggered;
+}
+
+uint64_t Scheduler::getTicks() {
+	return ticks;
+}
+
+uint64_t Scheduler::getDelay(int targets) {
+	std::lock_guard<std::recursive_mutex> lock(mutex);
+	
+	// There are only a few events, so they are simply searched
+	uint64_t delay = UINT64_MAX;
+	for (Event &event : events) {
+		if (event.pending && (event.targets & targets)) {
+			delay = std::min(delay, event.deadline - ticks);
+		}
+	}
+	return delay;
+}
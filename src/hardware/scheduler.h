@@ -0,0 +1,70 @@
+
+#pragma once
+
+#include <functional>
+#include <vector>
+#include <queue>
+#include <mutex>
+#include <cstdint>
+
+
+/*	Keeps track of the timed events of the hardware devices. Time is counted
+	in hardware ticks (calls to Hardware::update). A device registers its
+	events once and schedules them whenever they are due again.
+*/
+
+class Scheduler {
+public:
+	typedef std::function<void()> Callback;
+	
+	// The processors whose interrupts an event may raise
+	enum Target {
+		ARM = 1,
+		PPC = 2
+	};
+	
+	Scheduler();
+	
+	void reset();
+	
+	int add(Callback callback, int targets);
+	void schedule(int event, uint64_t delay);
+	void cancel(int event);
+	
+	// Returns true if any events were triggered
+	bool advance(uint64_t ticks);
+	
+	uint64_t getTicks();
+	
+	// Returns the number of ticks until the next event that
+	// may raise an interrupt for one of the given processors
+	uint64_t getDelay(int targets);
+
+private:
+	struct Event {
+		Callback callback;
+		int targets;
+		uint32_t generation;
+		
+		bool pending;
+		uint64_t deadline;
+	};
+	
+	// Entries of events that were rescheduled or cancelled
+	// stay in the queue, but their generation is outdated
+	struct Entry {
+		uint64_t deadline;
+		int event;
+		uint32_t generation;
+		
+		bool operator >(const Entry &other) const {
+			return deadline > other.deadline;
+		}
+	};
+	
+	std::vector<Event> events;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> queue;
+	std::recursive_mutex mutex;
+	
+	uint64_t ticks;
+};
@@ -1,6 +1,8 @@
 
 #include "emulator.h"
 #include "history.h"
+#include "cpu/jitcache.h"
+#include "cpu/perfmap.h"
 #include "common/logger.h"
 
 int main(int argc, const char *argv[]) {
@@ -8,8 +10,22 @@ int main(int argc, const char *argv[]) {
 	History::init();
 
 	bool boot0 = false;
-	if (argc > 1 && std::strcmp(argv[1], "--boot0") == 0) {
-		boot0 = true;
+	for (int i = 1; i < argc; i++) {
+		if (std::strcmp(argv[i], "--boot0") == 0) {
+			boot0 = true;
+		}
+		else if (std::strcmp(argv[i], "--jit-cache") == 0) {
+			JITCache::setDirectory("logs/jitcache");
+		}
+		else if (std::strncmp(argv[i], "--jit-cache=", 12) == 0) {
+			JITCache::setDirectory(argv[i] + 12);
+		}
+		else if (std::strcmp(argv[i], "--perf-map") == 0) {
+			PerfMap::enable(false);
+		}
+		else if (std::strcmp(argv[i], "--jitdump") == 0) {
+			PerfMap::enable(true);
+		}
 	}
 
 	Emulator *emulator = new Emulator(boot0);
@@ -2,24 +2,129 @@
 #include "physicalmemory.h"
 #include "hardware.h"
 
+#include "cpu/faulthandler.h"
+
 #include "common/exceptions.h"
 
+#include <sys/mman.h>
+
 #include <cstring>
 
 
+static PhysicalMemory *instance;
+
+
 bool isHardware(uint32_t addr) {
 	return (addr & 0xFE400000) == 0x0C000000 || (addr & 0xFE000000) == 0xD0000000;
 }
 
 
+ModifiedPages::ModifiedPages() {
+	pending = false;
+	for (int i = 0; i < 0x8000; i++) {
+		pages[i] = 0;
+	}
+}
+
+void ModifiedPages::add(uint32_t page) {
+	pages[page / 32] |= 1 << (page % 32);
+	pending = true;
+}
+
+
 PhysicalMemory::PhysicalMemory(Hardware *hardware) {
 	this->hardware = hardware;
 	
-	mem = (char *)malloc(0x100000000);
+	// Hardware ranges are left unmapped, so that fastmem
+	// accesses to them fault and take the slow path
+	mem = (char *)mmap(
+		NULL, 0x100000000, PROT_NONE,
+		MAP_ANONYMOUS | MAP_PRIVATE | MAP_NORESERVE, -1, 0
+	);
+	if (mem == MAP_FAILED) {
+		runtime_error("Failed to allocate physical memory");
+	}
+	
+	for (uint64_t addr = 0; addr < 0x100000000; addr += 0x400000) {
+		if (!isHardware(addr)) {
+			mprotect(mem + addr, 0x400000, PROT_READ | PROT_WRITE);
+		}
+	}
+	
+	for (int i = 0; i < 0x8000; i++) {
+		codePages[i] = 0;
+	}
+	for (int i = 0; i < 64; i++) {
+		pageLocks[i].clear();
+	}
+	modifiedCount = 0;
+	
+	instance = this;
+	FaultHandler::setAccessHandler(handleFault);
 }
 
 PhysicalMemory::~PhysicalMemory() {
-	free(mem);
+	munmap(mem, 0x100000000);
+}
+
+void PhysicalMemory::lockPage(uint32_t page) {
+	while (pageLocks[page % 64].test_and_set(std::memory_order_acquire));
+}
+
+void PhysicalMemory::unlockPage(uint32_t page) {
+	pageLocks[page % 64].clear(std::memory_order_release);
+}
+
+void PhysicalMemory::protectCode(uint32_t addr) {
+	uint32_t page = addr >> 12;
+	uint32_t mask = 1 << (page % 32);
+	if (codePages[page / 32].load(std::memory_order_acquire) & mask) {
+		return;
+	}
+	
+	lockPage(page);
+	if (!(codePages[page / 32].fetch_or(mask) & mask)) {
+		mprotect(mem + (addr & ~0xFFF), 0x1000, PROT_READ);
+	}
+	unlockPage(page);
+}
+
+void PhysicalMemory::addModifiedPages(ModifiedPages *pages) {
+	int index = modifiedCount;
+	if (index == 8) {
+		runtime_error("Too many sets of modified pages");
+	}
+	modifiedPages[index] = pages;
+	modifiedCount = index + 1;
+}
+
+// Called from the signal handler. The page lock is only held briefly by
+// protectCode, which never touches guest memory, so it cannot deadlock.
+bool PhysicalMemory::handleFault(void *addr) {
+	PhysicalMemory *physmem = instance;
+	
+	uint64_t offset = (char *)addr - physmem->mem;
+	if (offset >= 0x100000000 || isHardware(offset)) {
+		return false;
+	}
+	
+	uint32_t page = offset >> 12;
+	uint32_t mask = 1 << (page % 32);
+	
+	physmem->lockPage(page);
+	if (physmem->codePages[page / 32].fetch_and(~mask) & mask) {
+		mprotect(physmem->mem + (offset & ~0xFFF), 0x1000, PROT_READ | PROT_WRITE);
+		
+		int count = physmem->modifiedCount;
+		for (int i = 0; i < count; i++) {
+			physmem->modifiedPages[i]->add(page);
+		}
+	}
+	physmem->unlockPage(page);
+	
+	// If another thread removed the protection in the
+	// meantime, the access simply succeeds this time
+	return true;
 }
 
 template <>
@@ -6,6 +6,7 @@
 #include "hardware.h"
 
 #include <string>
+#include <atomic>
 
 #include <cstdint>
 #include <cstddef>
@@ -14,6 +15,36 @@
 bool isHardware(uint32_t addr);
 
 
+// Pages that were written after code was compiled from them, or
+// after other data that is cached by the emulator was read from them
+class ModifiedPages {
+public:
+	ModifiedPages();
+	
+	void add(uint32_t page);
+	
+	// Calls func for every page in the set and clears the set
+	template <class F>
+	void collect(F func) {
+		pending = false;
+		for (int i = 0; i < 0x8000; i++) {
+			if (pages[i].load(std::memory_order_relaxed)) {
+				uint32_t bits = pages[i].exchange(0);
+				while (bits) {
+					func(i * 32 + __builtin_ctz(bits));
+					bits &= bits - 1;
+				}
+			}
+		}
+	}
+	
+	std::atomic<bool> pending;
+
+private:
+	std::atomic<uint32_t> pages[0x8000];
+};
+
+
 class PhysicalMemory {
 public:
 	PhysicalMemory(Hardware *hardware);
@@ -46,9 +77,31 @@ public:
 	Buffer read(uint32_t addr, size_t size);
 	void write(uint32_t addr, Buffer data);
 	
+	// Returns the host address of memory that is not hardware
+	char *getPointer(uint32_t addr) { return mem + addr; }
+	
+	// Write protects a page that code was compiled from. The first write
+	// to the page adds it to all registered sets of modified pages.
+	void protectCode(uint32_t addr);
+	void addModifiedPages(ModifiedPages *pages);
+
 private:
+	static bool handleFault(void *addr);
+	
+	void lockPage(uint32_t page);
+	void unlockPage(uint32_t page);
+	
 	char *mem;
 	
+	std::atomic<uint32_t> codePages[0x8000];
+	
+	// A page is only protected or unprotected together with its bit
+	// in codePages while the lock is held, so they always agree
+	std::atomic_flag pageLocks[64];
+	
+	ModifiedPages *modifiedPages[8];
+	std::atomic<int> modifiedCount;
+	
 	Hardware *hardware;
 };
 